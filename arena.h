@@ -14,6 +14,8 @@
  *   ARENA_FREE             - Custom free for block chaining (default: free)
  *   ARENA_DEFAULT_ALIGN    - Default alignment (default: alignof(max_align_t))
  *   ARENA_BLOCK_MIN_SIZE   - Minimum block size for chaining (default: 4096)
+ *   ARENA_MMAP             - Back chained blocks with mmap/VirtualAlloc instead of ARENA_MALLOC,
+ *                            so every block is page aligned and arena_freeze covers it entirely
  *
  * EXAMPLE USAGE
  *
@@ -31,6 +33,50 @@
  *
  * This code is not thread safe, use one arena per thread, or add external synchronization
  *
+ * RECYCLING (ARENA_BLOCK_CHAINING)
+ *
+ *   Servers that create a dynamic arena per request can keep warm arenas around with
+ *   an arena_recycler_t instead. arena_acquire() hands out a reset arena whose blocks
+ *   already cover the expected size, arena_release() resets it and caches it in a
+ *   bucket keyed by the capacity it grew to. The recycler is thread safe (spinlock),
+ *   the arenas it hands out are not.
+ *
+ *     arena_recycler_t rec;
+ *     arena_recycler_init(&rec, 64 * 1024 * 1024);   // cache at most 64 MiB
+ *
+ *     arena_t *a = arena_acquire(&rec, 16 * 1024);
+ *     // ... handle request ...
+ *     arena_release(&rec, a);
+ *
+ *     arena_recycler_destroy(&rec);
+ *
+ * BUDGETS (ARENA_BLOCK_CHAINING)
+ *
+ *   An arena_budget_t caps the bytes an arena may take from ARENA_MALLOC for its blocks.
+ *   Budgets can have a parent, so per arena budgets can also draw from a group budget
+ *   shared by many arenas (and threads, counters are atomic). Crossing the soft limit
+ *   calls the pressure callback, a charge past the hard limit calls it once more and
+ *   then fails the allocation with NULL. Soft callbacks only run once the whole chain
+ *   has taken the charge. Attaching a budget charges the blocks the arena already
+ *   owns, after that only block creation touches the counters, so they cost nothing
+ *   on the bump path and stay on in release builds.
+ *
+ *     arena_budget_t group, per_request;
+ *     arena_budget_init(&group, 256 << 20, 512 << 20, NULL);
+ *     arena_budget_init(&per_request, 0, 8 << 20, &group);
+ *     arena_budget_set_callback(&group, on_pressure, server);
+ *     arena_set_budget(&arena, &per_request);
+ *
+ * FREEZING
+ *
+ *   Once an arena is fully built (config tables, lookup data, ...) it can be made
+ *   read only with arena_freeze(). Its pages are mprotect'ed (VirtualProtect on
+ *   windows), so any thread may read the data without synchronization, stray writes
+ *   fault immediately and forked children keep sharing the pages without copy on write.
+ *   arena_thaw() makes the arena writable again. Only whole pages can be protected:
+ *   blocks from ARENA_MMAP are covered entirely, user buffers and malloc'ed blocks only
+ *   on the pages they fully contain.
+ *
  */
 
 /*
@@ -83,6 +129,16 @@ extern "C" {
     #endif
 #endif
 
+#if defined(_WIN32)
+    #define ARENA__OS_WINDOWS
+#elif defined(__unix__) || defined(__APPLE__)
+    #define ARENA__OS_POSIX
+#endif
+
+#if defined(ARENA_MMAP) && !defined(ARENA__OS_WINDOWS) && !defined(ARENA__OS_POSIX)
+    #error "ARENA_MMAP requires a posix or windows target"
+#endif
+
 #ifndef ARENA_DEFAULT_ALIGN
     #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
         #define ARENA_DEFAULT_ALIGN (sizeof(max_align_t))
@@ -105,6 +161,39 @@ extern "C" {
     #endif
 #endif
 
+#ifdef ARENA_BLOCK_CHAINING
+    #ifndef ARENA_RECYCLER_BUCKETS
+        #define ARENA_RECYCLER_BUCKETS 48
+    #endif
+
+    // tiny spinlock, the recycler only holds it for a few pointer swaps
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        typedef volatile long arena__spinlock_t;
+        #define ARENA__LOCK(l)   do { while (_InterlockedExchange((l), 1)) { while (*(l)) _mm_pause(); } } while (0)
+        #define ARENA__UNLOCK(l) _InterlockedExchange((l), 0)
+        #if defined(_WIN64)
+            #define ARENA__ATOMIC_ADD(p, v) ((size_t)_InterlockedExchangeAdd64((volatile __int64 *)(p), (__int64)(v)) + (size_t)(v))
+            #define ARENA__ATOMIC_CAS(p, expected, desired) \
+                (_InterlockedCompareExchange64((volatile __int64 *)(p), (__int64)(desired), (__int64)(expected)) == (__int64)(expected))
+        #else
+            #define ARENA__ATOMIC_ADD(p, v) ((size_t)_InterlockedExchangeAdd((volatile long *)(p), (long)(v)) + (size_t)(v))
+            #define ARENA__ATOMIC_CAS(p, expected, desired) \
+                (_InterlockedCompareExchange((volatile long *)(p), (long)(desired), (long)(expected)) == (long)(expected))
+        #endif
+        #define ARENA__ATOMIC_LOAD(p) (*(volatile size_t *)(p))
+    #else
+        typedef int arena__spinlock_t;
+        #define ARENA__LOCK(l)   do { while (__atomic_exchange_n((l), 1, __ATOMIC_ACQUIRE)) { while (__atomic_load_n((l), __ATOMIC_RELAXED)) { } } } while (0)
+        #define ARENA__UNLOCK(l) __atomic_store_n((l), 0, __ATOMIC_RELEASE)
+        #define ARENA__ATOMIC_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+        #define ARENA__ATOMIC_CAS(p, expected, desired) \
+            __atomic_compare_exchange_n((p), &(expected), (desired), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+        #define ARENA__ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+    #endif
+    #define ARENA__ATOMIC_SUB(p, v) ARENA__ATOMIC_ADD((p), (size_t)0 - (size_t)(v))
+#endif
+
 #ifdef ARENA_STATIC
     #define ARENA_API static
 #else
@@ -131,6 +220,16 @@ typedef struct arena_stats_t arena_stats_t;
 
 #ifdef ARENA_BLOCK_CHAINING
 typedef struct arena_block_t arena_block_t;
+typedef struct arena_budget_t arena_budget_t;
+
+typedef enum arena_pressure_t {
+    ARENA_PRESSURE_SOFT,    // a charge crossed the soft limit
+    ARENA_PRESSURE_HARD     // a charge would exceed the hard limit and is about to fail
+} arena_pressure_t;
+
+// called on budget pressure, may trim caches or destroy arenas to give bytes back.
+typedef void (*arena_pressure_fn)(arena_budget_t *budget, arena_pressure_t level,
+                                  size_t requested, void *user_data);
 #endif
 
 #ifdef ARENA_DEBUG
@@ -148,6 +247,19 @@ struct arena_block_t {
 };
 #endif
 
+#ifdef ARENA_BLOCK_CHAINING
+struct arena_budget_t {
+    size_t             soft_limit;     // 0 = no soft limit
+    size_t             hard_limit;     // 0 = no hard limit
+    size_t             used;           // bytes of blocks currently charged
+    size_t             peak;
+    size_t             failures;       // charges refused by the hard limit
+    arena_budget_t    *parent;         // group budget charged together with this one
+    arena_pressure_fn  on_pressure;
+    void              *user_data;
+};
+#endif
+
 #ifdef ARENA_DEBUG
 struct arena_alloc_record_t {
     void        *ptr;
@@ -189,11 +301,13 @@ struct arena_t {
     size_t       capacity;
     size_t       offset;
     bool         initialized;
+    bool         frozen;
 
 #ifdef ARENA_BLOCK_CHAINING
     arena_block_t *first_block;
     arena_block_t *current_block;
     bool           owns_first;
+    arena_budget_t *budget;
 #endif
 
 #ifdef ARENA_DEBUG
@@ -291,6 +405,15 @@ ARENA_API arena_stats_t arena_stats(const arena_t *arena);
 // checks if arena is initialized and valid.
 ARENA_API bool arena_is_valid(const arena_t *arena);
 
+// makes arena pages read only, returns false if the platform cannot protect pages.
+ARENA_API bool arena_freeze(arena_t *arena);
+
+// makes a frozen arena writable again.
+ARENA_API bool arena_thaw(arena_t *arena);
+
+// checks if arena is currently frozen.
+ARENA_API bool arena_is_frozen(const arena_t *arena);
+
 #ifdef ARENA_DEBUG
 // sets name for debug printing.
 ARENA_API void arena_set_name(arena_t *arena, const char *name);
@@ -316,8 +439,79 @@ ARENA_API arena_temp_t arena_temp_begin(arena_t *arena);
 // ends temporary scope, rolling back allocations.
 ARENA_API void arena_temp_end(arena_temp_t *temp);
 
+#ifdef ARENA_BLOCK_CHAINING
+
+// initializes a byte budget, parent (may be null) is a group budget shared by several arenas.
+ARENA_API void arena_budget_init(arena_budget_t *budget, size_t soft_limit, size_t hard_limit,
+                                 arena_budget_t *parent);
+
+// sets callback invoked on soft limit crossings and before hard limit failures.
+ARENA_API void arena_budget_set_callback(arena_budget_t *budget, arena_pressure_fn fn, void *user_data);
+
+// gets bytes currently charged to the budget.
+ARENA_API size_t arena_budget_used(const arena_budget_t *budget);
+
+// attaches budget and charges the blocks the arena already owns to it (the first block of
+// arena_init_dynamic included), null detaches. fails on hard limit and keeps the old budget.
+ARENA_API bool arena_set_budget(arena_t *arena, arena_budget_t *budget);
+
+typedef struct arena__recycled_t arena__recycled_t;
+
+typedef struct arena_recycler_stats_t {
+    size_t   acquires;
+    size_t   hits;
+    size_t   misses;
+    size_t   releases;
+    size_t   evictions;
+    size_t   cached_arenas;
+    size_t   cached_bytes;
+    double   hit_rate;
+} arena_recycler_stats_t;
+
+typedef struct arena_recycler_t {
+    arena__recycled_t  *buckets[ARENA_RECYCLER_BUCKETS];
+    size_t              max_cached_bytes;
+    size_t              cached_bytes;
+    size_t              cached_arenas;
+    size_t              acquires;
+    size_t              hits;
+    size_t              releases;
+    size_t              evictions;
+    arena__spinlock_t   lock;
+} arena_recycler_t;
+
+// initializes recycler, arenas beyond max_cached_bytes are destroyed on release.
+ARENA_API void arena_recycler_init(arena_recycler_t *rec, size_t max_cached_bytes);
+
+// destroys every cached arena. arenas still acquired must be released first.
+ARENA_API void arena_recycler_destroy(arena_recycler_t *rec);
+
+// gets a reset dynamic arena with at least expected_size bytes of capacity.
+ARENA_API arena_t *arena_acquire(arena_recycler_t *rec, size_t expected_size);
+
+// resets arena and returns it to the cache, arena must come from arena_acquire.
+ARENA_API void arena_release(arena_recycler_t *rec, arena_t *arena);
+
+// destroys cached arenas until at most max_cached_bytes remain, returns bytes freed.
+ARENA_API size_t arena_recycler_trim(arena_recycler_t *rec, size_t max_cached_bytes);
+
+// fills recycler stats structure.
+ARENA_API arena_recycler_stats_t arena_recycler_stats(arena_recycler_t *rec);
+
+#endif
+
 #ifdef ARENA_IMPLEMENTATION
 
+#if defined(ARENA__OS_WINDOWS)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#elif defined(ARENA__OS_POSIX)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
 static inline bool arena__is_power_of_two(size_t x) {
     return x != 0 && (x & (x - 1)) == 0;
 }
@@ -353,17 +547,146 @@ static inline bool arena__calc_aligned_offset(
     return true;
 }
 
+#if defined(ARENA__OS_WINDOWS) || defined(ARENA__OS_POSIX)
+
+static size_t arena__page_size(void) {
+#if defined(ARENA__OS_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+#endif
+}
+
+// protects the whole pages inside [start, start + size), partial pages at the edges are left alone.
+static bool arena__protect_range(uint8_t *start, size_t size, bool read_only) {
+    size_t page = arena__page_size();
+    uintptr_t lo = arena__align_up((uintptr_t)start, page);
+    uintptr_t hi = ((uintptr_t)start + size) & ~(uintptr_t)(page - 1);
+
+    if (size == 0 || hi <= lo) return true;
+
+#if defined(ARENA__OS_WINDOWS)
+    DWORD old;
+    return VirtualProtect((void *)lo, (SIZE_T)(hi - lo),
+                          read_only ? PAGE_READONLY : PAGE_READWRITE, &old) != 0;
+#else
+    return mprotect((void *)lo, (size_t)(hi - lo),
+                    read_only ? PROT_READ : (PROT_READ | PROT_WRITE)) == 0;
+#endif
+}
+
+#endif
+
 #ifdef ARENA_BLOCK_CHAINING
 
-static arena_block_t *arena__create_block(size_t min_size) {
+static size_t arena__block_header_size(void) {
+    return arena__align_up(sizeof(arena_block_t), ARENA_DEFAULT_ALIGN);
+}
+
+static void arena__budget_note_peak(arena_budget_t *b, size_t used) {
+    size_t peak = ARENA__ATOMIC_LOAD(&b->peak);
+    while (used > peak && !ARENA__ATOMIC_CAS(&b->peak, peak, used)) {
+        peak = ARENA__ATOMIC_LOAD(&b->peak);
+    }
+}
+
+static void arena__budget_uncharge(arena_budget_t *budget, size_t bytes) {
+    for (arena_budget_t *b = budget; b; b = b->parent) {
+        ARENA__ATOMIC_SUB(&b->used, bytes);
+    }
+}
+
+static bool arena__budget_try_charge(arena_budget_t *b, size_t bytes, arena_budget_t **failed) {
+    size_t used = ARENA__ATOMIC_ADD(&b->used, bytes);
+
+    if (b->hard_limit && (used > b->hard_limit || used < bytes)) {
+        ARENA__ATOMIC_SUB(&b->used, bytes);
+        *failed = b;
+        return false;
+    }
+
+    // charge the parents first, so a refusal further up rolls back before any
+    // soft callback has seen a charge that never happened
+    if (b->parent && !arena__budget_try_charge(b->parent, bytes, failed)) {
+        ARENA__ATOMIC_SUB(&b->used, bytes);
+        return false;
+    }
+
+    arena__budget_note_peak(b, used);
+
+    if (b->soft_limit && used > b->soft_limit && used - bytes <= b->soft_limit && b->on_pressure) {
+        b->on_pressure(b, ARENA_PRESSURE_SOFT, bytes, b->user_data);
+    }
+    return true;
+}
+
+static bool arena__budget_charge(arena_budget_t *budget, size_t bytes) {
+    arena_budget_t *failed = NULL;
+
+    if (!budget) return true;
+    if (arena__budget_try_charge(budget, bytes, &failed)) return true;
+
+    // give the callback one chance to free memory, then retry once
+    if (failed->on_pressure) {
+        failed->on_pressure(failed, ARENA_PRESSURE_HARD, bytes, failed->user_data);
+        if (arena__budget_try_charge(budget, bytes, &failed)) return true;
+    }
+
+    ARENA__ATOMIC_ADD(&failed->failures, 1);
+    return false;
+}
+
+static arena_block_t *arena__create_block(size_t min_size, arena_budget_t *budget) {
     size_t size = min_size < ARENA_BLOCK_MIN_SIZE ? ARENA_BLOCK_MIN_SIZE : min_size;
 
-    size_t header_size = arena__align_up(sizeof(arena_block_t), ARENA_DEFAULT_ALIGN);
+    size_t header_size = arena__block_header_size();
     size_t total_size = arena__safe_add(header_size, size);
     if (total_size == SIZE_MAX) return NULL;
 
+#ifdef ARENA_MMAP
+    // round to whole pages and hand the slack to the block
+    size_t page = arena__page_size();
+    total_size = arena__safe_add(total_size, page - 1);
+    if (total_size == SIZE_MAX) return NULL;
+    total_size &= ~(page - 1);
+    size = total_size - header_size;
+#endif
+
+    if (!arena__budget_charge(budget, total_size)) return NULL;
+
+#ifdef ARENA_MMAP
+
+#if defined(ARENA__OS_WINDOWS)
+    uint8_t *memory = (uint8_t *)VirtualAlloc(NULL, total_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!memory) {
+        arena__budget_uncharge(budget, total_size);
+        return NULL;
+    }
+#else
+    #if defined(MAP_ANONYMOUS)
+        #define ARENA__MAP_ANON MAP_ANONYMOUS
+    #elif defined(MAP_ANON)
+        #define ARENA__MAP_ANON MAP_ANON
+    #else
+        #error "ARENA_MMAP needs MAP_ANONYMOUS, define _DEFAULT_SOURCE before including arena.h"
+    #endif
+    void *mapped = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | ARENA__MAP_ANON, -1, 0);
+    if (mapped == MAP_FAILED) {
+        arena__budget_uncharge(budget, total_size);
+        return NULL;
+    }
+    uint8_t *memory = (uint8_t *)mapped;
+#endif
+#else
     uint8_t *memory = (uint8_t *)ARENA_MALLOC(total_size);
-    if (!memory) return NULL;
+    if (!memory) {
+        arena__budget_uncharge(budget, total_size);
+        return NULL;
+    }
+#endif
 
     arena_block_t *block = (arena_block_t *)memory;
     block->buffer = memory + header_size;
@@ -376,18 +699,25 @@ static arena_block_t *arena__create_block(size_t min_size) {
     return block;
 }
 
-static void arena__free_block(arena_block_t *block) {
+static void arena__free_block(arena_block_t *block, arena_budget_t *budget) {
     if (block && block->owned) {
+        arena__budget_uncharge(budget, arena__block_header_size() + block->capacity);
+#if defined(ARENA_MMAP) && defined(ARENA__OS_WINDOWS)
+        VirtualFree(block, 0, MEM_RELEASE);
+#elif defined(ARENA_MMAP)
+        munmap(block, arena__block_header_size() + block->capacity);
+#else
         ARENA_FREE(block);
+#endif
     }
 }
 
-static void arena__free_block_chain(arena_block_t *first, bool free_first) {
+static void arena__free_block_chain(arena_block_t *first, bool free_first, arena_budget_t *budget) {
     arena_block_t *block = first;
     while (block) {
         arena_block_t *next = block->next;
         if (block != first || free_first) {
-            arena__free_block(block);
+            arena__free_block(block, budget);
         }
         block = next;
     }
@@ -433,7 +763,7 @@ ARENA_API bool arena_init_dynamic(arena_t *arena, size_t initial_size) {
 
     ARENA_MEMSET(arena, 0, sizeof(*arena));
 
-    arena_block_t *block = arena__create_block(initial_size);
+    arena_block_t *block = arena__create_block(initial_size, NULL);
     if (!block) return false;
 
     arena->buffer = block->buffer;
@@ -463,6 +793,10 @@ ARENA_API bool arena_init_dynamic(arena_t *arena, size_t initial_size) {
 ARENA_API void arena_destroy(arena_t *arena) {
     if (!arena || !arena->initialized) return;
 
+    if (arena->frozen) {
+        arena_thaw(arena);
+    }
+
 #ifdef ARENA_DEBUG
     if (arena->records) {
         ARENA_FREE(arena->records);
@@ -474,7 +808,7 @@ ARENA_API void arena_destroy(arena_t *arena) {
 
 #ifdef ARENA_BLOCK_CHAINING
     if (arena->first_block) {
-        arena__free_block_chain(arena->first_block, arena->owns_first);
+        arena__free_block_chain(arena->first_block, arena->owns_first, arena->budget);
     }
 #endif
 
@@ -490,8 +824,9 @@ ARENA_API void *arena__alloc(arena_t *arena, size_t size, size_t align)
     ARENA_ASSERT(arena != NULL && "arena_alloc: arena is NULL");
     ARENA_ASSERT(arena->initialized && "arena_alloc: arena not initialized");
     ARENA_ASSERT(arena__is_power_of_two(align) && "arena_alloc: alignment must be power of 2");
+    ARENA_ASSERT(!arena->frozen && "arena_alloc: arena is frozen");
 
-    if (!arena || !arena->initialized) return NULL;
+    if (!arena || !arena->initialized || arena->frozen) return NULL;
     if (!arena__is_power_of_two(align)) return NULL;
 
     if (size == 0) {
@@ -505,28 +840,41 @@ ARENA_API void *arena__alloc(arena_t *arena, size_t size, size_t align)
         goto do_alloc;
     }
 
-    // try allocate new block
+    // try the blocks kept alive by arena_reset before chaining a new one
     if (arena->first_block) {
-        size_t needed = arena__safe_add(size, align - 1);
-        if (needed == SIZE_MAX) return NULL;
-
-        arena_block_t *new_block = arena__create_block(needed);
-        if (!new_block) return NULL;
+        arena_block_t *tail = arena->current_block;
+        arena_block_t *next = tail ? tail->next : NULL;
 
-        if (arena->current_block) {
-            arena->current_block->next = new_block;
-            new_block->prev = arena->current_block;
+        while (next) {
+            tail = next;
+            if (arena__calc_aligned_offset(0, align, size, next->capacity, &aligned_offset, &padding)) {
+                break;
+            }
+            next = next->next;
         }
-        arena->current_block = new_block;
 
-        arena->buffer = new_block->buffer;
-        arena->capacity = new_block->capacity;
-        arena->offset = 0;
+        if (!next) {
+            size_t needed = arena__safe_add(size, align - 1);
+            if (needed == SIZE_MAX) return NULL;
+
+            next = arena__create_block(needed, arena->budget);
+            if (!next) return NULL;
 
-        if (!arena__calc_aligned_offset(0, align, size, arena->capacity, &aligned_offset, &padding)) {
-            ARENA_ASSERT(0 && "Internal error: new block too small");
-            return NULL;
+            if (tail) {
+                tail->next = next;
+                next->prev = tail;
+            }
+
+            if (!arena__calc_aligned_offset(0, align, size, next->capacity, &aligned_offset, &padding)) {
+                ARENA_ASSERT(0 && "Internal error: new block too small");
+                return NULL;
+            }
         }
+
+        arena->current_block = next;
+        arena->buffer = next->buffer;
+        arena->capacity = next->capacity;
+        arena->offset = 0;
     } else {
         return NULL;
     }
@@ -597,6 +945,9 @@ ARENA_API void *arena__alloc_zero(arena_t *arena, size_t size, size_t align)
 ARENA_API void arena_reset(arena_t *arena) {
     if (!arena || !arena->initialized) return;
 
+    ARENA_ASSERT(!arena->frozen && "arena_reset: arena is frozen");
+    if (arena->frozen) return;
+
 #ifdef ARENA_BLOCK_CHAINING
     if (arena->first_block) {
         for (arena_block_t *b = arena->first_block; b; b = b->next) {
@@ -636,10 +987,13 @@ ARENA_API void arena_reset(arena_t *arena) {
 ARENA_API void arena_reset_to(arena_t *arena, arena_marker_t marker) {
     if (!arena || !arena->initialized) return;
 
+    ARENA_ASSERT(!arena->frozen && "arena_reset_to: arena is frozen");
+    if (arena->frozen) return;
+
 #ifdef ARENA_BLOCK_CHAINING
     if (arena->first_block && marker.block) {
         if (marker.block->next) {
-            arena__free_block_chain(marker.block->next, true);
+            arena__free_block_chain(marker.block->next, true, arena->budget);
             marker.block->next = NULL;
         }
 
@@ -780,6 +1134,63 @@ ARENA_API bool arena_is_valid(const arena_t *arena) {
     return true;
 }
 
+#if defined(ARENA__OS_WINDOWS) || defined(ARENA__OS_POSIX)
+static bool arena__protect_all(arena_t *arena, bool read_only) {
+    bool ok = true;
+
+#ifdef ARENA_BLOCK_CHAINING
+    if (arena->first_block) {
+        for (arena_block_t *b = arena->first_block; b; b = b->next) {
+#ifdef ARENA_MMAP
+            // the whole mapping, header included, is page aligned
+            ok = arena__protect_range((uint8_t *)b, arena__block_header_size() + b->capacity, read_only) && ok;
+#else
+            ok = arena__protect_range(b->buffer, b->capacity, read_only) && ok;
+#endif
+        }
+        return ok;
+    }
+#endif
+
+    if (arena->buffer) {
+        ok = arena__protect_range(arena->buffer, arena->capacity, read_only);
+    }
+    return ok;
+}
+#endif
+
+ARENA_API bool arena_freeze(arena_t *arena) {
+    if (!arena || !arena->initialized) return false;
+    if (arena->frozen) return true;
+
+#if defined(ARENA__OS_WINDOWS) || defined(ARENA__OS_POSIX)
+    if (!arena__protect_all(arena, true)) {
+        arena__protect_all(arena, false);
+        return false;
+    }
+    arena->frozen = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+ARENA_API bool arena_thaw(arena_t *arena) {
+    if (!arena || !arena->initialized) return false;
+    if (!arena->frozen) return true;
+
+#if defined(ARENA__OS_WINDOWS) || defined(ARENA__OS_POSIX)
+    if (!arena__protect_all(arena, false)) return false;
+#endif
+    arena->frozen = false;
+    return true;
+}
+
+ARENA_API bool arena_is_frozen(const arena_t *arena) {
+    if (!arena || !arena->initialized) return false;
+    return arena->frozen;
+}
+
 ARENA_API arena_temp_t arena_temp_begin(arena_t *arena) {
     arena_temp_t temp = {0};
     if (arena && arena->initialized) {
@@ -796,6 +1207,203 @@ ARENA_API void arena_temp_end(arena_temp_t *temp) {
     }
 }
 
+#ifdef ARENA_BLOCK_CHAINING
+
+ARENA_API void arena_budget_init(arena_budget_t *budget, size_t soft_limit, size_t hard_limit,
+                                 arena_budget_t *parent) {
+    if (!budget) return;
+    ARENA_MEMSET(budget, 0, sizeof(*budget));
+    budget->soft_limit = soft_limit;
+    budget->hard_limit = hard_limit;
+    budget->parent = parent;
+}
+
+ARENA_API void arena_budget_set_callback(arena_budget_t *budget, arena_pressure_fn fn, void *user_data) {
+    if (!budget) return;
+    budget->on_pressure = fn;
+    budget->user_data = user_data;
+}
+
+ARENA_API size_t arena_budget_used(const arena_budget_t *budget) {
+    if (!budget) return 0;
+    return ARENA__ATOMIC_LOAD(&budget->used);
+}
+
+ARENA_API bool arena_set_budget(arena_t *arena, arena_budget_t *budget) {
+    if (!arena || !arena->initialized) return false;
+    if (arena->budget == budget) return true;
+
+    size_t owned = 0;
+    for (arena_block_t *b = arena->first_block; b; b = b->next) {
+        if (b->owned && (b != arena->first_block || arena->owns_first)) {
+            owned = arena__safe_add(owned, arena__block_header_size() + b->capacity);
+        }
+    }
+
+    if (owned > 0 && !arena__budget_charge(budget, owned)) return false;
+
+    arena__budget_uncharge(arena->budget, owned);
+    arena->budget = budget;
+    return true;
+}
+
+struct arena__recycled_t {
+    arena_t             arena;  // must stay first, arena_release casts back
+    arena__recycled_t  *next;
+    size_t              capacity;
+};
+
+static size_t arena__floor_log2(size_t x) {
+    size_t r = 0;
+    while (x >>= 1) r++;
+    return r;
+}
+
+static size_t arena__bucket_for(size_t capacity) {
+    size_t b = capacity ? arena__floor_log2(capacity) : 0;
+    return b < ARENA_RECYCLER_BUCKETS ? b : ARENA_RECYCLER_BUCKETS - 1;
+}
+
+ARENA_API void arena_recycler_init(arena_recycler_t *rec, size_t max_cached_bytes) {
+    if (!rec) return;
+    ARENA_MEMSET(rec, 0, sizeof(*rec));
+    rec->max_cached_bytes = max_cached_bytes;
+}
+
+ARENA_API void arena_recycler_destroy(arena_recycler_t *rec) {
+    if (!rec) return;
+    arena_recycler_trim(rec, 0);
+    ARENA_MEMSET(rec, 0, sizeof(*rec));
+}
+
+ARENA_API arena_t *arena_acquire(arena_recycler_t *rec, size_t expected_size) {
+    if (!rec) return NULL;
+
+    // every arena in a bucket at or above ceil(log2(expected)) is big enough
+    size_t first = arena__bucket_for(expected_size);
+    if (expected_size > ((size_t)1 << first) && first + 1 < ARENA_RECYCLER_BUCKETS) first++;
+
+    arena__recycled_t *node = NULL;
+
+    ARENA__LOCK(&rec->lock);
+    rec->acquires++;
+    for (size_t b = first; b < ARENA_RECYCLER_BUCKETS; b++) {
+        if (rec->buckets[b]) {
+            node = rec->buckets[b];
+            rec->buckets[b] = node->next;
+            rec->cached_bytes -= node->capacity;
+            rec->cached_arenas--;
+            rec->hits++;
+            break;
+        }
+    }
+    ARENA__UNLOCK(&rec->lock);
+
+    if (node) {
+        node->next = NULL;
+        return &node->arena;
+    }
+
+    node = (arena__recycled_t *)ARENA_MALLOC(sizeof(arena__recycled_t));
+    if (!node) return NULL;
+
+    if (!arena_init_dynamic(&node->arena, expected_size)) {
+        ARENA_FREE(node);
+        return NULL;
+    }
+    node->next = NULL;
+
+    return &node->arena;
+}
+
+ARENA_API void arena_release(arena_recycler_t *rec, arena_t *arena) {
+    if (!rec || !arena) return;
+
+    arena__recycled_t *node = (arena__recycled_t *)arena;
+
+    if (arena->initialized) {
+        arena_thaw(arena);
+        arena_reset(arena);
+        arena_set_budget(arena, NULL);
+    }
+
+    size_t capacity = arena->initialized ? arena_capacity(arena) : 0;
+    bool cached = false;
+
+    node->capacity = capacity;
+
+    ARENA__LOCK(&rec->lock);
+    rec->releases++;
+    if (capacity > 0 && capacity <= rec->max_cached_bytes &&
+        rec->cached_bytes <= rec->max_cached_bytes - capacity) {
+        size_t b = arena__bucket_for(capacity);
+        node->next = rec->buckets[b];
+        rec->buckets[b] = node;
+        rec->cached_bytes += capacity;
+        rec->cached_arenas++;
+        cached = true;
+    } else {
+        rec->evictions++;
+    }
+    ARENA__UNLOCK(&rec->lock);
+
+    if (!cached) {
+        arena_destroy(arena);
+        ARENA_FREE(node);
+    }
+}
+
+ARENA_API size_t arena_recycler_trim(arena_recycler_t *rec, size_t max_cached_bytes) {
+    if (!rec) return 0;
+
+    arena__recycled_t *victims = NULL;
+    size_t freed = 0;
+
+    // drop the largest arenas first, they are the least likely to be reused
+    ARENA__LOCK(&rec->lock);
+    for (size_t b = ARENA_RECYCLER_BUCKETS; b > 0 && rec->cached_bytes > max_cached_bytes; b--) {
+        while (rec->buckets[b - 1] && rec->cached_bytes > max_cached_bytes) {
+            arena__recycled_t *node = rec->buckets[b - 1];
+            rec->buckets[b - 1] = node->next;
+            rec->cached_bytes -= node->capacity;
+            rec->cached_arenas--;
+            freed += node->capacity;
+            node->next = victims;
+            victims = node;
+        }
+    }
+    ARENA__UNLOCK(&rec->lock);
+
+    while (victims) {
+        arena__recycled_t *next = victims->next;
+        arena_destroy(&victims->arena);
+        ARENA_FREE(victims);
+        victims = next;
+    }
+
+    return freed;
+}
+
+ARENA_API arena_recycler_stats_t arena_recycler_stats(arena_recycler_t *rec) {
+    arena_recycler_stats_t stats = {0};
+    if (!rec) return stats;
+
+    ARENA__LOCK(&rec->lock);
+    stats.acquires = rec->acquires;
+    stats.hits = rec->hits;
+    stats.misses = rec->acquires - rec->hits;
+    stats.releases = rec->releases;
+    stats.evictions = rec->evictions;
+    stats.cached_arenas = rec->cached_arenas;
+    stats.cached_bytes = rec->cached_bytes;
+    ARENA__UNLOCK(&rec->lock);
+
+    stats.hit_rate = stats.acquires > 0 ? (double)stats.hits / (double)stats.acquires : 0.0;
+    return stats;
+}
+
+#endif // ARENA_BLOCK_CHAINING
+
 #ifdef ARENA_DEBUG
 
 ARENA_API void arena_set_name(arena_t *arena, const char *name) {
@@ -0,0 +1,366 @@
+/*
+ * bufpool.h , single header reference counted buffer pool on top of pool.h
+ *
+ * every buffer is one pool slot with a small header in front of the bytes
+ * the caller sees. the header holds an atomic reference count and the pool
+ * the buffer came from, so the same message can be handed to any number of
+ * readers without a copy: each reader holds a reference (or a slice, an
+ * offset/length view that holds one) and the last release puts the slot
+ * back in the pool.
+ *
+ * bufpool_retain and bufpool_release may be called from any thread. the
+ * last release frees the slot, so it follows the threading rules of the
+ * pool underneath:
+ *   - plain pool.h: alloc and every release on one thread (or under one lock).
+ *   - POOL_REMOTE_FREE: alloc stays on the owner thread, releases can come
+ *     from anywhere, the last one goes through pool_free_remote and the
+ *     owner takes the slot back on a later alloc.
+ *   - POOL_CONCURRENT: alloc and release from any thread.
+ *
+ * OPTIONS :
+ *   #define BUFPOOL_STATIC
+ *     make all functions static (for including in multiple translation units).
+ *
+ *   #define BUFPOOL_ASSERT(x)
+ *     custom assert macro, defaults to standard assert().
+ *
+ *   #define BUFPOOL_ALIGN n
+ *     alignment of the bytes handed out, a power of two, defaults to 16.
+ *     the header is padded to it, so it is also the per buffer overhead.
+ *
+ *   the POOL_* options apply as usual, define them the same way before every
+ *   include of bufpool.h and pool.h.
+ *
+ * USAGE :
+ *   bufpool.h includes pool.h, so define both implementations in one file:
+ *
+ *       #define POOL_IMPLEMENTATION
+ *       #define BUFPOOL_IMPLEMENTATION
+ *       #include "bufpool.h"
+ *
+ *   a message fanned out to two readers:
+ *
+ *       uint8_t memory[64 * 1024];
+ *       bufpool_t bp;
+ *       bufpool_init(&bp, memory, sizeof(memory), 1500);
+ *
+ *       uint8_t *msg = bufpool_alloc(&bp);                 // one reference
+ *       size_t len = recv_packet(msg, 1500);
+ *
+ *       bufpool_slice_t body = bufpool_slice(msg, 14, len - 14);  // two
+ *       reader_a_push(bufpool_slice_share(&body));          // three
+ *       reader_b_push(body);                                // the slice moves
+ *       bufpool_release(msg);                               // two left
+ *
+ *       // in each reader, when done with it
+ *       bufpool_slice_release(&slice);                      // the last one frees
+ *
+ * SLICES :
+ *   a bufpool_slice_t is a plain struct (data, length, buf) holding one
+ *   reference to buf. copying it does not take a reference, so a slice has
+ *   exactly one owner: hand it over as is, or give each extra reader its own
+ *   with bufpool_slice_share. bufpool_slice_sub narrows a slice to a part of
+ *   it (a header, a payload) and takes its own reference. a range outside
+ *   the buffer gives an empty slice (data NULL) and takes nothing.
+ *
+ * NOTES :
+ *   - the bufpool_t must stay at the same address while buffers are out,
+ *     every header points back to it.
+ *   - the pool underneath is bp.pool, pool_available, pool_stats and the
+ *     rest work on it as usual (a slot is the header plus the buffer).
+ *   - releasing a buffer more times than it was referenced asserts, and is
+ *     undefined with asserts off, the same as a double free.
+ *   - object caches (ctor/dtor in the config) are rejected, a buffer's
+ *     bytes are not kept between uses.
+ *
+ */
+
+
+#ifndef BUFPOOL_H_INCLUDED
+#define BUFPOOL_H_INCLUDED
+
+#include "pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef BUFPOOL_STATIC
+    #define BUFPOOL_API static
+#else
+    #define BUFPOOL_API extern
+#endif
+
+#ifndef BUFPOOL_ALIGN
+    #define BUFPOOL_ALIGN 16
+#endif
+
+typedef struct bufpool {
+    pool_t pool;
+    size_t buf_size;           // usable bytes per buffer
+} bufpool_t;
+
+// a view of length bytes at data, inside buf, holding one reference to buf.
+typedef struct bufpool_slice {
+    uint8_t *data;
+    size_t   length;
+    void    *buf;
+} bufpool_slice_t;
+
+// initializes a pool of buf_size byte buffers in the caller's memory.
+BUFPOOL_API int bufpool_init(bufpool_t *bp, void *buffer, size_t size, size_t buf_size);
+
+// same as bufpool_init, with the pool config of pool_init_ex (alignment 0 = BUFPOOL_ALIGN).
+BUFPOOL_API int bufpool_init_ex(bufpool_t *bp, void *buffer, size_t size, size_t buf_size, const pool_config_t *config);
+
+#ifdef POOL_DYNAMIC
+// initializes a growable pool of buf_size byte buffers, see pool_init_dynamic.
+BUFPOOL_API int bufpool_init_dynamic(bufpool_t *bp, size_t buf_size, const pool_dynamic_config_t *config);
+#endif
+
+// destroys the pool, every buffer has to be released by then.
+BUFPOOL_API void bufpool_destroy(bufpool_t *bp);
+
+// returns a buffer of buf_size bytes with one reference, or NULL when the pool is full.
+BUFPOOL_API void *bufpool_alloc(bufpool_t *bp);
+
+// takes one more reference to buf and returns it.
+BUFPOOL_API void *bufpool_retain(void *buf);
+
+// drops one reference, the last one frees the buffer. returns a pool_error_t.
+BUFPOOL_API int bufpool_release(void *buf);
+
+// current number of references, only a snapshot while other threads hold some.
+BUFPOOL_API size_t bufpool_refcount(const void *buf);
+
+// usable bytes of every buffer of bp.
+BUFPOOL_API size_t bufpool_buf_size(const bufpool_t *bp);
+
+// a slice of length bytes at offset in buf, taking one reference.
+BUFPOOL_API bufpool_slice_t bufpool_slice(void *buf, size_t offset, size_t length);
+
+// a slice of length bytes at offset inside slice, taking one reference.
+BUFPOOL_API bufpool_slice_t bufpool_slice_sub(const bufpool_slice_t *slice, size_t offset, size_t length);
+
+// a copy of slice with its own reference, for one more reader.
+BUFPOOL_API bufpool_slice_t bufpool_slice_share(const bufpool_slice_t *slice);
+
+// drops the slice's reference and empties it. returns a pool_error_t.
+BUFPOOL_API int bufpool_slice_release(bufpool_slice_t *slice);
+
+// bytes of memory bufpool_init needs for count buffers of buf_size bytes.
+BUFPOOL_API size_t bufpool_required_size(size_t buf_size, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#ifdef BUFPOOL_IMPLEMENTATION
+
+#include <string.h>
+
+#ifndef BUFPOOL_ASSERT
+    #include <assert.h>
+    #define BUFPOOL_ASSERT(x) assert(x)
+#endif
+
+#if (BUFPOOL_ALIGN & (BUFPOOL_ALIGN - 1)) != 0
+    #error "BUFPOOL_ALIGN must be a power of two"
+#endif
+
+// the count is a long so msvc can use the interlocked intrinsics. the final
+// decrement is acq_rel, so every reader's access happens before the free.
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    #define BUFPOOL__INC(p)  _InterlockedIncrement((volatile long *)(p))
+    #define BUFPOOL__DEC(p)  _InterlockedDecrement((volatile long *)(p))
+    #define BUFPOOL__LOAD(p) (*(volatile const long *)(p))
+#else
+    #define BUFPOOL__INC(p)  __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+    #define BUFPOOL__DEC(p)  __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+    #define BUFPOOL__LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#endif
+
+typedef struct bufpool__header {
+    bufpool_t *owner;
+    long       refs;
+} bufpool__header_t;
+
+// the header padded so the bytes after it keep the slot's alignment.
+#define BUFPOOL__HEADER_SIZE \
+    ((sizeof(bufpool__header_t) + (size_t)BUFPOOL_ALIGN - 1) & ~((size_t)BUFPOOL_ALIGN - 1))
+
+static bufpool__header_t *bufpool__header(const void *buf) {
+    return (bufpool__header_t *)((uint8_t *)buf - BUFPOOL__HEADER_SIZE);
+}
+
+static bufpool_slice_t bufpool__empty_slice(void) {
+    bufpool_slice_t slice;
+    slice.data = NULL;
+    slice.length = 0;
+    slice.buf = NULL;
+    return slice;
+}
+
+// the pool config with the slot aligned for the header, 0 when it can not back buffers.
+static int bufpool__config(pool_config_t *out, const pool_config_t *config) {
+    pool_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+
+    // a cached object would be overwritten by the header on every alloc
+    if (cfg.ctor != NULL || cfg.dtor != NULL) return 0;
+    if (cfg.alignment < BUFPOOL_ALIGN) cfg.alignment = BUFPOOL_ALIGN;
+
+    *out = cfg;
+    return 1;
+}
+
+BUFPOOL_API int bufpool_init(bufpool_t *bp, void *buffer, size_t size, size_t buf_size) {
+    return bufpool_init_ex(bp, buffer, size, buf_size, NULL);
+}
+
+BUFPOOL_API int bufpool_init_ex(bufpool_t *bp, void *buffer, size_t size, size_t buf_size, const pool_config_t *config) {
+    if (bp == NULL) return POOL_ERR_NULL_POOL;
+    if (buf_size == 0 || buf_size > SIZE_MAX - BUFPOOL__HEADER_SIZE) return POOL_ERR_INVALID_SLOT_SIZE;
+
+    pool_config_t cfg;
+    if (!bufpool__config(&cfg, config)) return POOL_ERR_INVALID_CONFIG;
+
+    int err = pool_init_ex(&bp->pool, buffer, size, BUFPOOL__HEADER_SIZE + buf_size, &cfg);
+    if (err != POOL_OK) return err;
+
+    bp->buf_size = buf_size;
+    return POOL_OK;
+}
+
+#ifdef POOL_DYNAMIC
+BUFPOOL_API int bufpool_init_dynamic(bufpool_t *bp, size_t buf_size, const pool_dynamic_config_t *config) {
+    if (bp == NULL) return POOL_ERR_NULL_POOL;
+    if (buf_size == 0 || buf_size > SIZE_MAX - BUFPOOL__HEADER_SIZE) return POOL_ERR_INVALID_SLOT_SIZE;
+
+    pool_dynamic_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    if (cfg.alignment < BUFPOOL_ALIGN) cfg.alignment = BUFPOOL_ALIGN;
+
+    int err = pool_init_dynamic(&bp->pool, BUFPOOL__HEADER_SIZE + buf_size, &cfg);
+    if (err != POOL_OK) return err;
+
+    bp->buf_size = buf_size;
+    return POOL_OK;
+}
+#endif
+
+BUFPOOL_API void bufpool_destroy(bufpool_t *bp) {
+    if (bp == NULL) return;
+    pool_destroy(&bp->pool);
+    bp->buf_size = 0;
+}
+
+BUFPOOL_API void *bufpool_alloc(bufpool_t *bp) {
+    if (bp == NULL) return NULL;
+
+    bufpool__header_t *header = (bufpool__header_t *)pool_alloc(&bp->pool);
+    if (header == NULL) return NULL;
+
+    // nobody else can see the buffer yet, handing it over publishes the header
+    header->owner = bp;
+    header->refs = 1;
+    return (uint8_t *)header + BUFPOOL__HEADER_SIZE;
+}
+
+BUFPOOL_API void *bufpool_retain(void *buf) {
+    if (buf == NULL) return NULL;
+
+    long refs = BUFPOOL__INC(&bufpool__header(buf)->refs);
+    BUFPOOL_ASSERT(refs > 1 && "bufpool_retain on a released buffer");
+    (void)refs;
+    return buf;
+}
+
+BUFPOOL_API int bufpool_release(void *buf) {
+    if (buf == NULL) return POOL_ERR_NULL_PTR;
+
+    bufpool__header_t *header = bufpool__header(buf);
+    bufpool_t *owner = header->owner;
+    long refs = BUFPOOL__DEC(&header->refs);
+    if (refs > 0) return POOL_OK;
+
+    BUFPOOL_ASSERT(refs == 0 && "bufpool_release on a released buffer");
+    if (refs < 0) return POOL_ERR_DOUBLE_FREE;
+
+#ifdef POOL_REMOTE_FREE
+    // the last reader may be any thread, the owner takes the slot back on its next alloc
+    return pool_free_remote(&owner->pool, header);
+#else
+    return pool_free(&owner->pool, header);
+#endif
+}
+
+BUFPOOL_API size_t bufpool_refcount(const void *buf) {
+    if (buf == NULL) return 0;
+    long refs = BUFPOOL__LOAD(&bufpool__header(buf)->refs);
+    return refs > 0 ? (size_t)refs : 0;
+}
+
+BUFPOOL_API size_t bufpool_buf_size(const bufpool_t *bp) {
+    return bp ? bp->buf_size : 0;
+}
+
+BUFPOOL_API bufpool_slice_t bufpool_slice(void *buf, size_t offset, size_t length) {
+    if (buf == NULL) return bufpool__empty_slice();
+
+    size_t size = bufpool__header(buf)->owner->buf_size;
+    if (offset > size || length > size - offset) return bufpool__empty_slice();
+
+    bufpool_slice_t slice;
+    slice.data = (uint8_t *)bufpool_retain(buf) + offset;
+    slice.length = length;
+    slice.buf = buf;
+    return slice;
+}
+
+BUFPOOL_API bufpool_slice_t bufpool_slice_sub(const bufpool_slice_t *slice, size_t offset, size_t length) {
+    if (slice == NULL || slice->buf == NULL) return bufpool__empty_slice();
+    if (offset > slice->length || length > slice->length - offset) return bufpool__empty_slice();
+
+    bufpool_slice_t sub;
+    sub.data = slice->data + offset;
+    sub.length = length;
+    sub.buf = bufpool_retain(slice->buf);
+    return sub;
+}
+
+BUFPOOL_API bufpool_slice_t bufpool_slice_share(const bufpool_slice_t *slice) {
+    if (slice == NULL || slice->buf == NULL) return bufpool__empty_slice();
+
+    bufpool_slice_t copy = *slice;
+    bufpool_retain(copy.buf);
+    return copy;
+}
+
+BUFPOOL_API int bufpool_slice_release(bufpool_slice_t *slice) {
+    if (slice == NULL) return POOL_ERR_NULL_PTR;
+    if (slice->buf == NULL) return POOL_OK;
+
+    int err = bufpool_release(slice->buf);
+    *slice = bufpool__empty_slice();
+    return err;
+}
+
+BUFPOOL_API size_t bufpool_required_size(size_t buf_size, size_t count) {
+    pool_config_t cfg;
+    bufpool__config(&cfg, NULL);
+    return pool_required_size_ex(BUFPOOL__HEADER_SIZE + buf_size, count, &cfg);
+}
+
+#endif // BUFPOOL_IMPLEMENTATION
@@ -0,0 +1,70 @@
+/*
+ * examples for bufpool.h
+ *
+ * compile:
+ *   gcc -std=c11 -O2 -o example_bufpool example_bufpool.c
+ *
+ * with readers on other threads:
+ *   gcc -std=c11 -O2 -DPOOL_REMOTE_FREE -o example_bufpool example_bufpool.c -lpthread
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#define POOL_IMPLEMENTATION
+#define BUFPOOL_IMPLEMENTATION
+#include "../bufpool.h"
+
+
+// a reader that only looks at the part of the message it cares about
+static void reader_print(const char *name, bufpool_slice_t *slice) {
+    printf("  %s got %zu bytes \"%.*s\"\n", name, slice->length, (int)slice->length, (const char *)slice->data);
+
+    // done with it, the last reader gives the buffer back
+    bufpool_slice_release(slice);
+}
+
+void example_fanout(void) {
+    static uint8_t memory[16 * 1024];
+    bufpool_t bp;
+
+    // 512 byte buffers, each one is a single pool slot with a small header
+    if (bufpool_init(&bp, memory, sizeof(memory), 512) != POOL_OK) return;
+    printf("  %zu buffers of %zu bytes\n", pool_capacity(&bp.pool), bufpool_buf_size(&bp));
+
+    // receive one message, a fixed size header and a body
+    uint8_t *msg = bufpool_alloc(&bp);
+    const char *wire = "HDR1price update: 101.25";
+    size_t len = strlen(wire);
+    memcpy(msg, wire, len);
+
+    // each reader gets its own slice of the same bytes, nothing is copied
+    bufpool_slice_t body = bufpool_slice(msg, 4, len - 4);
+    bufpool_slice_t logger = bufpool_slice_share(&body);
+    bufpool_slice_t trader = bufpool_slice_share(&body);
+    bufpool_slice_t price = bufpool_slice_sub(&body, 14, 6);
+
+    // the receiver is done, the readers keep the buffer alive
+    bufpool_release(msg);
+    printf("  %zu references after the receiver let go\n", bufpool_refcount(msg));
+
+    reader_print("logger", &logger);
+    reader_print("trader", &trader);
+    reader_print("ticker", &price);
+    reader_print("archive", &body);
+
+#ifdef POOL_REMOTE_FREE
+    // the last release went through the remote list, take it back now
+    pool_drain_remote(&bp.pool);
+#endif
+    printf("  %zu of %zu buffers free\n", pool_available(&bp.pool), pool_capacity(&bp.pool));
+
+    bufpool_destroy(&bp);
+    printf("\n");
+}
+
+
+int main(void) {
+    example_fanout();
+    return 0;
+}
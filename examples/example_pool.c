@@ -209,6 +209,69 @@ void example_stats(void) {
     printf("\n");
 }
 
+// another example, a typed pool with static storage and no pool_t
+
+POOL_DEFINE(entities, Entity, 64)
+
+void example_typed_pool(void) {
+    Entity *a = entities_alloc();
+    Entity *b = entities_alloc();
+
+    a->x = 1;
+    snprintf(b->name, sizeof(b->name), "typed");
+
+    printf("entities owns a: %s\n", entities_owns(a) ? "yes" : "no");
+    printf("b->name = %s\n", b->name);
+    int freed = entities_free(a) == POOL_OK && entities_free(b) == POOL_OK;
+    printf("freed both: %s\n", freed ? "yes" : "no");
+
+    printf("\n");
+}
+
+// another example, an object cache keeps the buffer each connection owns across alloc and free
+
+typedef struct {
+    int   id;
+    char *scratch;
+} Connection;
+
+static void connection_init(void *obj, void *ctx) {
+    Connection *c = (Connection *)obj;
+    c->id = ++*(int *)ctx;
+    c->scratch = (char *)malloc(256);
+}
+
+static void connection_fini(void *obj, void *ctx) {
+    free(((Connection *)obj)->scratch);
+    (void)ctx;
+}
+
+void example_object_cache(void) {
+    int constructed = 0;
+    pool_config_t cfg = {0};
+    cfg.engine = POOL_ENGINE_STACK;
+    cfg.ctor = connection_init;
+    cfg.dtor = connection_fini;
+    cfg.cache_ctx = &constructed;
+
+    unsigned char buffer[1024];
+    pool_t pool;
+    pool_init_ex(&pool, buffer, sizeof(buffer), sizeof(Connection), &cfg);
+
+    // a thousand requests, but only the first one pays for the malloc
+    for (int i = 0; i < 1000; i++) {
+        Connection *c = (Connection *)pool_alloc(&pool);
+        snprintf(c->scratch, 256, "request %d on connection %d", i, c->id);
+        pool_free(&pool, c);
+    }
+    printf("connections constructed: %d\n", constructed);
+
+    // destroy runs the dtor on every constructed connection
+    pool_destroy(&pool);
+
+    printf("\n");
+}
+
 
 int main(void) {
 
@@ -218,6 +281,8 @@ int main(void) {
     example_ownership();
     example_reset();
     example_stats();
+    example_typed_pool();
+    example_object_cache();
 
     return 0;
 }
\ No newline at end of file
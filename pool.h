@@ -4,13 +4,19 @@
  * this is fixed size slot allocator with o(1) allocation and free
  * with an embedded free list stored directly in free slots for zero overhead
  *
+ * slots that were never used are handed out from a bump cursor and only
+ * join the free list once freed, so pool_init and pool_reset are o(1) and
+ * never write to slot memory (untouched pages stay unfaulted).
+ *
  * this is not thread safe, if used across threads, you must provide
- * your own external synchronization (mutex, spinlock, etc.).
+ * your own external synchronization (mutex, spinlock, etc.), or build
+ * with POOL_CONCURRENT for a lock-free pool_alloc/pool_free.
  *
  * notes on release mode:
  * double free in release mode (without POOL_DEBUG) corrupts the free list
  * and leads to undefined behavior (infinite loops, crashes), always test
- * with POOL_DEBUG enabled during developmenet
+ * with POOL_DEBUG enabled during developmenet, or keep POOL_HARDENED on
+ * in production to catch most of it for a few cycles per operation
  *
  * OPTIONS :
  *   #define POOL_STATIC
@@ -29,15 +35,359 @@
  *   #define POOL_MEMCPY
  *     custom memcpy function, defaults to standard memcpy().
  *
+ *   #define POOL_HARDENED
+ *     cheap release mode checks on the free list, see HARDENING below.
+ *     not compatible with POOL_CONCURRENT.
+ *
  *   #define POOL_ZERO_ON_ALLOC
  *     zero memory when allocating a slot.
  *
  *   #define POOL_ZERO_ON_FREE
  *     zero memory when freeing a slot (security feature).
  *
+ *   #define POOL_DEFERRED_ZERO
+ *     with POOL_ZERO_ON_FREE, park freed slots on a dirty list and zero them
+ *     later in batches (pool_scrub), see DEFERRED ZEROING below. not
+ *     compatible with POOL_CONCURRENT.
+ *
  *   #define POOL_ALIGN n
  *     minimum alignment for slots, defaults to sizeof(void*).
- *     set to 16 for sse, 32 for avx, etc.
+ *     set to 16 for sse, 32 for avx, etc. a pool can override it with the
+ *     alignment field of its config, see ALIGNMENT below.
+ *
+ *   #define POOL_CONCURRENT
+ *     make pool_alloc and pool_free lock-free and safe to call from any
+ *     thread, see CONCURRENT POOLS below. not compatible with POOL_DYNAMIC.
+ *
+ *   #define POOL_REMOTE_FREE
+ *     let other threads free into a single owner pool through a lock-free
+ *     queue (pool_free_remote), see REMOTE FREES below. not compatible with
+ *     POOL_CONCURRENT.
+ *
+ *   #define POOL_MAGAZINES
+ *     enable per-thread magazine caches (pool_depot_t / pool_cache_t) in
+ *     front of a pool, see MAGAZINES below.
+ *
+ *   #define POOL_MAGAZINE_SIZE n
+ *     default rounds per magazine when pool_depot_init gets 0, defaults to 32.
+ *
+ *   #define POOL_DYNAMIC
+ *     enable growable pools (pool_init_dynamic) that chain extra chunks from a
+ *     backing allocator when the free list runs dry.
+ *
+ *   #define POOL_SYS_MALLOC / POOL_SYS_FREE
+ *     custom allocator for dynamic pool chunks and magazines, defaults to
+ *     malloc()/free().
+ *
+ *   #define POOL_SYS_ALIGNED_MALLOC(size, align) / POOL_SYS_ALIGNED_FREE
+ *     custom aligned allocator for malloc backed dynamic pool chunks,
+ *     defaults to aligned_alloc, posix_memalign or _aligned_malloc. with a
+ *     custom POOL_SYS_MALLOC and no aligned pair, each chunk over-allocates
+ *     twice its size to find an aligned start.
+ *
+ *   #define POOL_CHUNK_SIZE n
+ *     default chunk size in bytes for dynamic pools, must be a power of two,
+ *     defaults to 65536.
+ *
+ *   #define POOL_PAGE_SIZE n
+ *     page size pool_compact assumes when it gives free tail pages back to
+ *     the os, defaults to 4096.
+ *
+ *   #define POOL_NEAR_PAGES n
+ *     pages on each side of the hint's page pool_alloc_near looks at before
+ *     it falls back to pool_alloc, defaults to 2.
+ *
+ *   #define POOL_HANDLE_INDEX_BITS n
+ *     bits of a pool_handle_t used for the slot index (16 to 24), the rest
+ *     hold the generation. defaults to 20 (about a million slots, 4095
+ *     generations before a slot's handles repeat).
+ *
+ * ENGINES:
+ *   pool_init_ex picks how a pool tracks its free slots.
+ *
+ *   POOL_ENGINE_FREELIST (default, what pool_init uses) keeps the embedded
+ *   lifo free list described above. fastest alloc and free, but reuse order
+ *   follows free order, so live slots scatter over time.
+ *
+ *   slots smaller than a pointer (1, 2 or 4 byte objects) would be rounded
+ *   up to hold a link, so pool_init (and a null config) puts them on the
+ *   bitmap engine instead: slot_size bytes plus about one bit per slot. with
+ *   POOL_CONCURRENT, whose links are 32-bit indices, they take 4 bytes.
+ *
+ *   POOL_ENGINE_BITMAP keeps one bit per slot plus a summary word per 4096
+ *   slots, both stored after the slots. alloc takes the lowest free slot
+ *   (two ctz instructions), so live slots stay packed at the start of the
+ *   buffer. nothing is written into free slots, so a slot can be as small as
+ *   one byte, and a free of a slot that is already free is caught even
+ *   without POOL_DEBUG. init and reset clear the bitmap, o(slots / 8) bytes.
+ *   not available with POOL_CONCURRENT, dynamic pools always use the free list.
+ *
+ *   POOL_ENGINE_STACK keeps the free slots as a dense stack of 32-bit slot
+ *   indices after the slots, 4 bytes per slot. reuse is lifo like the free
+ *   list, but alloc and free only touch the top of one hot array instead of
+ *   loading the link out of a slot that has gone cold, and bulk alloc and
+ *   free walk the array. like the bitmap engine nothing is written into
+ *   free slots, and a free of a slot that was never handed out (or one
+ *   free too many, or a slot listed twice in one bulk free) is caught
+ *   without POOL_DEBUG. init and reset stay o(1).
+ *   not available with POOL_CONCURRENT.
+ *
+ *   config.reuse picks which free slot comes back next:
+ *     POOL_REUSE_DEFAULT   the engine's own order (lifo / lowest address).
+ *     POOL_REUSE_LIFO      the slot freed last, freelist or stack engine.
+ *     POOL_REUSE_ADDRESS   the lowest free slot. a freelist pool runs on the
+ *                          bitmap engine's index for this, keeping its own
+ *                          slot size rules.
+ *     POOL_REUSE_PAGE      a slot on the page (POOL_PAGE_SIZE) with the most
+ *                          live objects, so objects used together stay on
+ *                          few pages and emptied pages stay cold. each page
+ *                          keeps its own free list, pages sit in buckets by
+ *                          free count, 24 bytes per page after the slots.
+ *                          freelist engine only.
+ *   pool_sort_free_list puts a lifo list (every page list, or the index
+ *   stack) back into address order, one pass over the occupancy bitmap when
+ *   the pool has one, otherwise an in place sort. call it when idle.
+ *
+ *   pool_alloc_near(pool, hint) hands out a free slot on the page of hint
+ *   (any pointer into the pool) or the closest page within POOL_NEAR_PAGES,
+ *   so a child node lands next to its parent. page affine pools pick from
+ *   the per page lists, including the never used slots, and the bitmap
+ *   index picks the free bit closest to the hint. other pools, or no free
+ *   slot close enough, behave like pool_alloc.
+ *
+ *   pool_alloc_run(pool, n) hands out n adjacent slots, a small array of
+ *   records from the same pool as the single objects, pool_free_run gives
+ *   them back. bitmap indexed pools find the lowest run of n free slots a
+ *   64 bit word at a time: whole free words extend a run, a run inside a
+ *   word shows up after log2(n) shift-and steps, and the summary skips
+ *   4096 full slots per compare. other pools cut runs from the never used
+ *   slots only, freed runs go back slot by slot. a dynamic pool's run has to
+ *   fit in one chunk, when the current chunk's never used tail is too short
+ *   the tail goes on the free list and the run comes from the next chunk,
+ *   growing the pool as pool_alloc would. not available with POOL_CONCURRENT.
+ *
+ *   POOL_FLAG_OCCUPANCY gives a free list pool the same one bit per slot
+ *   occupancy bitmap (the bitmap engine always has it), kept in release
+ *   builds too. it costs a bit write per alloc and free and slots / 8 bytes.
+ *
+ * ITERATION:
+ *   pools with an occupancy bitmap can walk their live slots in address
+ *   order, 64 slots per bitmap word, skipping empty words with one compare.
+ *   the callback (or loop body) may free the slot it was handed.
+ *
+ *       static int update(void *slot, void *ctx) { ...; return 0; }  // non zero stops
+ *       pool_foreach_allocated(&pool, update, NULL);
+ *
+ *       pool_iter_t it;
+ *       pool_iter_init(&it, &pool);
+ *       for (Entity *e; (e = (Entity *)pool_iter_next(&it)) != NULL; ) { ... }
+ *
+ *       pool_config_t cfg = {0};
+ *       cfg.engine = POOL_ENGINE_BITMAP;
+ *       size_t size = pool_required_size_ex(sizeof(uint16_t), 1000, &cfg);
+ *       pool_init_ex(&pool, buffer, size, sizeof(uint16_t), &cfg);
+ *
+ * HANDLES:
+ *   with POOL_FLAG_HANDLES a pool keeps a 16-bit generation per slot after
+ *   the slots. pool_alloc_handle returns a 32-bit pool_handle_t packing the
+ *   slot index with its generation, and every free bumps the generation, so
+ *   pool_resolve turns a stale handle into null with a single compare
+ *   instead of handing back a slot that now belongs to someone else.
+ *   pool_reset bumps every generation, o(slots). a handle pool holds at
+ *   most 2^POOL_HANDLE_INDEX_BITS slots, the rest of a larger buffer is
+ *   left unused. not available with POOL_CONCURRENT.
+ *
+ *       pool_handle_t h = pool_alloc_handle(&pool);
+ *       Entity *e = (Entity *)pool_resolve(&pool, h);   // null once freed
+ *       pool_free_handle(&pool, h);
+ *
+ * COMPACTION:
+ *   POOL_FLAG_RELOCATABLE (bitmap engine only, implies POOL_FLAG_HANDLES)
+ *   adds a two way table between handles and slots, 8 bytes per slot.
+ *   pool_compact(&pool, budget) then moves up to budget live objects from
+ *   the highest live slots into the lowest free ones, memcpy plus a table
+ *   update, so their handles keep resolving. once nothing is left to move,
+ *   the whole free pages past the last live slot are handed back to the os
+ *   (madvise / MEM_RESET). call it with a small budget every frame to
+ *   spread the work. objects move, so keep handles and resolve them again
+ *   after a compaction, raw pointers into a relocatable pool go stale.
+ *
+ * OBJECT CACHES:
+ *   a pool can keep its objects constructed between uses, the way a slab
+ *   allocator's object cache does. give the config a ctor and a dtor:
+ *   ctor runs once on a slot the first time it is handed out, dtor once on
+ *   every slot that was ever constructed when the pool is reset or
+ *   destroyed. pool_free leaves the object alone and the next pool_alloc
+ *   hands it out as it was, so a lock, a buffer pointer or a list head set
+ *   up by the ctor survives any number of alloc / free rounds. the free
+ *   slot is never written, so the engine must keep its links outside the
+ *   slots: POOL_ENGINE_BITMAP, POOL_ENGINE_STACK or POOL_REUSE_ADDRESS.
+ *   a free list engine, POOL_REUSE_PAGE or POOL_FLAG_RELOCATABLE (which
+ *   moves objects over constructed slots) give POOL_ERR_INVALID_CONFIG.
+ *   POOL_ZERO_ON_ALLOC and POOL_ZERO_ON_FREE skip cached slots, and debug
+ *   builds do not poison them, POOL_ZERO_ON_FREE clears a slot after its
+ *   dtor instead.
+ *
+ *       static void conn_init(void *obj, void *ctx) { ((Conn *)obj)->buf = malloc(4096); }
+ *       static void conn_fini(void *obj, void *ctx) { free(((Conn *)obj)->buf); }
+ *
+ *       pool_config_t cfg = {0};
+ *       cfg.engine = POOL_ENGINE_STACK;
+ *       cfg.ctor = conn_init;
+ *       cfg.dtor = conn_fini;
+ *       pool_init_ex(&pool, buffer, size, sizeof(Conn), &cfg);
+ *       Conn *c = (Conn *)pool_alloc(&pool);   // c->buf is already there
+ *       pool_free(&pool, c);                    // and stays for the next one
+ *
+ * HARDENING:
+ *   with POOL_HARDENED the next pointer a free slot keeps is stored xor
+ *   (slot address >> 12), glibc safe-linking style, so a stray write into
+ *   a freed slot or a forged link decodes to an address that fails the
+ *   check on pop: a link must be null or the start of a slot this pool has
+ *   handed out. a failed check fires POOL_ASSERT and pool_alloc returns
+ *   null, leaving the broken link in place. define POOL_ASSERT to abort if
+ *   the process should die instead.
+ *   freeing the slot at the head of the free list returns
+ *   POOL_ERR_DOUBLE_FREE. slots of two pointers or more also get a per pool
+ *   key in their second word while free, and a free that finds the key
+ *   walks the list to confirm before reporting the double free. applies to
+ *   the freelist engine, the bitmap engine has no links to protect.
+ *
+ * TYPED POOLS:
+ *   POOL_DEFINE(name, Type, Count) expands to a pool of Count Type objects
+ *   in static (bss) storage plus name_alloc, name_free and name_owns. there
+ *   is no pool_t: slot size, count and alignment are compile time constants,
+ *   so the ownership check and slot math fold down to constants and the
+ *   functions inline to a few instructions. slots are aligned for Type and
+ *   never smaller than a pointer. POOL_ZERO_ON_ALLOC, POOL_ZERO_ON_FREE and
+ *   POOL_DEBUG (double free detection) apply, POOL_CONCURRENT does not.
+ *
+ *       POOL_DEFINE(particles, Particle, 1024)
+ *
+ *       Particle *p = particles_alloc();
+ *       particles_free(p);
+ *
+ * DYNAMIC POOLS:
+ *   a dynamic pool owns its memory. it starts with one chunk and adds more
+ *   (1, 2, 4, ... chunks per step with POOL_GROW_GEOMETRIC, one with
+ *   POOL_GROW_LINEAR) whenever the free list is empty. every chunk is aligned
+ *   to its own size, so pool_owns() masks the pointer down to the chunk header
+ *   and confirms it in a small hash set instead of walking the chunks.
+ *   the free list threads through all chunks, alloc and free stay o(1).
+ *   malloc backed chunks come from an aligned allocation, mapped chunks
+ *   have to be at least a page (the allocation granularity on windows),
+ *   a smaller chunk_size gives POOL_ERR_INVALID_CONFIG.
+ *
+ *       pool_dynamic_config_t cfg = {0};
+ *       cfg.backing = POOL_BACKING_MMAP;
+ *       pool_init_dynamic(&pool, sizeof(Entity), &cfg);
+ *       ...
+ *       pool_destroy(&pool);   // releases every chunk
+ *
+ * ALIGNMENT:
+ *   POOL_ALIGN is the default for every pool, the alignment field of
+ *   pool_config_t (pool_dynamic_config_t for dynamic pools) sets it per
+ *   pool: 64 puts every slot on its own cache lines so objects handed to
+ *   different threads never share one, 8 packs small records tightly next
+ *   to it. slots are rounded up to a multiple of the alignment (free list
+ *   slots to at least a pointer's), a value that is not a power of two gives
+ *   POOL_ERR_INVALID_ALIGNMENT.
+ *
+ *   every chunk of a dynamic pool starts at a multiple of the chunk size,
+ *   so slot k of every chunk lands in the same cache sets. color_step in
+ *   pool_dynamic_config_t shifts the slots of each new chunk by another
+ *   color_step bytes (slab style cache coloring), cycling through the slack
+ *   the chunk has left after its last slot, so equal slots of different
+ *   chunks spread over the cache. 0 turns it off, it is rounded up to the
+ *   alignment.
+ *
+ *       pool_config_t cfg = {0};
+ *       cfg.alignment = 64;
+ *       pool_init_ex(&pool, buffer, size, sizeof(Counter), &cfg);
+ *
+ * CONCURRENT POOLS:
+ *   with POOL_CONCURRENT the free list is a treiber stack. the head is one
+ *   64-bit word holding the index of the top slot and a tag that changes on
+ *   every push and pop, so a stale compare-and-swap (the aba case) fails
+ *   instead of corrupting the list. free slots store the next index (32-bit)
+ *   where they normally keep the next pointer, which caps a pool at 2^32-2
+ *   slots. free_count is kept with atomic adds and is exact once the pool is
+ *   quiet, under contention it may briefly overstate the free slots.
+ *   pool_init, pool_reset and pool_destroy are still single threaded.
+ *
+ * MAGAZINES:
+ *   a magazine is a small stack of free slots. each thread owns a
+ *   pool_cache_t holding two magazines (loaded and previous) and allocates
+ *   and frees against them without touching shared memory. only when both
+ *   are empty (alloc) or both are full (free) does the cache visit the
+ *   shared pool_depot_t, trading a whole magazine under a short spinlock.
+ *   the depot also serializes every access to the underlying pool, so the
+ *   pool itself does not have to be thread safe.
+ *
+ *       pool_depot_t depot;
+ *       pool_depot_init(&depot, &pool, 0);
+ *
+ *       // per thread
+ *       pool_cache_t cache;
+ *       pool_cache_init(&cache, &depot);
+ *       void *p = pool_cache_alloc(&cache);
+ *       pool_cache_free(&cache, p);
+ *       pool_cache_flush(&cache);      // on thread exit
+ *
+ *       pool_depot_destroy(&depot);    // after every cache is flushed
+ *
+ *   slots sitting in magazines count as used by the pool. a cache can keep
+ *   up to two magazines worth of slots away from other threads until it is
+ *   flushed, so size the pool for threads * 2 * magazine_size of slack.
+ *
+ * DEFERRED ZEROING:
+ *   POOL_ZERO_ON_FREE clears every slot inside pool_free and the whole used
+ *   part of the buffer inside pool_reset. with POOL_DEFERRED_ZERO as well,
+ *   pool_free only links the slot on a dirty list and pool_reset only
+ *   remembers how far the buffer was used. pool_scrub(&pool, budget) then
+ *   zeroes up to budget slots with streaming (non-temporal) 16 byte stores
+ *   where the target has sse2, so the zeroing does not push hot data out of
+ *   the cache, and hands them back to the free index. call it from an idle
+ *   hook, or from a housekeeping thread under the same lock as the pool.
+ *
+ *       pool_free(&pool, msg);           // a link store, no memset
+ *       ...
+ *       pool_scrub(&pool, 256);          // when idle, 0 scrubs everything
+ *
+ *   no dirty slot is ever handed out. allocs take scrubbed and never used
+ *   slots first, and only once those run out pop the oldest dirty slot and
+ *   zero that one slot, so an alloc never pays for more than its own slot
+ *   and the rest of the backlog waits for pool_scrub. freed slots therefore
+ *   do not come back last freed first until they are scrubbed. a never used
+ *   slot below the mark of a deferred reset is zeroed as it is handed out.
+ *   pool_sort_free_list scrubs everything first. dirty slots count as free
+ *   in pool_available and pool_stats. bitmap and stack engine pools, object
+ *   caches and slots smaller than a pointer keep zeroing on free, dynamic
+ *   pools defer their frees but not pool_reset.
+ *
+ * REMOTE FREES:
+ *   with POOL_REMOTE_FREE a pool keeps one owner thread, which is the only
+ *   one calling pool_alloc, pool_free and the rest, and any other thread may
+ *   hand slots back with pool_free_remote. a remote free stores the next
+ *   pointer in the slot and pushes it on the pool's remote list with one
+ *   compare-and-swap. the owner takes the whole list with one exchange and
+ *   frees the slots locally, either when pool_alloc or a bulk alloc finds
+ *   too few free slots or when it calls pool_drain_remote itself. the owner's
+ *   fast path stays plain loads and stores, a remote free never touches the
+ *   free list, and taking the whole list at once has no aba case.
+ *
+ *       // consumer thread
+ *       pool_free_remote(&pool, msg);
+ *
+ *       // owner thread
+ *       Message *m = (Message *)pool_alloc(&pool);   // drains when it runs dry
+ *
+ *   a remote free only checks the pointer is in range, the owner runs the
+ *   full checks when it drains. slots on the remote list count as used until
+ *   then. the slot must hold a pointer and is overwritten, so pools with
+ *   slots smaller than a pointer and object caches give POOL_ERR_UNSUPPORTED.
+ *   dynamic pools skip the range check, the chunk table belongs to the owner.
+ *   pool_reset drops the remote list, pool_destroy drains it first.
  *
  * SMALL EXAMPLE:
  *   #define POOL_IMPLEMENTATION
@@ -93,6 +443,60 @@ extern "C" {
     #define POOL_ALIGN sizeof(void*)
 #endif
 
+#if defined(POOL_CONCURRENT) && defined(POOL_DYNAMIC)
+    #error "POOL_CONCURRENT does not support POOL_DYNAMIC"
+#endif
+
+#if defined(POOL_CONCURRENT) && defined(POOL_HARDENED)
+    #error "POOL_CONCURRENT does not support POOL_HARDENED"
+#endif
+
+#if defined(POOL_CONCURRENT) && defined(POOL_REMOTE_FREE)
+    #error "POOL_CONCURRENT does not support POOL_REMOTE_FREE"
+#endif
+
+#if defined(POOL_DEFERRED_ZERO) && (defined(POOL_CONCURRENT) || !defined(POOL_ZERO_ON_FREE))
+    #error "POOL_DEFERRED_ZERO needs POOL_ZERO_ON_FREE and does not support POOL_CONCURRENT"
+#endif
+
+#ifndef POOL_HANDLE_INDEX_BITS
+    #define POOL_HANDLE_INDEX_BITS 20
+#endif
+
+#if POOL_HANDLE_INDEX_BITS < 16 || POOL_HANDLE_INDEX_BITS > 24
+    #error "POOL_HANDLE_INDEX_BITS must be between 16 and 24"
+#endif
+
+#ifndef POOL_PAGE_SIZE
+    #define POOL_PAGE_SIZE 4096
+#endif
+
+#if (POOL_PAGE_SIZE & (POOL_PAGE_SIZE - 1)) != 0
+    #error "POOL_PAGE_SIZE must be a power of two"
+#endif
+
+#ifndef POOL_NEAR_PAGES
+    #define POOL_NEAR_PAGES 2
+#endif
+
+#ifdef POOL_DYNAMIC
+    #ifndef POOL_CHUNK_SIZE
+        #define POOL_CHUNK_SIZE 65536
+    #endif
+#endif
+
+#ifdef POOL_MAGAZINES
+    #ifndef POOL_MAGAZINE_SIZE
+        #define POOL_MAGAZINE_SIZE 32
+    #endif
+
+    #if defined(_MSC_VER) && !defined(__clang__)
+        typedef volatile long pool__spinlock_t;
+    #else
+        typedef int pool__spinlock_t;
+    #endif
+#endif
+
 typedef enum pool_error {
     POOL_OK = 0,
     POOL_ERR_NULL_POOL,
@@ -103,14 +507,69 @@ typedef enum pool_error {
     POOL_ERR_NULL_PTR,
     POOL_ERR_INVALID_PTR,
     POOL_ERR_DOUBLE_FREE,
+    POOL_ERR_OUT_OF_MEMORY,
+    POOL_ERR_INVALID_CONFIG,
+    POOL_ERR_UNSUPPORTED,
+    POOL_ERR_STALE_HANDLE,
     POOL_ERR_COUNT
 } pool_error_t;
 
+typedef enum pool_engine {
+    POOL_ENGINE_FREELIST = 0,
+    POOL_ENGINE_BITMAP,
+    POOL_ENGINE_STACK
+} pool_engine_t;
+
+typedef enum pool_flag {
+    POOL_FLAG_OCCUPANCY = 1 << 0,      // keep an occupancy bitmap for iteration
+    POOL_FLAG_HANDLES   = 1 << 1,      // keep slot generations for pool_alloc_handle
+    POOL_FLAG_RELOCATABLE = 1 << 2     // let pool_compact move objects behind their handles
+} pool_flag_t;
+
+// slot index in the low POOL_HANDLE_INDEX_BITS, generation (never 0) above.
+typedef uint32_t pool_handle_t;
+
+#define POOL_HANDLE_NULL ((pool_handle_t)0)
+
+typedef enum pool_reuse {
+    POOL_REUSE_DEFAULT = 0,            // the engine's own order
+    POOL_REUSE_LIFO,                   // the slot freed last
+    POOL_REUSE_ADDRESS,                // the lowest free slot
+    POOL_REUSE_PAGE                    // a slot on the page with the most live objects
+} pool_reuse_t;
+
+// object cache callback, ctx is the config's cache_ctx.
+typedef void (*pool_object_fn)(void *obj, void *ctx);
+
+typedef struct pool_config {
+    pool_engine_t  engine;
+    unsigned       flags;              // pool_flag_t bits
+    pool_reuse_t   reuse;
+    pool_object_fn ctor;               // runs when a slot first enters the cache
+    pool_object_fn dtor;               // runs when it finally leaves, on reset and destroy
+    void          *cache_ctx;
+    size_t         alignment;          // slot alignment, a power of two, 0 = POOL_ALIGN
+} pool_config_t;
+
+typedef struct pool_page pool_page_t;
+
+// called for each live slot by pool_foreach_allocated, return non zero to stop.
+typedef int (*pool_foreach_fn)(void *slot, void *ctx);
+
+typedef struct pool_iter {
+    const struct pool *pool;
+    size_t             word;            // occupancy word holding bits
+    uint64_t           bits;            // live slots of word not yet returned
+} pool_iter_t;
+
 typedef struct pool_stats {
     size_t slot_size;
     size_t slot_count;
     size_t free_count;
     size_t used_count;
+#ifdef POOL_DYNAMIC
+    size_t chunk_count;
+#endif
 #ifdef POOL_DEBUG
     size_t total_allocs;
     size_t total_frees;
@@ -118,6 +577,29 @@ typedef struct pool_stats {
 #endif
 } pool_stats_t;
 
+#ifdef POOL_DYNAMIC
+typedef enum pool_backing {
+    POOL_BACKING_MALLOC = 0,
+    POOL_BACKING_MMAP
+} pool_backing_t;
+
+typedef enum pool_growth {
+    POOL_GROW_GEOMETRIC = 0,
+    POOL_GROW_LINEAR
+} pool_growth_t;
+
+typedef struct pool_dynamic_config {
+    size_t          chunk_size;     // bytes per chunk, power of two (at least a page when mapped), 0 = POOL_CHUNK_SIZE
+    size_t          max_slots;      // stop growing past this many slots, 0 = unlimited
+    pool_growth_t   growth;
+    pool_backing_t  backing;
+    size_t          alignment;      // slot alignment, a power of two, 0 = POOL_ALIGN
+    size_t          color_step;     // extra offset of each new chunk's slots, 0 = no coloring
+} pool_dynamic_config_t;
+
+typedef struct pool_chunk pool_chunk_t;
+#endif
+
 typedef struct pool {
     uint8_t *buffer;
     uint8_t *buffer_end;
@@ -125,6 +607,80 @@ typedef struct pool {
     size_t   slot_size;
     size_t   slot_count;
     size_t   free_count;
+    size_t   fresh;                 // next never-used slot, slots past it were never touched
+    size_t   slot_shift;            // slot_size = odd << slot_shift
+    size_t   slot_inverse;          // odd * slot_inverse == 1 mod 2^N, divides without a div
+    int      engine;
+
+    // POOL_ENGINE_BITMAP or POOL_FLAG_OCCUPANCY
+    uint64_t *occupancy;            // one bit per slot, 1 = allocated or past the last slot
+    uint64_t *summary;              // bit w set while occupancy word w has a free slot, bitmap engine only
+    size_t    occupancy_words;
+    size_t    summary_hint;         // summary words below this one are all zero
+
+    // POOL_FLAG_HANDLES
+    uint16_t *generations;          // per handle entry, a handle carries generation + 1
+
+    // POOL_FLAG_RELOCATABLE, both stored xor their own index so zeroed memory is the identity
+    uint32_t *handle_slot;          // handle entry -> slot
+    uint32_t *slot_handle;          // slot -> handle entry
+    size_t    released_from;        // slots from here to the end sit on pages given back to the os
+
+    // POOL_ENGINE_STACK
+    uint32_t    *free_stack;        // free slot indices, the top one comes back next
+    size_t       free_top;
+
+    // object cache, slots below constructed hold a constructed object
+    pool_object_fn ctor;
+    pool_object_fn dtor;
+    void          *cache_ctx;
+    size_t         constructed;
+    int            cached;
+
+    // POOL_REUSE_PAGE
+    pool_page_t *pages;             // free list and free count per page
+    uint32_t    *page_buckets;      // page index + 1 heading each free count bucket
+    size_t       page_count;
+    size_t       page_slots;        // most slots starting on one page, the top bucket
+    size_t       page_bucket_min;   // buckets below this one are empty
+    size_t       page_shift;        // log2(POOL_PAGE_SIZE)
+    uintptr_t    page_base;         // page number of the first slot
+
+#ifdef POOL_HARDENED
+    uintptr_t free_key;             // second word of a free slot, marks it as already freed
+#endif
+
+#ifdef POOL_CONCURRENT
+    uint64_t free_head;             // top slot index + 1 (0 = empty) | tag << 32
+#endif
+
+#ifdef POOL_REMOTE_FREE
+    void *remote_head;              // slots freed by other threads, pushed with cas, taken whole by the owner
+#endif
+
+#ifdef POOL_DEFERRED_ZERO
+    void  *dirty_list;              // freed slots waiting for pool_scrub, oldest first, linked like the free list
+    void  *dirty_tail;              // last freed, new dirty slots link in after it
+    size_t dirty_count;
+    size_t dirty_fresh;             // never used slots below this one still hold data from before a reset
+#endif
+
+#ifdef POOL_DYNAMIC
+    pool_chunk_t *chunks;
+    pool_chunk_t *chunks_tail;
+    pool_chunk_t *bump_chunk;       // chunk the fresh cursor points into
+    uintptr_t    *chunk_table;      // open addressing set of chunk base addresses
+    size_t        chunk_table_cap;
+    size_t        chunk_count;
+    size_t        chunk_size;
+    size_t        grow_chunks;
+    size_t        max_slots;
+    int           growth;
+    int           backing;
+    int           dynamic;
+    size_t        alignment;
+    size_t        color_step;
+#endif
 
 #ifdef POOL_DEBUG
     uint8_t *alloc_bitmap;
@@ -140,16 +696,62 @@ typedef struct pool {
 // initializes pool using provided buffer. size is total bytes, returns error if too small.
 POOL_API int pool_init(pool_t *pool, void *buffer, size_t size, size_t slot_size);
 
-// checks leaks in debug mode. does not free the user provided buffer.
+// like pool_init with an engine choice. config may be null for the pool_init defaults.
+POOL_API int pool_init_ex(pool_t *pool, void *buffer, size_t size, size_t slot_size, const pool_config_t *config);
+
+#ifdef POOL_DYNAMIC
+// initializes a growable pool that owns its chunks. config may be null for defaults.
+POOL_API int pool_init_dynamic(pool_t *pool, size_t slot_size, const pool_dynamic_config_t *config);
+#endif
+
+// checks leaks in debug mode, runs the object cache dtor. does not free the user provided buffer,
+// releases chunks of dynamic pools.
 POOL_API void pool_destroy(pool_t *pool);
 
 // allocates a slot. returns null if exhausted.
 POOL_API void *pool_alloc(pool_t *pool);
 
+// allocates a slot on or close to the page of hint, otherwise like pool_alloc.
+POOL_API void *pool_alloc_near(pool_t *pool, const void *hint);
+
 // returns slot to pool. ptr must be owned by pool.
 POOL_API int pool_free(pool_t *pool, void *ptr);
 
-// invalidates all allocations and resets free list.
+// allocates exactly n slots into out, or none. returns n on success, 0 otherwise.
+POOL_API size_t pool_alloc_bulk(pool_t *pool, void **out, size_t n);
+
+// allocates up to n slots into out. returns how many were allocated.
+POOL_API size_t pool_alloc_bulk_partial(pool_t *pool, void **out, size_t n);
+
+// frees n slots with one splice. if any pointer is invalid nothing is freed.
+POOL_API int pool_free_bulk(pool_t *pool, void **ptrs, size_t n);
+
+// frees the valid pointers among ptrs and skips the rest. returns how many were freed.
+// reorders ptrs, the freed pointers end up first.
+POOL_API size_t pool_free_bulk_partial(pool_t *pool, void **ptrs, size_t n);
+
+// allocates n adjacent slots and returns the first, null if no run of n is free.
+POOL_API void *pool_alloc_run(pool_t *pool, size_t n);
+
+// frees n adjacent slots starting at ptr. if any of them is invalid nothing is freed.
+// stack engine pools without POOL_FLAG_OCCUPANCY scan their free stack for the run.
+POOL_API int pool_free_run(pool_t *pool, void *ptr, size_t n);
+
+#ifdef POOL_DEFERRED_ZERO
+// zeroes up to budget (0 = no limit) freed slots and makes them allocatable again. returns how many.
+POOL_API size_t pool_scrub(pool_t *pool, size_t budget);
+#endif
+
+#ifdef POOL_REMOTE_FREE
+// frees ptr from a thread that does not own the pool, the owner reclaims it later.
+POOL_API int pool_free_remote(pool_t *pool, void *ptr);
+
+// owner only, frees every slot other threads handed back. returns how many were freed.
+POOL_API size_t pool_drain_remote(pool_t *pool);
+#endif
+
+// invalidates all allocations and resets free list in o(1), POOL_ZERO_ON_FREE clears used slots.
+// object caches run the dtor on every constructed slot first.
 POOL_API void pool_reset(pool_t *pool);
 
 // returns non zero if no slots available.
@@ -176,12 +778,83 @@ POOL_API int pool_owns(const pool_t *pool, const void *ptr);
 // populates stats structure.
 POOL_API void pool_stats(const pool_t *pool, pool_stats_t *stats);
 
+// calls fn for every allocated slot in address order. needs an occupancy bitmap.
+POOL_API int pool_foreach_allocated(const pool_t *pool, pool_foreach_fn fn, void *ctx);
+
+// starts an address ordered walk over the allocated slots. needs an occupancy bitmap.
+POOL_API int pool_iter_init(pool_iter_t *it, const pool_t *pool);
+
+// returns the next allocated slot, or null when the walk is done.
+POOL_API void *pool_iter_next(pool_iter_t *it);
+
+// allocates a slot and returns its handle, POOL_HANDLE_NULL if exhausted or the pool has no handles.
+POOL_API pool_handle_t pool_alloc_handle(pool_t *pool);
+
+// returns the slot behind handle, or null if the handle is stale or invalid.
+POOL_API void *pool_resolve(const pool_t *pool, pool_handle_t handle);
+
+// frees the slot behind handle. returns POOL_ERR_STALE_HANDLE if it was already freed.
+POOL_API int pool_free_handle(pool_t *pool, pool_handle_t handle);
+
+// returns the handle of an allocated slot, POOL_HANDLE_NULL if ptr is not owned or the pool has no handles.
+POOL_API pool_handle_t pool_handle_of(const pool_t *pool, const void *ptr);
+
+// moves up to budget live objects (0 = no limit) into lower free slots of a relocatable
+// pool, then releases the free tail pages once it is compact. returns objects moved.
+POOL_API size_t pool_compact(pool_t *pool, size_t budget);
+
 // converts error code to static string.
 POOL_API const char *pool_error_string(int error);
 
+// puts the free list back into address order, o(slots / 64) with an occupancy bitmap.
+POOL_API int pool_sort_free_list(pool_t *pool);
+
 // calculates buffer size required for init including alignment overhead.
 POOL_API size_t pool_required_size(size_t slot_size, size_t slot_count);
 
+// calculates buffer size for pool_init_ex with config, including the engine side arrays.
+POOL_API size_t pool_required_size_ex(size_t slot_size, size_t slot_count, const pool_config_t *config);
+
+#ifdef POOL_MAGAZINES
+
+typedef struct pool_magazine pool_magazine_t;
+
+typedef struct pool_depot {
+    pool_t           *pool;
+    pool__spinlock_t  lock;
+    pool_magazine_t  *full;             // magazines with magazine_size rounds
+    pool_magazine_t  *empty;            // magazines with no rounds
+    size_t            full_count;
+    size_t            empty_count;
+    size_t            magazine_size;
+} pool_depot_t;
+
+typedef struct pool_cache {
+    pool_depot_t     *depot;
+    pool_magazine_t  *loaded;
+    pool_magazine_t  *previous;
+} pool_cache_t;
+
+// sets up a depot over pool, magazine_size 0 uses POOL_MAGAZINE_SIZE.
+POOL_API int pool_depot_init(pool_depot_t *depot, pool_t *pool, size_t magazine_size);
+
+// returns the rounds of every full magazine to the pool and frees all magazines.
+POOL_API void pool_depot_destroy(pool_depot_t *depot);
+
+// binds a per-thread cache to depot. the cache starts empty.
+POOL_API void pool_cache_init(pool_cache_t *cache, pool_depot_t *depot);
+
+// allocates a slot, from the loaded magazine when possible. returns null if exhausted.
+POOL_API void *pool_cache_alloc(pool_cache_t *cache);
+
+// frees a slot into the loaded magazine when possible.
+POOL_API int pool_cache_free(pool_cache_t *cache, void *ptr);
+
+// hands every cached slot back to the depot and pool, call on thread exit.
+POOL_API void pool_cache_flush(pool_cache_t *cache);
+
+#endif
+
 #ifdef POOL_DEBUG
 
 POOL_API void *pool_alloc_debug(pool_t *pool, const char *file, int line);
@@ -199,6 +872,90 @@ POOL_API int pool_is_allocated(const pool_t *pool, const void *ptr);
 
 #endif
 
+// typed static pools, see POOL_DEFINE below.
+static inline void pool__define_zero(void *ptr, size_t size) {
+    uint8_t *bytes = (uint8_t *)ptr;
+    while (size--) *bytes++ = 0;
+}
+
+#ifdef POOL_ZERO_ON_ALLOC
+    #define POOL__DEFINE_ZERO_ALLOC(slot) pool__define_zero((slot), sizeof(*(slot)))
+#else
+    #define POOL__DEFINE_ZERO_ALLOC(slot) ((void)0)
+#endif
+
+#ifdef POOL_ZERO_ON_FREE
+    #define POOL__DEFINE_ZERO_FREE(slot) pool__define_zero((slot), sizeof(*(slot)))
+#else
+    #define POOL__DEFINE_ZERO_FREE(slot) ((void)0)
+#endif
+
+#ifdef POOL_DEBUG
+    #define POOL__DEFINE_DEBUG_STATE(count) uint8_t live[((count) + 7) / 8];
+    #define POOL__DEFINE_IS_LIVE(state, i) (((state).live[(i) / 8] >> ((i) % 8)) & 1)
+    #define POOL__DEFINE_SET_LIVE(state, i) ((state).live[(i) / 8] |= (uint8_t)(1u << ((i) % 8)))
+    #define POOL__DEFINE_CLEAR_LIVE(state, i) ((state).live[(i) / 8] &= (uint8_t)~(1u << ((i) % 8)))
+#else
+    #define POOL__DEFINE_DEBUG_STATE(count)
+    #define POOL__DEFINE_IS_LIVE(state, i) 1
+    #define POOL__DEFINE_SET_LIVE(state, i) ((void)0)
+    #define POOL__DEFINE_CLEAR_LIVE(state, i) ((void)0)
+#endif
+
+// defines a pool of Count objects of Type in static storage. slot size, count
+// and alignment are compile time constants, so the generated functions take no
+// pool argument and their range and slot checks fold into constant math.
+// the pool needs no init and is single threaded like a plain pool_t.
+//     Type *name_alloc(void)             null when all Count slots are in use
+//     int   name_free(Type *ptr)         POOL_OK or a pool_error_t
+//     int   name_owns(const void *ptr)   non zero for a slot start of this pool
+#define POOL_DEFINE(name, Type, Count) \
+    typedef union name##_slot { \
+        Type value; \
+        union name##_slot *next; \
+    } name##_slot_t; \
+    \
+    static name##_slot_t name##_slots[(Count)]; \
+    \
+    static struct { \
+        name##_slot_t *free_list; \
+        size_t fresh; \
+        POOL__DEFINE_DEBUG_STATE(Count) \
+    } name##_state; \
+    \
+    static inline int name##_owns(const void *ptr) { \
+        size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)name##_slots); \
+        return offset < sizeof(name##_slots) && offset % sizeof(name##_slot_t) == 0; \
+    } \
+    \
+    static inline Type *name##_alloc(void) { \
+        name##_slot_t *slot = name##_state.free_list; \
+        if (slot != NULL) { \
+            name##_state.free_list = slot->next; \
+        } else if (name##_state.fresh < (size_t)(Count)) { \
+            slot = &name##_slots[name##_state.fresh++]; \
+        } else { \
+            return NULL; \
+        } \
+        POOL__DEFINE_SET_LIVE(name##_state, (size_t)(slot - name##_slots)); \
+        POOL__DEFINE_ZERO_ALLOC(slot); \
+        return &slot->value; \
+    } \
+    \
+    static inline int name##_free(Type *ptr) { \
+        if (ptr == NULL) return POOL_ERR_NULL_PTR; \
+        if (!name##_owns(ptr)) return POOL_ERR_INVALID_PTR; \
+        name##_slot_t *slot = (name##_slot_t *)(void *)ptr; \
+        size_t index = (size_t)(slot - name##_slots); \
+        if (!POOL__DEFINE_IS_LIVE(name##_state, index)) return POOL_ERR_DOUBLE_FREE; \
+        POOL__DEFINE_CLEAR_LIVE(name##_state, index); \
+        (void)index; \
+        POOL__DEFINE_ZERO_FREE(slot); \
+        slot->next = name##_state.free_list; \
+        name##_state.free_list = slot; \
+        return POOL_OK; \
+    }
+
 #ifdef __cplusplus
 }
 #endif
@@ -222,6 +979,132 @@ POOL_API int pool_is_allocated(const pool_t *pool, const void *ptr);
     #define POOL_MEMCPY memcpy
 #endif
 
+// chunks are aligned to their own size, ask the system for that directly
+// unless the caller brought an allocator that can only do plain mallocs
+#if defined(POOL_DYNAMIC) && !defined(POOL_SYS_ALIGNED_MALLOC) && !defined(POOL_SYS_MALLOC)
+    #include <stdlib.h>
+    #if defined(_WIN32)
+        #include <malloc.h>
+        #define POOL_SYS_ALIGNED_MALLOC(size, align) _aligned_malloc((size), (align))
+        #define POOL_SYS_ALIGNED_FREE _aligned_free
+    #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__APPLE__)
+        #define POOL_SYS_ALIGNED_MALLOC(size, align) aligned_alloc((align), (size))
+        #define POOL_SYS_ALIGNED_FREE free
+    #elif defined(__APPLE__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L)
+        #define POOL__POSIX_MEMALIGN
+        #define POOL_SYS_ALIGNED_MALLOC(size, align) pool__posix_memalign((size), (align))
+        #define POOL_SYS_ALIGNED_FREE free
+    #endif
+#endif
+
+#if defined(POOL_DYNAMIC) || defined(POOL_MAGAZINES)
+    #ifndef POOL_SYS_MALLOC
+        #include <stdlib.h>
+        #define POOL_SYS_MALLOC malloc
+    #endif
+    #ifndef POOL_SYS_FREE
+        #include <stdlib.h>
+        #define POOL_SYS_FREE free
+    #endif
+#endif
+
+// chunk mapping for dynamic pools and page release for pool_compact
+#if defined(_WIN32)
+    #define POOL__OS_WINDOWS
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #define POOL__OS_POSIX
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #if defined(MAP_ANONYMOUS)
+        #define POOL__MAP_ANON MAP_ANONYMOUS
+    #elif defined(MAP_ANON)
+        #define POOL__MAP_ANON MAP_ANON
+    #endif
+#endif
+
+#ifdef POOL_CONCURRENT
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define POOL__LOAD64(p) ((uint64_t)_InterlockedCompareExchange64((volatile __int64 *)(p), 0, 0))
+        #define POOL__CAS64(p, expected, desired) \
+            (_InterlockedCompareExchange64((volatile __int64 *)(p), (__int64)(desired), (__int64)(expected)) == (__int64)(expected))
+        #define POOL__LOAD32(p) (*(volatile uint32_t *)(p))
+        #define POOL__STORE32(p, v) (*(volatile uint32_t *)(p) = (v))
+        #if defined(_WIN64)
+            #define POOL__ATOMIC_ADD(p, v) ((size_t)_InterlockedExchangeAdd64((volatile __int64 *)(p), (__int64)(v)) + (size_t)(v))
+        #else
+            #define POOL__ATOMIC_ADD(p, v) ((size_t)_InterlockedExchangeAdd((volatile long *)(p), (long)(v)) + (size_t)(v))
+        #endif
+        #define POOL__ATOMIC_LOAD(p) (*(volatile size_t *)(p))
+        #define POOL__BYTE_OR(p, v)  _InterlockedOr8((volatile char *)(p), (char)(v))
+        #define POOL__BYTE_AND(p, v) _InterlockedAnd8((volatile char *)(p), (char)(v))
+        #define POOL__BYTE_LOAD(p)   (*(volatile const uint8_t *)(p))
+    #else
+        #define POOL__LOAD64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+        #define POOL__CAS64(p, expected, desired) \
+            __atomic_compare_exchange_n((p), &(expected), (desired), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+        #define POOL__LOAD32(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+        #define POOL__STORE32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+        #define POOL__ATOMIC_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+        #define POOL__ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+        #define POOL__BYTE_OR(p, v)  __atomic_fetch_or((p), (uint8_t)(v), __ATOMIC_RELAXED)
+        #define POOL__BYTE_AND(p, v) __atomic_fetch_and((p), (uint8_t)(v), __ATOMIC_RELAXED)
+        #define POOL__BYTE_LOAD(p)   __atomic_load_n((p), __ATOMIC_RELAXED)
+    #endif
+    #define POOL__ATOMIC_SUB(p, v) POOL__ATOMIC_ADD((p), (size_t)0 - (size_t)(v))
+
+    #if defined(_MSC_VER) && !defined(__clang__) && defined(_WIN64)
+        #define POOL__CAS_SIZE(p, expected, desired) POOL__CAS64((p), (expected), (desired))
+    #elif defined(_MSC_VER) && !defined(__clang__)
+        #define POOL__CAS_SIZE(p, expected, desired) \
+            (_InterlockedCompareExchange((volatile long *)(p), (long)(desired), (long)(expected)) == (long)(expected))
+    #else
+        #define POOL__CAS_SIZE(p, expected, desired) \
+            __atomic_compare_exchange_n((p), &(expected), (desired), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+    #endif
+#endif
+
+#ifdef POOL_REMOTE_FREE
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define POOL__LOAD_PTR(p) (*(void *volatile *)(p))
+        #define POOL__XCHG_PTR(p, v) _InterlockedExchangePointer((void *volatile *)(p), (v))
+        #define POOL__CAS_PTR(p, expected, desired) \
+            (_InterlockedCompareExchangePointer((void *volatile *)(p), (desired), (expected)) == (expected))
+    #else
+        #define POOL__LOAD_PTR(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+        #define POOL__XCHG_PTR(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQUIRE)
+        #define POOL__CAS_PTR(p, expected, desired) \
+            __atomic_compare_exchange_n((p), &(expected), (desired), 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+    #endif
+#endif
+
+#ifdef POOL_DEFERRED_ZERO
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #include <emmintrin.h>
+        #define POOL__STREAM_STORES
+    #endif
+#endif
+
+#ifdef POOL_MAGAZINES
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define POOL__LOCK(l)   do { while (_InterlockedExchange((l), 1)) { while (*(l)) _mm_pause(); } } while (0)
+        #define POOL__UNLOCK(l) _InterlockedExchange((l), 0)
+    #else
+        #define POOL__LOCK(l)   do { while (__atomic_exchange_n((l), 1, __ATOMIC_ACQUIRE)) { while (__atomic_load_n((l), __ATOMIC_RELAXED)) { } } } while (0)
+        #define POOL__UNLOCK(l) __atomic_store_n((l), 0, __ATOMIC_RELEASE)
+    #endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
 #ifdef POOL_DEBUG_PRINTF
     #include <stdio.h>
     #define POOL_DBG_PRINTF(...) fprintf(stderr, __VA_ARGS__)
@@ -244,293 +1127,2417 @@ static uint8_t *pool__align_ptr(uint8_t *ptr, size_t alignment) {
     return (uint8_t *)aligned;
 }
 
-#ifdef POOL_DEBUG
-static size_t pool__slot_index(const pool_t *pool, const void *ptr) {
-    return (size_t)((const uint8_t *)ptr - pool->buffer) / pool->slot_size;
-}
-#endif
-
-static void *pool__slot_ptr(const pool_t *pool, size_t index) {
-    return pool->buffer + index * pool->slot_size;
-}
+// splits slot_size into odd << shift and stores the odd part's inverse mod 2^N,
+// each newton step doubles the correct low bits and an odd number is its own inverse mod 8.
+static void pool__set_divisor(pool_t *pool, size_t slot_size) {
+    size_t shift = 0;
+    while (((slot_size >> shift) & 1) == 0) shift++;
 
-#ifdef POOL_DEBUG
+    size_t odd = slot_size >> shift;
+    size_t inverse = odd;
+    for (int i = 0; i < 5; i++) inverse *= 2 - odd * inverse;
 
-static void pool__bitmap_set(pool_t *pool, size_t index) {
-    size_t byte_idx = index / 8;
-    size_t bit_idx = index % 8;
-    pool->alloc_bitmap[byte_idx] |= (uint8_t)(1 << bit_idx);
+    pool->slot_shift = shift;
+    pool->slot_inverse = inverse;
 }
 
-static void pool__bitmap_clear(pool_t *pool, size_t index) {
-    size_t byte_idx = index / 8;
-    size_t bit_idx = index % 8;
-    pool->alloc_bitmap[byte_idx] &= (uint8_t)~(1 << bit_idx);
+// offset / slot_size when offset is a multiple of it. any other offset lands above
+// SIZE_MAX / slot_size, so a single compare against the slot count rejects it.
+static size_t pool__div_slot(const pool_t *pool, size_t offset) {
+    if (offset & (((size_t)1 << pool->slot_shift) - 1)) return SIZE_MAX;
+    return (offset >> pool->slot_shift) * pool->slot_inverse;
 }
 
-static int pool__bitmap_get(const pool_t *pool, size_t index) {
-    size_t byte_idx = index / 8;
-    size_t bit_idx = index % 8;
-    return (pool->alloc_bitmap[byte_idx] >> bit_idx) & 1;
+static size_t pool__slot_index(const pool_t *pool, const void *ptr) {
+    return pool__div_slot(pool, (size_t)((const uint8_t *)ptr - pool->buffer));
 }
 
-static int pool__has_free_magic(const void *slot) {
-    uintptr_t value;
-    POOL_MEMCPY(&value, slot, sizeof(uintptr_t));
-    return value == POOL_MAGIC_FREE;
+// index of the lowest set bit, x must not be zero.
+static size_t pool__ctz64(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (size_t)index;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)x)) return (size_t)index;
+    _BitScanForward(&index, (unsigned long)(x >> 32));
+    return (size_t)index + 32;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_ctzll(x);
+#else
+    size_t index = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        index++;
+    }
+    return index;
+#endif
 }
 
-static void pool__write_free_magic(void *slot) {
-    uintptr_t magic = POOL_MAGIC_FREE;
-    POOL_MEMCPY(slot, &magic, sizeof(uintptr_t));
-}
+// align is the pool's own alignment, 0 when it goes with POOL_ALIGN.
+static size_t pool__effective_slot_size(size_t slot_size, int engine, size_t align) {
+    if (engine != POOL_ENGINE_FREELIST) {
+        if (align != 0) return pool__align_up(slot_size, align);
 
-static void pool__poison_slot(pool_t *pool, void *slot) {
-    // preserve next pointer, poison rest
-    size_t offset = sizeof(void *);
-    if (pool->slot_size > offset) {
-        POOL_MEMSET((uint8_t *)slot + offset, POOL_POISON_BYTE,
-                    pool->slot_size - offset);
+        // nothing lives in a free slot, natural alignment (capped at POOL_ALIGN) is enough
+        size_t natural = slot_size & (~slot_size + 1);
+        return pool__align_up(slot_size, natural < POOL_ALIGN ? natural : POOL_ALIGN);
     }
-}
 
+#if defined(POOL_CONCURRENT) && !defined(POOL_DEBUG)
+    // lock-free links are 32-bit slot indices, a slot that small only has to hold one
+    if (slot_size <= sizeof(uint32_t) && align <= sizeof(uint32_t)) return sizeof(uint32_t);
 #endif
 
-static void pool__build_free_list(pool_t *pool) {
-    pool->free_list = NULL;
-
-    // build backwards so slot 0 is head (cache locality)
-    for (size_t i = pool->slot_count; i > 0; i--) {
-        void *slot = pool__slot_ptr(pool, i - 1);
-
-        // store next pointer inside the slot itself
-        void **next_ptr = (void **)slot;
-        *next_ptr = pool->free_list;
+    // links are read as pointers, so they need at least a pointer's alignment
+    if (align == 0) align = POOL_ALIGN;
+    if (align < sizeof(void *)) align = sizeof(void *);
 
-        pool->free_list = slot;
+    // ensure slot fits a pointer
+    size_t effective = slot_size;
+    if (effective < sizeof(void *)) {
+        effective = sizeof(void *);
+    }
+    effective = pool__align_up(effective, align);
 
 #ifdef POOL_DEBUG
-        // write magic after next pointer
-        if (pool->slot_size >= sizeof(void *) + sizeof(uintptr_t)) {
-            pool__write_free_magic((uint8_t *)slot + sizeof(void *));
-        }
-        pool__poison_slot(pool, slot);
-        pool__bitmap_clear(pool, i - 1);
-#endif
+    size_t min_debug_size = sizeof(void *) + sizeof(uintptr_t);
+    if (effective < min_debug_size) {
+        effective = pool__align_up(min_debug_size, align);
     }
+#endif
 
-    pool->free_count = pool->slot_count;
+    return effective;
 }
 
-POOL_API int pool_init(pool_t *pool, void *buffer, size_t size, size_t slot_size) {
-    if (pool == NULL) return POOL_ERR_NULL_POOL;
-    if (buffer == NULL) return POOL_ERR_NULL_BUFFER;
-    if (slot_size == 0) return POOL_ERR_INVALID_SLOT_SIZE;
+static int pool__has_occupancy(int engine, unsigned flags) {
+    return engine == POOL_ENGINE_BITMAP || (flags & POOL_FLAG_OCCUPANCY) != 0;
+}
 
-    // check power of two
-    if ((POOL_ALIGN & (POOL_ALIGN - 1)) != 0) {
-        return POOL_ERR_INVALID_ALIGNMENT;
-    }
+struct pool_page {
+    void     *head;                 // first free slot on the page
+    uint32_t  free;                 // slots on the list
+    uint32_t  prev;                 // bucket neighbours, page index + 1
+    uint32_t  next;
+};
 
-    POOL_MEMSET(pool, 0, sizeof(pool_t));
+// most slots that can start on one page.
+static size_t pool__page_slots(size_t slot_size) {
+    return (POOL_PAGE_SIZE + slot_size - 1) / slot_size;
+}
 
-    // ensure slot fits a pointer
-    size_t effective_slot_size = slot_size;
-    if (effective_slot_size < sizeof(void *)) {
-        effective_slot_size = sizeof(void *);
+// bytes kept after the slots for the index stack, the page lists, the occupancy bitmaps
+// and the debug bitmap.
+static size_t pool__side_size(size_t slot_count, size_t slot_size, int engine, unsigned flags, int reuse) {
+    size_t size = 0;
+
+    if (reuse == POOL_REUSE_PAGE) {
+        // the buffer is not page aligned, so the slots may touch one extra page
+        size_t pages = (slot_count * slot_size + POOL_PAGE_SIZE - 1) / POOL_PAGE_SIZE + 1;
+        size += sizeof(void *) - 1 + pages * sizeof(pool_page_t);
+        size += (pool__page_slots(slot_size) + 1) * sizeof(uint32_t);
     }
-    effective_slot_size = pool__align_up(effective_slot_size, POOL_ALIGN);
 
-#ifdef POOL_DEBUG
-    size_t min_debug_size = sizeof(void *) + sizeof(uintptr_t);
-    if (effective_slot_size < min_debug_size) {
-        effective_slot_size = pool__align_up(min_debug_size, POOL_ALIGN);
+    if (engine == POOL_ENGINE_STACK) {
+        size += sizeof(uint32_t) - 1 + slot_count * sizeof(uint32_t);
     }
-#endif
 
-    uint8_t *aligned_start = pool__align_ptr((uint8_t *)buffer, POOL_ALIGN);
-    size_t alignment_overhead = (size_t)(aligned_start - (uint8_t *)buffer);
+    if (pool__has_occupancy(engine, flags)) {
+        size_t words = (slot_count + 63) / 64;
+        size_t summary_words = engine == POOL_ENGINE_BITMAP ? (words + 63) / 64 : 0;
+        // slots may end on any byte, the words need 8 byte alignment
+        size += sizeof(uint64_t) - 1 + (words + summary_words) * sizeof(uint64_t);
+    }
 
-    if (alignment_overhead >= size) {
-        return POOL_ERR_BUFFER_TOO_SMALL;
+    if (flags & POOL_FLAG_RELOCATABLE) {
+        size += sizeof(uint32_t) - 1 + 2 * slot_count * sizeof(uint32_t);
     }
 
-    size_t usable_size = size - alignment_overhead;
+    if (flags & POOL_FLAG_HANDLES) {
+        size += sizeof(uint16_t) - 1 + slot_count * sizeof(uint16_t);
+    }
 
 #ifdef POOL_DEBUG
-    // reserve end of buffer for debug bitmap
-    size_t temp_slot_count = usable_size / effective_slot_size;
-    size_t bitmap_size = (temp_slot_count + 7) / 8;
-    bitmap_size = pool__align_up(bitmap_size, POOL_ALIGN);
+    size += pool__align_up((slot_count + 7) / 8, POOL_ALIGN);
+#endif
 
-    if (usable_size <= bitmap_size) {
-        return POOL_ERR_BUFFER_TOO_SMALL;
-    }
+    return size;
+}
 
-    usable_size -= bitmap_size;
-#endif
+// most slots that fit in usable bytes together with their side arrays.
+static size_t pool__fit_slots(size_t usable, size_t slot_size, int engine, unsigned flags, int reuse) {
+    size_t max = usable / slot_size;
+    size_t count = max;
 
-    size_t slot_count = usable_size / effective_slot_size;
-    if (slot_count == 0) {
-        return POOL_ERR_BUFFER_TOO_SMALL;
+    while (count > 0 && count * slot_size + pool__side_size(count, slot_size, engine, flags, reuse) > usable) {
+        size_t over = count * slot_size + pool__side_size(count, slot_size, engine, flags, reuse) - usable;
+        size_t step = (over + slot_size - 1) / slot_size;
+        count = step < count ? count - step : 0;
     }
 
-    pool->buffer = aligned_start;
-    pool->buffer_end = aligned_start + slot_count * effective_slot_size;
-    pool->slot_size = effective_slot_size;
-    pool->slot_count = slot_count;
+    // the side arrays shrink with the count, so the step above can overshoot
+    while (count < max && (count + 1) * slot_size + pool__side_size(count + 1, slot_size, engine, flags, reuse) <= usable) {
+        count++;
+    }
+
+    return count;
+}
+
+// occupancy word w with the bits past the last slot masked off.
+static uint64_t pool__occupancy_word(const pool_t *pool, size_t w) {
+    uint64_t bits = pool->occupancy[w];
+    size_t tail = pool->slot_count & 63;
+    if (tail != 0 && w == pool->occupancy_words - 1) {
+        bits &= ((uint64_t)1 << tail) - 1;
+    }
+    return bits;
+}
+
+// marks every slot free, bits past the last slot stay set so they are never handed out.
+static void pool__bitmap_reset(pool_t *pool) {
+    size_t words = pool->occupancy_words;
+    size_t summary_words = (words + 63) / 64;
+
+    POOL_MEMSET(pool->occupancy, 0, words * sizeof(uint64_t));
+    if (pool->slot_count & 63) {
+        pool->occupancy[words - 1] = ~(uint64_t)0 << (pool->slot_count & 63);
+    }
+
+    if (pool->summary == NULL) return;
+
+    POOL_MEMSET(pool->summary, 0xFF, summary_words * sizeof(uint64_t));
+    if (words & 63) {
+        pool->summary[summary_words - 1] = ((uint64_t)1 << (words & 63)) - 1;
+    }
+
+    pool->summary_hint = 0;
+}
+
+static int pool__occupancy_get(const pool_t *pool, const void *ptr) {
+    size_t index = pool__slot_index(pool, ptr);
+    return (int)((pool->occupancy[index / 64] >> (index & 63)) & 1);
+}
+
+static void pool__occupancy_set(pool_t *pool, const void *ptr, int live) {
+    size_t index = pool__slot_index(pool, ptr);
+    uint64_t bit = (uint64_t)1 << (index & 63);
+    if (live) {
+        pool->occupancy[index / 64] |= bit;
+    } else {
+        pool->occupancy[index / 64] &= ~bit;
+    }
+}
+
+#ifndef POOL_CONCURRENT
+
+// index of the lowest free slot, slot_count if there is none.
+// the summary points straight at a word with room.
+static size_t pool__bitmap_lowest_free(pool_t *pool) {
+    size_t summary_words = (pool->occupancy_words + 63) / 64;
+
+    for (size_t s = pool->summary_hint; s < summary_words; s++) {
+        uint64_t summary = pool->summary[s];
+        if (summary == 0) continue;
+
+        pool->summary_hint = s;
+        size_t w = s * 64 + pool__ctz64(summary);
+        return w * 64 + pool__ctz64(~pool->occupancy[w]);
+    }
+
+    pool->summary_hint = summary_words;
+    return pool->slot_count;
+}
+
+static void pool__bitmap_mark(pool_t *pool, size_t index) {
+    size_t w = index / 64;
+
+    pool->occupancy[w] |= (uint64_t)1 << (index & 63);
+    if (pool->occupancy[w] == ~(uint64_t)0) {
+        pool->summary[w / 64] &= ~((uint64_t)1 << (w & 63));
+    }
+}
+
+static void pool__bitmap_unmark(pool_t *pool, size_t index) {
+    size_t w = index / 64;
+
+    pool->occupancy[w] &= ~((uint64_t)1 << (index & 63));
+    pool->summary[w / 64] |= (uint64_t)1 << (w & 63);
+    if (w / 64 < pool->summary_hint) pool->summary_hint = w / 64;
+}
+
+static void *pool__bitmap_claim(pool_t *pool, size_t index) {
+    pool__bitmap_mark(pool, index);
+    // the page comes back on first touch, it has to be released again later
+    if (index >= pool->released_from) pool->released_from = pool->slot_count;
+
+    return pool->buffer + index * pool->slot_size;
+}
+
+static void *pool__bitmap_take(pool_t *pool) {
+    size_t index = pool__bitmap_lowest_free(pool);
+    if (index >= pool->slot_count) return NULL;
+
+    return pool__bitmap_claim(pool, index);
+}
+
+static void pool__bitmap_put(pool_t *pool, void *ptr) {
+    pool__bitmap_unmark(pool, pool__slot_index(pool, ptr));
+}
+
+// index of the highest set bit, x must not be zero.
+static size_t pool__msb64(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (size_t)index;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(x >> 32))) return (size_t)index + 32;
+    _BitScanReverse(&index, (unsigned long)x);
+    return (size_t)index;
+#elif defined(__GNUC__) || defined(__clang__)
+    return 63 - (size_t)__builtin_clzll(x);
+#else
+    size_t index = 63;
+    while ((x >> index) == 0) index--;
+    return index;
+#endif
+}
+
+// free bit of a word closest to bit b, 64 if the word is full.
+static size_t pool__nearest_bit(uint64_t free_bits, size_t b) {
+    uint64_t up = free_bits >> b << b;
+    uint64_t down = free_bits & (((uint64_t)1 << b) - 1);
+
+    if (up == 0 && down == 0) return 64;
+    if (down == 0) return pool__ctz64(up);
+    if (up == 0) return pool__msb64(down);
+
+    size_t hi = pool__ctz64(up);
+    size_t lo = pool__msb64(down);
+    return hi - b <= b - lo ? hi : lo;
+}
+
+// takes the free slot closest to index within span words either side, null if none.
+static void *pool__bitmap_take_near(pool_t *pool, size_t index, size_t span) {
+    size_t w = index / 64;
+    size_t bit = pool__nearest_bit(~pool->occupancy[w], index & 63);
+    if (bit < 64) return pool__bitmap_claim(pool, w * 64 + bit);
+
+    // bits past the last slot read as allocated, so whole words are safe to take from
+    for (size_t d = 1; d <= span; d++) {
+        if (w >= d && ~pool->occupancy[w - d] != 0) {
+            return pool__bitmap_claim(pool, (w - d) * 64 + pool__msb64(~pool->occupancy[w - d]));
+        }
+        if (w + d < pool->occupancy_words && ~pool->occupancy[w + d] != 0) {
+            return pool__bitmap_claim(pool, (w + d) * 64 + pool__ctz64(~pool->occupancy[w + d]));
+        }
+    }
+    return NULL;
+}
+
+// bits of free_bits that start a run of n free bits inside the word, n <= 64.
+static uint64_t pool__run_starts(uint64_t free_bits, size_t n) {
+    // after each step bit i says bits i .. i + covered - 1 are all free
+    size_t covered = 1;
+    while (covered < n && free_bits != 0) {
+        size_t step = covered < n - covered ? covered : n - covered;
+        free_bits &= free_bits >> step;
+        covered += step;
+    }
+    return free_bits;
+}
+
+// index of the lowest run of n free slots, slot_count if there is none.
+static size_t pool__bitmap_find_run(const pool_t *pool, size_t n) {
+    size_t run = 0;
+    size_t start = 0;
+
+    for (size_t w = 0; w < pool->occupancy_words; w++) {
+        // 64 full words in a row, the run can not get through them
+        if ((w & 63) == 0 && pool->summary[w / 64] == 0) {
+            run = 0;
+            w += 63;
+            continue;
+        }
+
+        // bits past the last slot read as allocated and end every run
+        uint64_t free_bits = ~pool->occupancy[w];
+        if (free_bits == ~(uint64_t)0) {
+            if (run == 0) start = w * 64;
+            run += 64;
+            if (run >= n) return start;
+            continue;
+        }
+        if (free_bits == 0) {
+            run = 0;
+            continue;
+        }
+
+        // the run from the words below continues into the low free bits
+        if (run > 0 && run + pool__ctz64(~free_bits) >= n) return start;
+
+        if (n <= 64) {
+            uint64_t starts = pool__run_starts(free_bits, n);
+            if (starts != 0) return w * 64 + pool__ctz64(starts);
+        }
+
+        // the high free bits may start a run into the next word
+        run = 63 - pool__msb64(~free_bits);
+        start = w * 64 + 64 - run;
+    }
+    return pool->slot_count;
+}
+
+// sets (live) or clears the occupancy bits of slots index .. index + n - 1, a word at a time.
+static void pool__bitmap_mark_run(pool_t *pool, size_t index, size_t n, int live) {
+    while (n > 0) {
+        size_t w = index / 64;
+        size_t bit = index & 63;
+        size_t take = 64 - bit < n ? 64 - bit : n;
+        uint64_t mask = (take == 64 ? ~(uint64_t)0 : (((uint64_t)1 << take) - 1)) << bit;
+
+        if (live) {
+            pool->occupancy[w] |= mask;
+            if (pool->occupancy[w] == ~(uint64_t)0) {
+                pool->summary[w / 64] &= ~((uint64_t)1 << (w & 63));
+            }
+        } else {
+            pool->occupancy[w] &= ~mask;
+            pool->summary[w / 64] |= (uint64_t)1 << (w & 63);
+            if (w / 64 < pool->summary_hint) pool->summary_hint = w / 64;
+        }
+
+        index += take;
+        n -= take;
+    }
+}
+
+// tells the os the pages are unused, they read back as zero or stale data.
+static void pool__release_pages(uint8_t *start, uint8_t *end) {
+    start = pool__align_ptr(start, POOL_PAGE_SIZE);
+    end = (uint8_t *)((uintptr_t)end & ~(uintptr_t)(POOL_PAGE_SIZE - 1));
+    if (start >= end) return;
+
+#if defined(POOL__OS_WINDOWS)
+    VirtualAlloc(start, (size_t)(end - start), MEM_RESET, PAGE_READWRITE);
+#elif defined(POOL__OS_POSIX) && defined(MADV_DONTNEED)
+    madvise(start, (size_t)(end - start), MADV_DONTNEED);
+#endif
+}
+
+#endif // POOL_CONCURRENT
 
+#ifdef POOL_DYNAMIC
+
+struct pool_chunk {
+    pool_chunk_t *next;
+    uint8_t      *slots;
+    uint8_t      *slots_end;
+    void         *base;         // start of the backing allocation
+    size_t        slot_count;
 #ifdef POOL_DEBUG
-    pool->alloc_bitmap = pool->buffer_end;
-    pool->bitmap_size = bitmap_size;
-    POOL_MEMSET(pool->alloc_bitmap, 0, bitmap_size);
-    pool->user_buffer = (uint8_t *)buffer;
-    pool->user_buffer_size = size;
+    uint8_t      *alloc_bitmap;
+#endif
+};
+
+static size_t pool__chunk_header_size(void) {
+    return pool__align_up(sizeof(pool_chunk_t), POOL_ALIGN);
+}
+
+// chunk size is a power of two and every chunk is aligned to it
+static pool_chunk_t *pool__chunk_of(const pool_t *pool, const void *ptr) {
+    return (pool_chunk_t *)((uintptr_t)ptr & ~(uintptr_t)(pool->chunk_size - 1));
+}
+
+// slots that fit in one chunk after the header (and the debug bitmap), the first at an align boundary
+static size_t pool__chunk_capacity(size_t chunk_size, size_t slot_size, size_t align, size_t *slots_offset) {
+    size_t header = pool__chunk_header_size();
+    size_t offset = pool__align_up(header, align);
+    if (chunk_size <= offset) return 0;
+
+    size_t slots = (chunk_size - offset) / slot_size;
+
+#ifdef POOL_DEBUG
+    while (slots > 0) {
+        offset = pool__align_up(header + pool__align_up((slots + 7) / 8, POOL_ALIGN), align);
+        if (offset < chunk_size && slots * slot_size <= chunk_size - offset) break;
+        slots--;
+    }
 #endif
 
-    pool__build_free_list(pool);
+    *slots_offset = offset;
+    return slots;
+}
+
+static size_t pool__chunk_hash(const pool_t *pool, uintptr_t base) {
+    uint64_t key = (uint64_t)(base / pool->chunk_size);
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (pool->chunk_table_cap - 1);
+}
+
+static int pool__chunk_table_contains(const pool_t *pool, uintptr_t base) {
+    if (pool->chunk_table_cap == 0) return 0;
+
+    size_t i = pool__chunk_hash(pool, base);
+    while (pool->chunk_table[i] != 0) {
+        if (pool->chunk_table[i] == base) return 1;
+        i = (i + 1) & (pool->chunk_table_cap - 1);
+    }
+    return 0;
+}
+
+static int pool__chunk_table_insert(pool_t *pool, uintptr_t base) {
+    // keep load factor at or below one half so probes stay short
+    if ((pool->chunk_count + 1) * 2 > pool->chunk_table_cap) {
+        size_t old_cap = pool->chunk_table_cap;
+        uintptr_t *old = pool->chunk_table;
+        size_t new_cap = old_cap ? old_cap * 2 : 8;
+
+        uintptr_t *table = (uintptr_t *)POOL_SYS_MALLOC(new_cap * sizeof(uintptr_t));
+        if (table == NULL) return POOL_ERR_OUT_OF_MEMORY;
+        POOL_MEMSET(table, 0, new_cap * sizeof(uintptr_t));
 
+        pool->chunk_table = table;
+        pool->chunk_table_cap = new_cap;
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i] != 0) {
+                size_t j = pool__chunk_hash(pool, old[i]);
+                while (table[j] != 0) j = (j + 1) & (new_cap - 1);
+                table[j] = old[i];
+            }
+        }
+        if (old) POOL_SYS_FREE(old);
+    }
+
+    size_t i = pool__chunk_hash(pool, base);
+    while (pool->chunk_table[i] != 0) i = (i + 1) & (pool->chunk_table_cap - 1);
+    pool->chunk_table[i] = base;
     return POOL_OK;
 }
 
-POOL_API void pool_destroy(pool_t *pool) {
-    if (pool == NULL) return;
+#ifdef POOL__POSIX_MEMALIGN
+static void *pool__posix_memalign(size_t size, size_t align) {
+    void *ptr = NULL;
+    return posix_memalign(&ptr, align, size) == 0 ? ptr : NULL;
+}
+#endif
+
+static pool_chunk_t *pool__chunk_map(pool_t *pool) {
+    size_t size = pool->chunk_size;
+    void *base = NULL;
+    uint8_t *aligned = NULL;
+
+    if (pool->backing == POOL_BACKING_MMAP) {
+#if defined(POOL__OS_WINDOWS)
+        // reserve an oversized range to find an aligned address, then map exactly there
+        for (int attempt = 0; attempt < 8 && aligned == NULL; attempt++) {
+            uint8_t *probe = (uint8_t *)VirtualAlloc(NULL, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+            if (probe == NULL) return NULL;
+            VirtualFree(probe, 0, MEM_RELEASE);
+            aligned = (uint8_t *)VirtualAlloc(pool__align_ptr(probe, size), size,
+                                              MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+        base = aligned;
+#elif defined(POOL__OS_POSIX) && defined(POOL__MAP_ANON)
+        // over map, then trim the unaligned head and the tail
+        uint8_t *raw = (uint8_t *)mmap(NULL, size * 2, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | POOL__MAP_ANON, -1, 0);
+        if ((void *)raw == MAP_FAILED) return NULL;
+        aligned = pool__align_ptr(raw, size);
+        if (aligned > raw) munmap(raw, (size_t)(aligned - raw));
+        if (aligned + size < raw + size * 2) munmap(aligned + size, (size_t)(raw + size * 2 - (aligned + size)));
+        base = aligned;
+#else
+        return NULL;
+#endif
+    } else {
+#ifdef POOL_SYS_ALIGNED_MALLOC
+        base = POOL_SYS_ALIGNED_MALLOC(size, size);
+        aligned = (uint8_t *)base;
+#else
+        // the unused slack before and after the aligned chunk is never touched
+        base = POOL_SYS_MALLOC(size * 2 - 1);
+        if (base == NULL) return NULL;
+        aligned = pool__align_ptr((uint8_t *)base, size);
+#endif
+    }
+
+    if (aligned == NULL) return NULL;
+
+    pool_chunk_t *chunk = (pool_chunk_t *)aligned;
+    chunk->base = base;
+    return chunk;
+}
+
+static void pool__chunk_unmap(const pool_t *pool, pool_chunk_t *chunk) {
+    if (pool->backing == POOL_BACKING_MMAP) {
+#if defined(POOL__OS_WINDOWS)
+        VirtualFree(chunk, 0, MEM_RELEASE);
+#elif defined(POOL__OS_POSIX) && defined(POOL__MAP_ANON)
+        munmap(chunk, pool->chunk_size);
+#endif
+    } else {
+#ifdef POOL_SYS_ALIGNED_MALLOC
+        POOL_SYS_ALIGNED_FREE(chunk->base);
+#else
+        POOL_SYS_FREE(chunk->base);
+#endif
+    }
+}
+
+// mmap and munmap work in whole pages (allocation granules on windows), a
+// smaller chunk can not be trimmed to its alignment or unmapped on its own.
+static size_t pool__os_page_size(void) {
+#if defined(POOL__OS_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwAllocationGranularity;
+#elif defined(POOL__OS_POSIX) && defined(_SC_PAGESIZE)
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : (size_t)POOL_PAGE_SIZE;
+#else
+    return POOL_PAGE_SIZE;
+#endif
+}
+
+#endif // POOL_DYNAMIC
 
 #ifdef POOL_DEBUG
-    size_t leaked = pool->slot_count - pool->free_count;
-    if (leaked > 0) {
-        POOL_DBG_PRINTF("POOL: Memory leak detected! %zu slots not freed.\n", leaked);
 
-        int first = 1;
-        POOL_DBG_PRINTF("POOL: Leaked slot indices: ");
-        for (size_t i = 0; i < pool->slot_count; i++) {
-            if (pool__bitmap_get(pool, i)) {
-                if (!first) POOL_DBG_PRINTF(", ");
-                POOL_DBG_PRINTF("%zu", i);
-                first = 0;
+static void pool__bitmap_set(uint8_t *bitmap, size_t index) {
+    size_t byte_idx = index / 8;
+    size_t bit_idx = index % 8;
+#ifdef POOL_CONCURRENT
+    POOL__BYTE_OR(&bitmap[byte_idx], 1 << bit_idx);
+#else
+    bitmap[byte_idx] |= (uint8_t)(1 << bit_idx);
+#endif
+}
+
+static void pool__bitmap_clear(uint8_t *bitmap, size_t index) {
+    size_t byte_idx = index / 8;
+    size_t bit_idx = index % 8;
+#ifdef POOL_CONCURRENT
+    POOL__BYTE_AND(&bitmap[byte_idx], ~(1 << bit_idx));
+#else
+    bitmap[byte_idx] &= (uint8_t)~(1 << bit_idx);
+#endif
+}
+
+static int pool__bitmap_get(const uint8_t *bitmap, size_t index) {
+    size_t byte_idx = index / 8;
+    size_t bit_idx = index % 8;
+#ifdef POOL_CONCURRENT
+    return (POOL__BYTE_LOAD(&bitmap[byte_idx]) >> bit_idx) & 1;
+#else
+    return (bitmap[byte_idx] >> bit_idx) & 1;
+#endif
+}
+
+// finds the debug bitmap tracking ptr and the slot index inside it.
+static uint8_t *pool__debug_bitmap(const pool_t *pool, const void *ptr, size_t *index) {
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) {
+        pool_chunk_t *chunk = pool__chunk_of(pool, ptr);
+        *index = pool__div_slot(pool, (size_t)((const uint8_t *)ptr - chunk->slots));
+        return chunk->alloc_bitmap;
+    }
+#endif
+    *index = pool__slot_index(pool, ptr);
+    return pool->alloc_bitmap;
+}
+
+static int pool__has_free_magic(const void *slot) {
+    uintptr_t value;
+    POOL_MEMCPY(&value, slot, sizeof(uintptr_t));
+    return value == POOL_MAGIC_FREE;
+}
+
+static void pool__write_free_magic(void *slot) {
+    uintptr_t magic = POOL_MAGIC_FREE;
+    POOL_MEMCPY(slot, &magic, sizeof(uintptr_t));
+}
+
+static void pool__poison_slot(pool_t *pool, void *slot) {
+    // preserve next pointer, poison rest
+    size_t offset = sizeof(void *);
+    if (pool->slot_size > offset) {
+        POOL_MEMSET((uint8_t *)slot + offset, POOL_POISON_BYTE,
+                    pool->slot_size - offset);
+    }
+}
+
+#endif
+
+// free_count is updated concurrently, clamp the transient overshoot.
+static size_t pool__free_count(const pool_t *pool) {
+#ifdef POOL_CONCURRENT
+    size_t free_count = POOL__ATOMIC_LOAD(&pool->free_count);
+    return free_count < pool->slot_count ? free_count : pool->slot_count;
+#elif defined(POOL_DEFERRED_ZERO)
+    // dirty slots are free to the caller, alloc zeroes one when nothing clean is left
+    return pool->free_count + pool->dirty_count;
+#else
+    return pool->free_count;
+#endif
+}
+
+#ifdef POOL_DYNAMIC
+
+// appends the next batch of chunks according to the growth policy.
+static int pool__grow(pool_t *pool) {
+    size_t added = 0;
+
+    for (size_t i = 0; i < pool->grow_chunks; i++) {
+        if (pool->max_slots != 0 && pool->slot_count >= pool->max_slots) break;
+
+        pool_chunk_t *chunk = pool__chunk_map(pool);
+        if (chunk == NULL) break;
+
+        if (pool__chunk_table_insert(pool, (uintptr_t)chunk) != POOL_OK) {
+            pool__chunk_unmap(pool, chunk);
+            break;
+        }
+
+        size_t slots_offset = 0;
+        chunk->slot_count = pool__chunk_capacity(pool->chunk_size, pool->slot_size, pool->alignment, &slots_offset);
+
+        // consecutive chunks start their slots color_step further in, wrapping within the slack
+        size_t color = 0;
+        if (pool->color_step != 0) {
+            size_t slack = pool->chunk_size - slots_offset - chunk->slot_count * pool->slot_size;
+            color = pool->chunk_count % (slack / pool->color_step + 1) * pool->color_step;
+        }
+
+        chunk->slots = (uint8_t *)chunk + slots_offset + color;
+        chunk->slots_end = chunk->slots + chunk->slot_count * pool->slot_size;
+        chunk->next = NULL;
+#ifdef POOL_DEBUG
+        chunk->alloc_bitmap = (uint8_t *)chunk + pool__chunk_header_size();
+        POOL_MEMSET(chunk->alloc_bitmap, 0, slots_offset - pool__chunk_header_size());
+#endif
+
+        // chunks are bumped through in list order, so new ones go at the tail
+        if (pool->chunks_tail) {
+            pool->chunks_tail->next = chunk;
+        } else {
+            pool->chunks = chunk;
+        }
+        pool->chunks_tail = chunk;
+        pool->chunk_count++;
+        pool->slot_count += chunk->slot_count;
+        pool->free_count += chunk->slot_count;
+        added++;
+    }
+
+    if (added == 0) return POOL_ERR_OUT_OF_MEMORY;
+
+    if (pool->growth == POOL_GROW_GEOMETRIC && added == pool->grow_chunks &&
+        pool->grow_chunks <= SIZE_MAX / 2) {
+        pool->grow_chunks *= 2;
+    }
+
+    return POOL_OK;
+}
+
+#endif // POOL_DYNAMIC
+
+#ifdef POOL_DEFERRED_ZERO
+// zeroes with streaming stores where the target has them. a scrubbed slot
+// is not read again soon, so it should not push live data out of the cache.
+static void pool__zero_stream(void *ptr, size_t size) {
+#ifdef POOL__STREAM_STORES
+    uint8_t *p = (uint8_t *)ptr;
+    uint8_t *end = p + size;
+    uint8_t *a = pool__align_ptr(p, 16);
+    if (a > end) a = end;
+
+    // the unaligned head and the tail go through memset
+    POOL_MEMSET(p, 0, (size_t)(a - p));
+    __m128i zero = _mm_setzero_si128();
+    for (; end - a >= 16; a += 16) {
+        _mm_stream_si128((__m128i *)a, zero);
+    }
+    POOL_MEMSET(a, 0, (size_t)(end - a));
+#else
+    POOL_MEMSET(ptr, 0, size);
+#endif
+}
+
+// freed slots wait on the dirty list unless the pool zeroes them on the spot:
+// the bitmap engine has no link to spare, the stack engine keeps freed slots
+// untouched, cached objects are never zeroed, and the link has to fit.
+static int pool__defers_zero(const pool_t *pool) {
+    return pool->engine != POOL_ENGINE_BITMAP && pool->free_stack == NULL && !pool->cached &&
+           pool->slot_size >= sizeof(void *);
+}
+
+// never used slots index .. index + n - 1 that still hold data from before a deferred reset.
+static void pool__zero_fresh(pool_t *pool, size_t index, size_t n) {
+    if (index >= pool->dirty_fresh) return;
+    size_t end = index + n < pool->dirty_fresh ? index + n : pool->dirty_fresh;
+    POOL_MEMSET(pool->buffer + index * pool->slot_size, 0, (end - index) * pool->slot_size);
+}
+
+#endif
+
+// hands out the next never-used slot. slots only join the free list when
+// they are freed, so init and reset never touch slot memory.
+static void *pool__take_fresh(pool_t *pool) {
+#ifdef POOL_CONCURRENT
+    // fresh may run past slot_count when exhausted, reset rewinds it
+    size_t index = POOL__ATOMIC_ADD(&pool->fresh, 1) - 1;
+    if (index >= pool->slot_count) return NULL;
+    return pool->buffer + index * pool->slot_size;
+#else
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) {
+        for (;;) {
+            pool_chunk_t *c = pool->bump_chunk;
+            if (pool->fresh < c->slot_count) {
+                return c->slots + pool->fresh++ * pool->slot_size;
             }
+            if (c->next == NULL && pool__grow(pool) != POOL_OK) return NULL;
+            pool->bump_chunk = c->next;
+            pool->fresh = 0;
         }
-        POOL_DBG_PRINTF("\n");
-        POOL_ASSERT(leaked == 0 && "Pool destroyed with leaked allocations");
     }
-#endif
+#endif
+    if (pool->fresh >= pool->slot_count) return NULL;
+#ifdef POOL_DEFERRED_ZERO
+    pool__zero_fresh(pool, pool->fresh, 1);
+#endif
+    return pool->buffer + pool->fresh++ * pool->slot_size;
+#endif
+}
+
+#ifdef POOL_HARDENED
+    // safe-linking, a link is stored xor the page number of the slot holding it
+    #define POOL__LINK_KEY(slot) ((uintptr_t)(slot) >> 12)
+#else
+    #define POOL__LINK_KEY(slot) ((uintptr_t)0)
+#endif
+
+#ifndef POOL_CONCURRENT
+static void pool__link_store(void *slot, void *next) {
+    *(void **)slot = (void *)((uintptr_t)next ^ POOL__LINK_KEY(slot));
+}
+
+static void *pool__link_load(const void *slot) {
+    return (void *)((uintptr_t)*(void *const *)slot ^ POOL__LINK_KEY(slot));
+}
+#endif
+
+#ifdef POOL_DEFERRED_ZERO
+// dirty slots are linked like free list slots, safe-linking included, but
+// queued so pool_scrub hands them to the free index in the order they were freed.
+static void pool__dirty_push(pool_t *pool, void *ptr) {
+    pool__link_store(ptr, NULL);
+    if (pool->dirty_tail != NULL) {
+        pool__link_store(pool->dirty_tail, ptr);
+    } else {
+        pool->dirty_list = ptr;
+    }
+    pool->dirty_tail = ptr;
+    pool->dirty_count++;
+}
+#endif
+
+#ifdef POOL_HARDENED
+
+// mixes the pool address into a key that user data is unlikely to hold.
+static uintptr_t pool__make_free_key(const pool_t *pool) {
+    uint64_t x = (uint64_t)(uintptr_t)pool ^ 0x9E3779B97F4A7C15ull;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return (uintptr_t)x | 1;
+}
+
+#ifndef POOL_DEBUG
+static int pool__has_free_key(const pool_t *pool) {
+    return pool->engine == POOL_ENGINE_FREELIST && pool->slot_size >= 2 * sizeof(void *);
+}
+#endif
+
+// a decoded link must be null or a slot this pool has handed out.
+static int pool__link_valid(const pool_t *pool, const void *next) {
+    if (next == NULL) return 1;
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) return pool_owns(pool, next);
+#endif
+    return pool__slot_index(pool, next) < pool->fresh;
+}
+
+static void pool__link_corrupt(const pool_t *pool, const void *slot) {
+    POOL_DBG_PRINTF("POOL: Corrupted free list link in slot %p\n", slot);
+    POOL_ASSERT(0 && "Free list corruption detected");
+    (void)pool;
+    (void)slot;
+}
+
+// catches a slot that is already on the free list, o(1) unless its key matches.
+static int pool__is_listed(const pool_t *pool, const void *ptr) {
+    const void *head = pool->free_list;
+    if (pool->pages) {
+        head = pool->pages[((uintptr_t)ptr >> pool->page_shift) - pool->page_base].head;
+    }
+    if (ptr == head) return 1;
+#ifdef POOL_DEFERRED_ZERO
+    if (ptr == pool->dirty_list) return 1;
+#endif
+
+#ifndef POOL_DEBUG
+    if (!pool__has_free_key(pool) || ((const uintptr_t *)ptr)[1] != pool->free_key) return 0;
+
+    // user data can hold the key by chance, so confirm by walking the list
+    size_t steps = pool->free_count;
+    for (const void *s = head; s != NULL && steps > 0; steps--) {
+        if (s == ptr) return 1;
+        const void *next = pool__link_load(s);
+        if (!pool__link_valid(pool, next)) break;
+        s = next;
+    }
+
+#ifdef POOL_DEFERRED_ZERO
+    // freed but not scrubbed yet
+    steps = pool->dirty_count;
+    for (const void *s = pool->dirty_list; s != NULL && steps > 0; steps--) {
+        if (s == ptr) return 1;
+        const void *next = pool__link_load(s);
+        if (!pool__link_valid(pool, next)) break;
+        s = next;
+    }
+#endif
+#endif
+    return 0;
+}
+
+#endif // POOL_HARDENED
+
+#ifdef POOL_DEFERRED_ZERO
+// unlinks the oldest dirty slot, null if the list is empty or broken.
+static void *pool__dirty_pop(pool_t *pool) {
+    void *slot = pool->dirty_list;
+    if (slot == NULL) return NULL;
+
+    void *next = pool__link_load(slot);
+#ifdef POOL_HARDENED
+    if (!pool__link_valid(pool, next)) {
+        // the list can not be trusted from here on, leave it dirty and unreachable
+        pool__link_corrupt(pool, slot);
+        pool->dirty_list = NULL;
+        pool->dirty_tail = NULL;
+        pool->dirty_count = 0;
+        return NULL;
+    }
+#endif
+    pool->dirty_list = next;
+    if (next == NULL) pool->dirty_tail = NULL;
+    pool->dirty_count--;
+    return slot;
+}
+
+// nothing clean or never used is left: zero only the slot being handed out,
+// the rest of the backlog stays for pool_scrub. dirty slots are not in free_count.
+static void *pool__take_dirty(pool_t *pool) {
+    void *slot = pool__dirty_pop(pool);
+    if (slot == NULL) return NULL;
+    POOL_MEMSET(slot, 0, pool->slot_size);
+    return slot;
+}
+#endif
+
+#ifndef POOL_CONCURRENT
+
+static size_t pool__page_of(const pool_t *pool, const void *slot) {
+    return (size_t)(((uintptr_t)slot >> pool->page_shift) - pool->page_base);
+}
+
+static void pool__page_link(pool_t *pool, size_t page) {
+    pool_page_t *p = &pool->pages[page];
+    uint32_t *bucket = &pool->page_buckets[p->free];
+
+    p->prev = 0;
+    p->next = *bucket;
+    if (*bucket != 0) pool->pages[*bucket - 1].prev = (uint32_t)page + 1;
+    *bucket = (uint32_t)page + 1;
+
+    if (p->free < pool->page_bucket_min) pool->page_bucket_min = p->free;
+}
+
+static void pool__page_unlink(pool_t *pool, size_t page) {
+    pool_page_t *p = &pool->pages[page];
+
+    if (p->prev != 0) {
+        pool->pages[p->prev - 1].next = p->next;
+    } else {
+        pool->page_buckets[p->free] = p->next;
+    }
+    if (p->next != 0) pool->pages[p->next - 1].prev = p->prev;
+}
+
+// pops the head of a page with listed slots, null if its link is corrupt.
+static void *pool__page_pop(pool_t *pool, size_t page) {
+    pool_page_t *p = &pool->pages[page];
+    void *slot = p->head;
+    void *next = pool__link_load(slot);
+
+#ifdef POOL_HARDENED
+    if (!pool__link_valid(pool, next) || (next != NULL && pool__page_of(pool, next) != page)) {
+        pool__link_corrupt(pool, slot);
+        return NULL;
+    }
+#endif
+
+    pool__page_unlink(pool, page);
+    p->head = next;
+    p->free--;
+    if (p->free > 0) pool__page_link(pool, page);
+
+    return slot;
+}
+
+// takes a listed slot from the fullest page that has one, null if none is listed.
+static void *pool__page_take(pool_t *pool) {
+    size_t k = pool->page_bucket_min;
+    while (k <= pool->page_slots && pool->page_buckets[k] == 0) k++;
+    pool->page_bucket_min = k;
+    if (k > pool->page_slots) return NULL;
+
+    return pool__page_pop(pool, pool->page_buckets[k] - 1);
+}
+
+// takes a slot from page or the closest page within POOL_NEAR_PAGES, listed or
+// never used. null if none is close.
+static void *pool__page_take_near(pool_t *pool, size_t page) {
+    size_t fresh_page = SIZE_MAX;
+    if (pool->fresh < pool->slot_count) {
+        fresh_page = pool__page_of(pool, pool->buffer + pool->fresh * pool->slot_size);
+    }
+
+    for (size_t d = 0; d <= POOL_NEAR_PAGES; d++) {
+        // page - d wraps past page_count below the first page
+        size_t near[2] = {page - d, page + d};
+        for (int k = 0; k < (d == 0 ? 1 : 2); k++) {
+            size_t q = near[k];
+            if (q >= pool->page_count) continue;
+            if (pool->pages[q].free > 0) return pool__page_pop(pool, q);
+            if (q == fresh_page) return pool__take_fresh(pool);
+        }
+    }
+    return NULL;
+}
+
+static void pool__page_put(pool_t *pool, void *slot) {
+    size_t page = pool__page_of(pool, slot);
+    pool_page_t *p = &pool->pages[page];
+
+    if (p->free > 0) pool__page_unlink(pool, page);
+    pool__link_store(slot, p->head);
+    p->head = slot;
+    p->free++;
+    pool__page_link(pool, page);
+}
+
+static void pool__page_reset(pool_t *pool) {
+    POOL_MEMSET(pool->pages, 0, pool->page_count * sizeof(pool_page_t));
+    POOL_MEMSET(pool->page_buckets, 0, (pool->page_slots + 1) * sizeof(uint32_t));
+    pool->page_bucket_min = pool->page_slots + 1;
+}
+
+// pops the index freed last, falls back to never used slots.
+static void *pool__stack_take(pool_t *pool) {
+    if (pool->free_top > 0) {
+        return pool->buffer + (size_t)pool->free_stack[--pool->free_top] * pool->slot_size;
+    }
+    return pool__take_fresh(pool);
+}
+
+static void pool__stack_put(pool_t *pool, void *ptr) {
+    pool->free_stack[pool->free_top++] = (uint32_t)pool__slot_index(pool, ptr);
+}
+
+// a run may only be pushed if the stack has room for it and none of its slots
+// is listed already. without occupancy bits that takes one pass over the stack.
+static int pool__stack_run_fits(const pool_t *pool, const void *first, size_t n) {
+    if (pool->free_top + n > pool->fresh) return 0;
+    if (pool->occupancy) return 1;
+
+    size_t lo = pool__slot_index(pool, first);
+    for (size_t i = 0; i < pool->free_top; i++) {
+        if ((size_t)pool->free_stack[i] - lo < n) return 0;
+    }
+    return 1;
+}
+
+// sifts indices[root] down a min heap of end entries.
+static void pool__sift_down(uint32_t *indices, size_t root, size_t end) {
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= end) return;
+        if (child + 1 < end && indices[child + 1] < indices[child]) child++;
+        if (indices[root] <= indices[child]) return;
+
+        uint32_t t = indices[root];
+        indices[root] = indices[child];
+        indices[child] = t;
+        root = child;
+    }
+}
+
+// heap sort of slot indices, highest first so the lowest ends on top of the stack.
+static void pool__sort_indices(uint32_t *indices, size_t count) {
+    for (size_t i = count / 2; i-- > 0;) pool__sift_down(indices, i, count);
+
+    for (size_t end = count; end-- > 1;) {
+        uint32_t t = indices[0];
+        indices[0] = indices[end];
+        indices[end] = t;
+        pool__sift_down(indices, 0, end);
+    }
+}
+
+// bottom-up merge sort of a free list by address, o(n log n) without extra memory.
+static void *pool__sort_list(void *head) {
+    for (size_t width = 1;; width *= 2) {
+        void *p = head;
+        void *tail = NULL;
+        size_t merges = 0;
+        head = NULL;
+
+        while (p != NULL) {
+            merges++;
+
+            // p runs for psize slots, q starts right after it
+            void *q = p;
+            size_t psize = 0;
+            while (psize < width && q != NULL) {
+                psize++;
+                q = pool__link_load(q);
+            }
+            size_t qsize = width;
+
+            while (psize > 0 || (qsize > 0 && q != NULL)) {
+                void *e;
+                if (psize == 0) {
+                    e = q;
+                    q = pool__link_load(q);
+                    qsize--;
+                } else if (qsize == 0 || q == NULL || (uintptr_t)p < (uintptr_t)q) {
+                    e = p;
+                    p = pool__link_load(p);
+                    psize--;
+                } else {
+                    e = q;
+                    q = pool__link_load(q);
+                    qsize--;
+                }
+
+                if (tail != NULL) {
+                    pool__link_store(tail, e);
+                } else {
+                    head = e;
+                }
+                tail = e;
+            }
+            p = q;
+        }
+
+        if (tail != NULL) pool__link_store(tail, NULL);
+        if (merges <= 1) return head;
+    }
+}
+
+#endif // POOL_CONCURRENT
+
+// forgets every free slot and rewinds the fresh cursor, o(1).
+static void pool__reset_free_list(pool_t *pool) {
+    pool->free_list = NULL;
+    pool->fresh = 0;
+#ifdef POOL_CONCURRENT
+    pool->free_head = 0;
+#endif
+#ifdef POOL_DYNAMIC
+    pool->bump_chunk = pool->chunks;
+#endif
+    if (pool->occupancy) pool__bitmap_reset(pool);
+#ifndef POOL_CONCURRENT
+    if (pool->pages) pool__page_reset(pool);
+#endif
+    pool->free_top = 0;
+    pool->released_from = pool->slot_count;
+    pool->free_count = pool->slot_count;
+}
+
+#ifdef POOL_CONCURRENT
+
+// free slots hold the next index + 1, the head packs index + 1 with a tag.
+static uint64_t pool__head_pack(uint64_t old_head, uint32_t top) {
+    return ((uint64_t)((uint32_t)(old_head >> 32) + 1) << 32) | top;
+}
+
+static void *pool__pop(pool_t *pool) {
+    uint64_t head = POOL__LOAD64(&pool->free_head);
+
+    for (;;) {
+        uint32_t top = (uint32_t)head;
+        if (top == 0) {
+            void *fresh = pool__take_fresh(pool);
+            if (fresh) POOL__ATOMIC_SUB(&pool->free_count, 1);
+            return fresh;
+        }
+
+        // the slot may be handed out and rewritten by another thread while we
+        // read it, the tag makes the cas fail in that case
+        uint8_t *slot = pool->buffer + (size_t)(top - 1) * pool->slot_size;
+        uint32_t next = POOL__LOAD32((uint32_t *)slot);
+
+        if (POOL__CAS64(&pool->free_head, head, pool__head_pack(head, next))) {
+            POOL__ATOMIC_SUB(&pool->free_count, 1);
+            return slot;
+        }
+        head = POOL__LOAD64(&pool->free_head);
+    }
+}
+
+// pushes a prelinked chain first..last of count slots in one cas.
+static void pool__push_chain(pool_t *pool, void *first, void *last, size_t count) {
+    uint32_t top = (uint32_t)pool__slot_index(pool, first) + 1;
+
+    // count first so free_count never dips below the real list length
+    POOL__ATOMIC_ADD(&pool->free_count, count);
+
+    uint64_t head = POOL__LOAD64(&pool->free_head);
+    for (;;) {
+        POOL__STORE32((uint32_t *)last, (uint32_t)head);
+        if (POOL__CAS64(&pool->free_head, head, pool__head_pack(head, top))) return;
+        head = POOL__LOAD64(&pool->free_head);
+    }
+}
+
+#endif // POOL_CONCURRENT
+
+// what a null config means. slots smaller than a pointer go on the bitmap engine
+// instead of being rounded up to hold a free list link.
+static void pool__default_config(pool_config_t *config, size_t slot_size) {
+    POOL_MEMSET(config, 0, sizeof(*config));
+#ifndef POOL_CONCURRENT
+    if (slot_size < sizeof(void *)) config->engine = POOL_ENGINE_BITMAP;
+#endif
+    (void)slot_size;
+}
+
+POOL_API int pool_init(pool_t *pool, void *buffer, size_t size, size_t slot_size) {
+    return pool_init_ex(pool, buffer, size, slot_size, NULL);
+}
+
+static size_t pool__handle_max_slots(void) {
+    return (size_t)1 << POOL_HANDLE_INDEX_BITS;
+}
+
+// address ordered reuse runs on the bitmap engine's index whatever the engine.
+static int pool__index_engine(const pool_config_t *config) {
+    if (config->engine == POOL_ENGINE_BITMAP || config->reuse == POOL_REUSE_ADDRESS) {
+        return POOL_ENGINE_BITMAP;
+    }
+    return (int)config->engine;
+}
+
+static int pool__check_config(const pool_config_t *config) {
+    if ((unsigned)config->engine > (unsigned)POOL_ENGINE_STACK) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    if ((config->alignment & (config->alignment - 1)) != 0) {
+        return POOL_ERR_INVALID_ALIGNMENT;
+    }
+    if ((config->flags & ~(unsigned)(POOL_FLAG_OCCUPANCY | POOL_FLAG_HANDLES | POOL_FLAG_RELOCATABLE)) != 0) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    if ((unsigned)config->reuse > (unsigned)POOL_REUSE_PAGE) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    // the bitmap engine only knows address order
+    if (config->engine == POOL_ENGINE_BITMAP &&
+        (config->reuse == POOL_REUSE_LIFO || config->reuse == POOL_REUSE_PAGE)) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    // and the index stack only lifo
+    if (config->engine == POOL_ENGINE_STACK &&
+        (config->reuse == POOL_REUSE_ADDRESS || config->reuse == POOL_REUSE_PAGE)) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    // compaction finds holes and live slots through the bitmap engine
+    if ((config->flags & POOL_FLAG_RELOCATABLE) && pool__index_engine(config) != POOL_ENGINE_BITMAP) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    // cached objects keep their state while free, so no link may live in the slot,
+    // and compaction would copy over a constructed object
+    if ((config->ctor != NULL || config->dtor != NULL) &&
+        (pool__index_engine(config) == POOL_ENGINE_FREELIST || (config->flags & POOL_FLAG_RELOCATABLE))) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+#ifdef POOL_CONCURRENT
+    // occupancy bits, generations and ordered reuse have no lock-free variant
+    if (pool__has_occupancy(pool__index_engine(config), config->flags)) return POOL_ERR_UNSUPPORTED;
+    if (config->flags & (POOL_FLAG_HANDLES | POOL_FLAG_RELOCATABLE)) return POOL_ERR_UNSUPPORTED;
+    if (config->reuse != POOL_REUSE_DEFAULT && config->reuse != POOL_REUSE_LIFO) return POOL_ERR_UNSUPPORTED;
+    if (config->engine == POOL_ENGINE_STACK) return POOL_ERR_UNSUPPORTED;
+#endif
+    return POOL_OK;
+}
+
+// relocatable pools always carry handles.
+static unsigned pool__config_flags(const pool_config_t *config) {
+    unsigned flags = config->flags;
+    if (flags & POOL_FLAG_RELOCATABLE) flags |= POOL_FLAG_HANDLES;
+    return flags;
+}
+
+POOL_API int pool_init_ex(pool_t *pool, void *buffer, size_t size, size_t slot_size, const pool_config_t *config) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (buffer == NULL) return POOL_ERR_NULL_BUFFER;
+    if (slot_size == 0) return POOL_ERR_INVALID_SLOT_SIZE;
+
+    // check power of two
+    if ((POOL_ALIGN & (POOL_ALIGN - 1)) != 0) {
+        return POOL_ERR_INVALID_ALIGNMENT;
+    }
+
+    pool_config_t defaults;
+    if (config == NULL) {
+        pool__default_config(&defaults, slot_size);
+        config = &defaults;
+    }
+
+    int err = pool__check_config(config);
+    if (err != POOL_OK) return err;
+
+    int engine = pool__index_engine(config);
+    int reuse = (int)config->reuse;
+    unsigned flags = pool__config_flags(config);
+
+    POOL_MEMSET(pool, 0, sizeof(pool_t));
+
+    // slot size rules follow the engine asked for, the index may differ
+    size_t effective_slot_size = pool__effective_slot_size(slot_size, (int)config->engine, config->alignment);
+
+    size_t align = config->alignment ? config->alignment : (size_t)POOL_ALIGN;
+    uint8_t *aligned_start = pool__align_ptr((uint8_t *)buffer, align);
+    size_t alignment_overhead = (size_t)(aligned_start - (uint8_t *)buffer);
+
+    if (alignment_overhead >= size) {
+        return POOL_ERR_BUFFER_TOO_SMALL;
+    }
+
+    size_t usable_size = size - alignment_overhead;
+
+    // the end of the buffer holds the engine bitmaps and the debug bitmap
+    size_t slot_count = pool__fit_slots(usable_size, effective_slot_size, engine, flags, reuse);
+    if (slot_count == 0) {
+        return POOL_ERR_BUFFER_TOO_SMALL;
+    }
+
+    // page lists, buckets and the index stack hold 32-bit indices
+    if ((reuse == POOL_REUSE_PAGE || engine == POOL_ENGINE_STACK) && slot_count > (size_t)UINT32_MAX - 1) {
+        slot_count = (size_t)UINT32_MAX - 1;
+    }
+
+#ifdef POOL_CONCURRENT
+    // slot links are 32-bit indices
+    if (slot_count > (size_t)UINT32_MAX - 1) {
+        slot_count = (size_t)UINT32_MAX - 1;
+    }
+#endif
+
+    if ((flags & POOL_FLAG_HANDLES) && slot_count > pool__handle_max_slots()) {
+        slot_count = pool__handle_max_slots();
+    }
+
+    pool->buffer = aligned_start;
+    pool->buffer_end = aligned_start + slot_count * effective_slot_size;
+    pool->slot_size = effective_slot_size;
+    pool->slot_count = slot_count;
+    pool__set_divisor(pool, effective_slot_size);
+    pool->engine = engine;
+    pool->ctor = config->ctor;
+    pool->dtor = config->dtor;
+    pool->cache_ctx = config->cache_ctx;
+    pool->cached = config->ctor != NULL || config->dtor != NULL;
+#ifdef POOL_HARDENED
+    pool->free_key = pool__make_free_key(pool);
+#endif
+
+    uint8_t *side = pool->buffer_end;
+    if (engine == POOL_ENGINE_STACK) {
+        // only the part below free_top is ever read, nothing to clear
+        pool->free_stack = (uint32_t *)pool__align_ptr(side, sizeof(uint32_t));
+        side = (uint8_t *)(pool->free_stack + slot_count);
+    }
+
+    if (reuse == POOL_REUSE_PAGE) {
+        size_t shift = 0;
+        while (((size_t)1 << shift) < (size_t)POOL_PAGE_SIZE) shift++;
+        pool->page_shift = shift;
+        pool->page_base = (uintptr_t)aligned_start >> shift;
+        pool->page_count = (size_t)(((uintptr_t)(pool->buffer_end - 1) >> shift) - pool->page_base) + 1;
+        pool->page_slots = pool__page_slots(effective_slot_size);
+        pool->pages = (pool_page_t *)pool__align_ptr(side, sizeof(void *));
+        pool->page_buckets = (uint32_t *)(pool->pages + pool->page_count);
+        side = (uint8_t *)(pool->page_buckets + pool->page_slots + 1);
+    }
+
+    if (pool__has_occupancy(engine, flags)) {
+        pool->occupancy_words = (slot_count + 63) / 64;
+        pool->occupancy = (uint64_t *)pool__align_ptr(side, sizeof(uint64_t));
+        side = (uint8_t *)(pool->occupancy + pool->occupancy_words);
+        if (engine == POOL_ENGINE_BITMAP) {
+            pool->summary = (uint64_t *)side;
+            side = (uint8_t *)(pool->summary + (pool->occupancy_words + 63) / 64);
+        }
+    }
+
+    if (flags & POOL_FLAG_RELOCATABLE) {
+        pool->handle_slot = (uint32_t *)pool__align_ptr(side, sizeof(uint32_t));
+        pool->slot_handle = pool->handle_slot + slot_count;
+        POOL_MEMSET(pool->handle_slot, 0, 2 * slot_count * sizeof(uint32_t));
+        side = (uint8_t *)(pool->slot_handle + slot_count);
+    }
+
+    if (flags & POOL_FLAG_HANDLES) {
+        pool->generations = (uint16_t *)pool__align_ptr(side, sizeof(uint16_t));
+        POOL_MEMSET(pool->generations, 0, slot_count * sizeof(uint16_t));
+        side = (uint8_t *)(pool->generations + slot_count);
+    }
+
+#ifdef POOL_DEBUG
+    pool->alloc_bitmap = side;
+    pool->bitmap_size = pool__align_up((slot_count + 7) / 8, POOL_ALIGN);
+    POOL_MEMSET(pool->alloc_bitmap, 0, pool->bitmap_size);
+    pool->user_buffer = (uint8_t *)buffer;
+    pool->user_buffer_size = size;
+#endif
+
+    pool__reset_free_list(pool);
+
+    return POOL_OK;
+}
+
+#ifdef POOL_DYNAMIC
+POOL_API int pool_init_dynamic(pool_t *pool, size_t slot_size, const pool_dynamic_config_t *config) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (slot_size == 0) return POOL_ERR_INVALID_SLOT_SIZE;
+
+    if ((POOL_ALIGN & (POOL_ALIGN - 1)) != 0) {
+        return POOL_ERR_INVALID_ALIGNMENT;
+    }
+
+    pool_dynamic_config_t defaults;
+    POOL_MEMSET(&defaults, 0, sizeof(defaults));
+    if (config == NULL) config = &defaults;
+
+    size_t chunk_size = config->chunk_size ? config->chunk_size : (size_t)POOL_CHUNK_SIZE;
+    if ((chunk_size & (chunk_size - 1)) != 0 || chunk_size < POOL_ALIGN) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    if ((config->alignment & (config->alignment - 1)) != 0) {
+        return POOL_ERR_INVALID_ALIGNMENT;
+    }
+    if (config->backing != POOL_BACKING_MALLOC && config->backing != POOL_BACKING_MMAP) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+    if (config->backing == POOL_BACKING_MMAP && chunk_size < pool__os_page_size()) {
+        return POOL_ERR_INVALID_CONFIG;
+    }
+
+    POOL_MEMSET(pool, 0, sizeof(pool_t));
+
+    size_t effective_slot_size = pool__effective_slot_size(slot_size, POOL_ENGINE_FREELIST, config->alignment);
+    size_t align = config->alignment ? config->alignment : (size_t)POOL_ALIGN;
+
+    // big slots get a bigger chunk so each chunk holds at least one
+    size_t slots_offset = 0;
+    while (pool__chunk_capacity(chunk_size, effective_slot_size, align, &slots_offset) == 0) {
+        if (chunk_size > SIZE_MAX / 4) return POOL_ERR_INVALID_SLOT_SIZE;
+        chunk_size *= 2;
+    }
+
+    pool->slot_size = effective_slot_size;
+    pool__set_divisor(pool, effective_slot_size);
+#ifdef POOL_HARDENED
+    pool->free_key = pool__make_free_key(pool);
+#endif
+    pool->chunk_size = chunk_size;
+    pool->grow_chunks = 1;
+    pool->max_slots = config->max_slots;
+    pool->growth = (int)config->growth;
+    pool->backing = (int)config->backing;
+    pool->dynamic = 1;
+    pool->alignment = align;
+    pool->color_step = config->color_step ? pool__align_up(config->color_step, align) : 0;
+
+    int err = pool__grow(pool);
+    if (err != POOL_OK) {
+        if (pool->chunk_table) POOL_SYS_FREE(pool->chunk_table);
+        POOL_MEMSET(pool, 0, sizeof(pool_t));
+        return err;
+    }
+
+    pool__reset_free_list(pool);
+
+    return POOL_OK;
+}
+#endif
+
+// constructs every slot up to and including slot that never held an object. a
+// bitmap pool may skip ahead (pool_alloc_near), the slots it jumped over get
+// constructed too so everything below the mark stays constructed.
+static void pool__construct_upto(pool_t *pool, void *slot) {
+    size_t index = pool__slot_index(pool, slot);
+    while (pool->constructed <= index) {
+        if (pool->ctor) pool->ctor(pool->buffer + pool->constructed * pool->slot_size, pool->cache_ctx);
+        pool->constructed++;
+    }
+}
+
+// every constructed slot leaves the cache, live or free.
+static void pool__destruct_all(pool_t *pool) {
+    for (size_t i = 0; i < pool->constructed; i++) {
+        uint8_t *obj = pool->buffer + i * pool->slot_size;
+        if (pool->dtor) pool->dtor(obj, pool->cache_ctx);
+#ifdef POOL_ZERO_ON_FREE
+        POOL_MEMSET(obj, 0, pool->slot_size);
+#endif
+    }
+    pool->constructed = 0;
+}
+
+POOL_API void pool_destroy(pool_t *pool) {
+    if (pool == NULL) return;
+
+#ifdef POOL_REMOTE_FREE
+    pool_drain_remote(pool);
+#endif
+#ifdef POOL_DEFERRED_ZERO
+    // the caller gets the buffer back, freed slots have to be zero by then
+    pool_scrub(pool, 0);
+#endif
+
+#ifdef POOL_DEBUG
+    size_t leaked = pool->slot_count - pool->free_count;
+    if (leaked > 0) {
+        POOL_DBG_PRINTF("POOL: Memory leak detected! %zu slots not freed.\n", leaked);
+
+        int first = 1;
+        POOL_DBG_PRINTF("POOL: Leaked slot indices: ");
+#ifdef POOL_DYNAMIC
+        if (pool->dynamic) {
+            size_t base = 0;
+            for (pool_chunk_t *c = pool->chunks; c; c = c->next) {
+                for (size_t i = 0; i < c->slot_count; i++) {
+                    if (pool__bitmap_get(c->alloc_bitmap, i)) {
+                        if (!first) POOL_DBG_PRINTF(", ");
+                        POOL_DBG_PRINTF("%zu", base + i);
+                        first = 0;
+                    }
+                }
+                base += c->slot_count;
+            }
+        } else
+#endif
+        for (size_t i = 0; i < pool->slot_count; i++) {
+            if (pool__bitmap_get(pool->alloc_bitmap, i)) {
+                if (!first) POOL_DBG_PRINTF(", ");
+                POOL_DBG_PRINTF("%zu", i);
+                first = 0;
+            }
+        }
+        POOL_DBG_PRINTF("\n");
+        POOL_ASSERT(leaked == 0 && "Pool destroyed with leaked allocations");
+    }
+#endif
+
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) {
+        pool_chunk_t *c = pool->chunks;
+        while (c) {
+            pool_chunk_t *next = c->next;
+            pool__chunk_unmap(pool, c);
+            c = next;
+        }
+        if (pool->chunk_table) POOL_SYS_FREE(pool->chunk_table);
+    }
+#endif
+
+    if (pool->cached) pool__destruct_all(pool);
+
+    POOL_MEMSET(pool, 0, sizeof(pool_t));
+}
+
+// generation + 1 goes into handles, so it cycles through [0, max - 1) and a handle is never 0.
+static void pool__bump_generation(pool_t *pool, size_t index) {
+    uint32_t max = ((uint32_t)1 << (32 - POOL_HANDLE_INDEX_BITS)) - 1;
+    uint32_t next = (uint32_t)pool->generations[index] + 1;
+    pool->generations[index] = (uint16_t)(next == max ? 0 : next);
+}
+
+// handle entry owned by a slot, the same index unless compaction moved things around.
+static size_t pool__handle_entry(const pool_t *pool, size_t slot) {
+    if (pool->slot_handle == NULL) return slot;
+    return pool->slot_handle[slot] ^ (uint32_t)slot;
+}
+
+static size_t pool__handle_target(const pool_t *pool, size_t entry) {
+    if (pool->handle_slot == NULL) return entry;
+    return pool->handle_slot[entry] ^ (uint32_t)entry;
+}
+
+static pool_handle_t pool__make_handle(const pool_t *pool, size_t entry) {
+    return (((pool_handle_t)pool->generations[entry] + 1) << POOL_HANDLE_INDEX_BITS) | (pool_handle_t)entry;
+}
+
+// debug bookkeeping and zeroing for a slot that was just taken off the free list.
+static void pool__prepare_slot(pool_t *pool, void *slot) {
+#ifdef POOL_DEBUG
+    size_t index;
+    uint8_t *bitmap = pool__debug_bitmap(pool, slot, &index);
+    POOL_ASSERT(!pool__bitmap_get(bitmap, index) && "Allocating already-allocated slot");
+    pool__bitmap_set(bitmap, index);
+
+#ifdef POOL_CONCURRENT
+    POOL__ATOMIC_ADD(&pool->total_allocs, 1);
+    size_t used = pool->slot_count - pool__free_count(pool);
+    size_t peak = POOL__ATOMIC_LOAD(&pool->peak_used);
+    while (used > peak) {
+        if (POOL__CAS_SIZE(&pool->peak_used, peak, used)) break;
+        peak = POOL__ATOMIC_LOAD(&pool->peak_used);
+    }
+#else
+    pool->total_allocs++;
+    size_t used = pool->slot_count - pool__free_count(pool);
+    if (used > pool->peak_used) pool->peak_used = used;
+#endif
+#endif
+
+    // the bitmap engine already set the bit when it picked the slot
+    if (pool->occupancy && pool->engine != POOL_ENGINE_BITMAP) {
+        pool__occupancy_set(pool, slot, 1);
+    }
+
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+    if (pool__has_free_key(pool)) ((uintptr_t *)slot)[1] = 0;
+#endif
+
+    // a cached object comes out the way the ctor or its last user left it
+    if (pool->cached) {
+        pool__construct_upto(pool, slot);
+        return;
+    }
+
+#ifdef POOL_ZERO_ON_ALLOC
+    POOL_MEMSET(slot, 0, pool->slot_size);
+#endif
+}
+
+// validates a pointer about to be freed, in debug mode this also catches double frees.
+static int pool__check_free(const pool_t *pool, void *ptr) {
+    if (ptr == NULL) return POOL_ERR_NULL_PTR;
+
+    if (!pool_owns(pool, ptr)) {
+#ifdef POOL_DEBUG
+        POOL_DBG_PRINTF("POOL: Invalid free - pointer %p not owned by pool\n", ptr);
+        POOL_ASSERT(0 && "Freeing pointer not owned by pool");
+#endif
+        return POOL_ERR_INVALID_PTR;
+    }
+
+#ifdef POOL_DEBUG
+    size_t index;
+    uint8_t *bitmap = pool__debug_bitmap(pool, ptr, &index);
+
+    // check double free via bitmap
+    if (!pool__bitmap_get(bitmap, index)) {
+        POOL_DBG_PRINTF("POOL: Double free detected at slot %zu (ptr=%p)\n", index, ptr);
+        POOL_ASSERT(0 && "Double free detected");
+        return POOL_ERR_DOUBLE_FREE;
+    }
+
+    // check double free via magic
+    if (pool->engine == POOL_ENGINE_FREELIST && pool->slot_size >= sizeof(void *) + sizeof(uintptr_t)) {
+        if (pool__has_free_magic((uint8_t *)ptr + sizeof(void *))) {
+            POOL_DBG_PRINTF("POOL: Double free detected via magic at slot %zu\n", index);
+            POOL_ASSERT(0 && "Double free detected via magic number");
+            return POOL_ERR_DOUBLE_FREE;
+        }
+    }
+#endif
+
+    // occupancy bits know which slots are live even without POOL_DEBUG
+    if (pool->occupancy && !pool__occupancy_get(pool, ptr)) {
+        return POOL_ERR_DOUBLE_FREE;
+    }
+
+#ifndef POOL_CONCURRENT
+    // every used slot is already on the stack, so the push could only overflow it
+    if (pool->free_stack && (pool__slot_index(pool, ptr) >= pool->fresh || pool->free_top >= pool->fresh)) {
+        return POOL_ERR_DOUBLE_FREE;
+    }
+#endif
+
+#ifdef POOL_HARDENED
+    if (pool->engine == POOL_ENGINE_FREELIST && pool__is_listed(pool, ptr)) {
+        POOL_DBG_PRINTF("POOL: Double free of listed slot %p\n", ptr);
+        return POOL_ERR_DOUBLE_FREE;
+    }
+#endif
+
+    return POOL_OK;
+}
+
+// debug bookkeeping, zeroing and poisoning for a checked slot on its way back.
+static void pool__retire_slot(pool_t *pool, void *ptr) {
+#ifdef POOL_DEBUG
+    size_t index;
+    uint8_t *bitmap = pool__debug_bitmap(pool, ptr, &index);
+    pool__bitmap_clear(bitmap, index);
+#ifdef POOL_CONCURRENT
+    POOL__ATOMIC_ADD(&pool->total_frees, 1);
+#else
+    pool->total_frees++;
+#endif
+#endif
+
+    if (pool->occupancy && pool->engine != POOL_ENGINE_BITMAP) {
+        pool__occupancy_set(pool, ptr, 0);
+    }
+
+    // outstanding handles to this slot go stale
+    if (pool->generations) {
+        pool__bump_generation(pool, pool__handle_entry(pool, pool__slot_index(pool, ptr)));
+    }
+
+    // the object stays constructed for the next user
+    if (pool->cached) return;
+
+#if defined(POOL_DEFERRED_ZERO)
+    if (!pool__defers_zero(pool)) POOL_MEMSET(ptr, 0, pool->slot_size);
+#elif defined(POOL_ZERO_ON_FREE)
+    POOL_MEMSET(ptr, 0, pool->slot_size);
+#endif
+
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+    if (pool__has_free_key(pool)) ((uintptr_t *)ptr)[1] = pool->free_key;
+#endif
+
+    // magic and poison leave the link word alone, so write them before the
+    // slot becomes visible to other threads
+#if defined(POOL_DEBUG) && !defined(POOL_ZERO_ON_FREE)
+    if (pool->engine != POOL_ENGINE_FREELIST) {
+        // no link word to keep, poison all of it
+        POOL_MEMSET(ptr, POOL_POISON_BYTE, pool->slot_size);
+    } else if (pool->slot_size >= sizeof(void *) + sizeof(uintptr_t)) {
+        pool__write_free_magic((uint8_t *)ptr + sizeof(void *));
+        pool__poison_slot(pool, ptr);
+    }
+#endif
+
+    (void)pool;
+    (void)ptr;
+}
+
+// links ptrs[0..count) into one chain and splices it onto the free list.
+static void pool__splice(pool_t *pool, void **ptrs, size_t count) {
+    if (count == 0) return;
+
+#ifdef POOL_CONCURRENT
+    for (size_t i = 0; i + 1 < count; i++) {
+        uint32_t next = (uint32_t)pool__slot_index(pool, ptrs[i + 1]) + 1;
+        *(uint32_t *)ptrs[i] = next;
+    }
+    pool__push_chain(pool, ptrs[0], ptrs[count - 1], count);
+#else
+#ifdef POOL_DEFERRED_ZERO
+    if (pool__defers_zero(pool)) {
+        // queued so the scrub leaves ptrs[0] on top, like the spliced chain,
+        // except the page lists which take the slots one by one
+        for (size_t i = 0; i < count; i++) {
+            pool__dirty_push(pool, ptrs[pool->pages ? i : count - 1 - i]);
+        }
+        return;
+    }
+#endif
+
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        for (size_t i = 0; i < count; i++) {
+            pool__bitmap_put(pool, ptrs[i]);
+        }
+        pool->free_count += count;
+        return;
+    }
+
+    if (pool->pages) {
+        for (size_t i = 0; i < count; i++) {
+            pool__page_put(pool, ptrs[i]);
+        }
+        pool->free_count += count;
+        return;
+    }
+
+    if (pool->free_stack) {
+        // pushed in reverse so ptrs[0] comes back first, like the spliced chain
+        for (size_t i = count; i-- > 0;) {
+            pool__stack_put(pool, ptrs[i]);
+        }
+        pool->free_count += count;
+        return;
+    }
+
+    for (size_t i = 0; i + 1 < count; i++) {
+        pool__link_store(ptrs[i], ptrs[i + 1]);
+    }
+    pool__link_store(ptrs[count - 1], pool->free_list);
+    pool->free_list = ptrs[0];
+    pool->free_count += count;
+#endif
+}
+
+#ifdef POOL_REMOTE_FREE
+// remote frees come back only once the local slots run short, so the owner's
+// fast path costs one compare of free_count.
+static void pool__remote_refill(pool_t *pool, size_t n) {
+    if (pool->free_count < n && POOL__LOAD_PTR(&pool->remote_head) != NULL) {
+        pool_drain_remote(pool);
+    }
+}
+#endif
+
+POOL_API void *pool_alloc(pool_t *pool) {
+    if (pool == NULL) return NULL;
+
+#ifdef POOL_CONCURRENT
+    void *slot = pool__pop(pool);
+    if (slot == NULL) return NULL;
+#else
+#ifdef POOL_REMOTE_FREE
+    pool__remote_refill(pool, 1);
+#endif
+#ifdef POOL_DEFERRED_ZERO
+    if (pool->free_count == 0 && pool->dirty_count > 0) {
+        void *dirty = pool__take_dirty(pool);
+        if (dirty != NULL) pool__prepare_slot(pool, dirty);
+        return dirty;
+    }
+#endif
+
+    void *slot;
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        slot = pool__bitmap_take(pool);
+        if (slot == NULL) return NULL;
+    } else if (pool->pages) {
+        slot = pool__page_take(pool);
+        if (slot == NULL) slot = pool__take_fresh(pool);
+        if (slot == NULL) return NULL;
+    } else if (pool->free_stack) {
+        slot = pool__stack_take(pool);
+        if (slot == NULL) return NULL;
+    } else {
+        // pop from free list, fall back to never-used slots
+        slot = pool->free_list;
+        if (slot != NULL) {
+            void *next = pool__link_load(slot);
+#ifdef POOL_HARDENED
+            if (!pool__link_valid(pool, next)) {
+                pool__link_corrupt(pool, slot);
+                return NULL;
+            }
+#endif
+            pool->free_list = next;
+        } else {
+            slot = pool__take_fresh(pool);
+            if (slot == NULL) return NULL;
+        }
+    }
+    pool->free_count--;
+#endif
+
+    pool__prepare_slot(pool, slot);
+
+    return slot;
+}
+
+#ifndef POOL_CONCURRENT
+// hands a clean slot to the engine's free index.
+static void pool__put_clean(pool_t *pool, void *ptr) {
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        pool__bitmap_put(pool, ptr);
+    } else if (pool->pages) {
+        pool__page_put(pool, ptr);
+    } else if (pool->free_stack) {
+        pool__stack_put(pool, ptr);
+    } else {
+        pool__link_store(ptr, pool->free_list);
+        pool->free_list = ptr;
+    }
+    pool->free_count++;
+}
+#endif
+
+// hands a retired slot to the engine's free index.
+static void pool__put_slot(pool_t *pool, void *ptr) {
+#ifdef POOL_CONCURRENT
+    pool__push_chain(pool, ptr, ptr, 1);
+#else
+#ifdef POOL_DEFERRED_ZERO
+    if (pool__defers_zero(pool)) {
+        pool__dirty_push(pool, ptr);
+        return;
+    }
+#endif
+    pool__put_clean(pool, ptr);
+#endif
+}
+
+POOL_API void *pool_alloc_near(pool_t *pool, const void *hint) {
+    if (pool == NULL) return NULL;
+
+#ifndef POOL_CONCURRENT
+    // only the page lists and the bitmap index know where the free slots are
+    uintptr_t offset = (uintptr_t)hint - (uintptr_t)pool->buffer;
+    if ((pool->pages != NULL || pool->engine == POOL_ENGINE_BITMAP) && hint != NULL &&
+        (uintptr_t)hint >= (uintptr_t)pool->buffer && offset < pool->slot_count * pool->slot_size) {
+        void *slot;
+        if (pool->pages != NULL) {
+            slot = pool__page_take_near(pool, pool__page_of(pool, hint));
+        } else {
+            size_t span = (POOL_NEAR_PAGES * POOL_PAGE_SIZE / pool->slot_size + 63) / 64;
+            slot = pool__bitmap_take_near(pool, offset / pool->slot_size, span);
+        }
+
+        if (slot != NULL) {
+            pool->free_count--;
+            pool__prepare_slot(pool, slot);
+            return slot;
+        }
+    }
+#else
+    (void)hint;
+#endif
+
+    return pool_alloc(pool);
+}
+
+POOL_API int pool_free(pool_t *pool, void *ptr) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+
+    int err = pool__check_free(pool, ptr);
+    if (err != POOL_OK) return err;
+
+    pool__retire_slot(pool, ptr);
+    pool__put_slot(pool, ptr);
+
+    return POOL_OK;
+}
+
+POOL_API void *pool_alloc_run(pool_t *pool, size_t n) {
+    if (pool == NULL || n == 0) return NULL;
+    if (n == 1) return pool_alloc(pool);
+
+#ifdef POOL_CONCURRENT
+    return NULL;
+#else
+#ifdef POOL_DYNAMIC
+    if (!pool->dynamic && n > pool->free_count) return NULL;
+#else
+    if (n > pool->free_count) return NULL;
+#endif
+
+    uint8_t *first;
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        size_t index = pool__bitmap_find_run(pool, n);
+        if (index >= pool->slot_count) return NULL;
+
+        pool__bitmap_mark_run(pool, index, n, 1);
+        // the pages come back on first touch, they have to be released again later
+        if (index + n > pool->released_from) pool->released_from = pool->slot_count;
+        first = pool->buffer + index * pool->slot_size;
+    } else {
+        // listed slots are scattered, only the never used tail is known to be adjacent
+#ifdef POOL_DYNAMIC
+        if (pool->dynamic) {
+            // a run never spans chunks. a tail too short for it goes on the free
+            // list and the run is cut from the next chunk, grown if there is none
+            pool_chunk_t *c = pool->bump_chunk;
+            if (n > c->slot_count) return NULL;
+            if (pool->fresh + n > c->slot_count) {
+                if (c->next == NULL && pool__grow(pool) != POOL_OK) return NULL;
+                for (size_t i = pool->fresh; i < c->slot_count; i++) {
+                    void *slot = c->slots + i * pool->slot_size;
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+                    if (pool__has_free_key(pool)) ((uintptr_t *)slot)[1] = pool->free_key;
+#endif
+                    pool__link_store(slot, pool->free_list);
+                    pool->free_list = slot;
+                }
+                pool->bump_chunk = c->next;
+                pool->fresh = 0;
+            }
+            first = pool->bump_chunk->slots + pool->fresh * pool->slot_size;
+        } else
+#endif
+        {
+            if (pool->fresh + n > pool->slot_count) return NULL;
+            first = pool->buffer + pool->fresh * pool->slot_size;
+#ifdef POOL_DEFERRED_ZERO
+            pool__zero_fresh(pool, pool->fresh, n);
+#endif
+        }
+        pool->fresh += n;
+    }
+    pool->free_count -= n;
+
+    for (size_t i = 0; i < n; i++) {
+        pool__prepare_slot(pool, first + i * pool->slot_size);
+    }
+
+    return first;
+#endif
+}
+
+POOL_API int pool_free_run(pool_t *pool, void *ptr, size_t n) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (ptr == NULL) return POOL_ERR_NULL_PTR;
+    if (n == 0) return POOL_OK;
+
+    // the slots are distinct, so checking them all first is enough to free none on error
+    uint8_t *first = (uint8_t *)ptr;
+    for (size_t i = 0; i < n; i++) {
+        int err = pool__check_free(pool, first + i * pool->slot_size);
+        if (err != POOL_OK) return err;
+    }
+#ifndef POOL_CONCURRENT
+    if (pool->free_stack && !pool__stack_run_fits(pool, first, n)) return POOL_ERR_DOUBLE_FREE;
+#endif
+
+    for (size_t i = 0; i < n; i++) {
+        pool__retire_slot(pool, first + i * pool->slot_size);
+    }
+
+#ifndef POOL_CONCURRENT
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        pool__bitmap_mark_run(pool, pool__slot_index(pool, first), n, 0);
+        pool->free_count += n;
+        return POOL_OK;
+    }
+#endif
+
+    // last slot first, so the run comes back from the front on lifo pools
+    for (size_t i = n; i-- > 0;) {
+        pool__put_slot(pool, first + i * pool->slot_size);
+    }
+
+    return POOL_OK;
+}
+
+#ifdef POOL_DEFERRED_ZERO
+POOL_API size_t pool_scrub(pool_t *pool, size_t budget) {
+    if (pool == NULL) return 0;
+    if (budget == 0) budget = SIZE_MAX;
+
+    size_t done = 0;
+    while (done < budget) {
+        void *slot = pool__dirty_pop(pool);
+        if (slot == NULL) break;
+
+        pool__zero_stream(slot, pool->slot_size);
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+        if (pool__has_free_key(pool)) ((uintptr_t *)slot)[1] = pool->free_key;
+#endif
+        pool__put_clean(pool, slot);
+        done++;
+    }
+
+    // then the part a deferred reset left, from the top so the fresh cursor meets it last
+    while (done < budget && pool->dirty_fresh > pool->fresh) {
+        size_t n = pool->dirty_fresh - pool->fresh;
+        if (n > budget - done) n = budget - done;
+        pool->dirty_fresh -= n;
+        pool__zero_stream(pool->buffer + pool->dirty_fresh * pool->slot_size, n * pool->slot_size);
+        done += n;
+    }
+    if (pool->dirty_fresh <= pool->fresh) pool->dirty_fresh = 0;
+
+#ifdef POOL__STREAM_STORES
+    // streaming stores are weakly ordered, publish them before the slots are reused
+    _mm_sfence();
+#endif
+    return done;
+}
+#endif
+
+#ifdef POOL_REMOTE_FREE
+POOL_API int pool_free_remote(pool_t *pool, void *ptr) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (ptr == NULL) return POOL_ERR_NULL_PTR;
+
+    // the link goes into the slot, it has to fit and may not clobber a cached object
+    if (pool->slot_size < sizeof(void *) || pool->cached) return POOL_ERR_UNSUPPORTED;
+
+    // buffer bounds never change after init, the chunk table of a dynamic pool does
+#ifdef POOL_DYNAMIC
+    if (!pool->dynamic && !pool_owns(pool, ptr)) return POOL_ERR_INVALID_PTR;
+#else
+    if (!pool_owns(pool, ptr)) return POOL_ERR_INVALID_PTR;
+#endif
+
+    void *head;
+    do {
+        head = POOL__LOAD_PTR(&pool->remote_head);
+        *(void **)ptr = head;
+    } while (!POOL__CAS_PTR(&pool->remote_head, head, ptr));
+
+    return POOL_OK;
+}
+
+POOL_API size_t pool_drain_remote(pool_t *pool) {
+    if (pool == NULL) return 0;
+
+    // taking the whole list leaves nothing for a stale cas to corrupt
+    void *node = POOL__XCHG_PTR(&pool->remote_head, NULL);
+    size_t freed = 0;
+    while (node != NULL) {
+        void *next = *(void **)node;
+        if (pool_free(pool, node) == POOL_OK) freed++;
+        node = next;
+    }
+    return freed;
+}
+#endif
+
+POOL_API size_t pool_alloc_bulk_partial(pool_t *pool, void **out, size_t n) {
+    if (pool == NULL || out == NULL || n == 0) return 0;
+
+    size_t taken = 0;
+
+#ifdef POOL_CONCURRENT
+    while (taken < n) {
+        void *slot = pool__pop(pool);
+        if (slot == NULL) break;
+        out[taken++] = slot;
+    }
+#else
+#ifdef POOL_REMOTE_FREE
+    pool__remote_refill(pool, n);
+#endif
+#ifdef POOL_DYNAMIC
+    // dirty slots count, they are used up before the pool grows
+    while (pool->dynamic && pool__free_count(pool) < n) {
+        if (pool__grow(pool) != POOL_OK) break;
+    }
+#endif
+
+    size_t want = n < pool->free_count ? n : pool->free_count;
+
+    if (pool->engine == POOL_ENGINE_BITMAP) {
+        while (taken < want) {
+            out[taken++] = pool__bitmap_take(pool);
+        }
+    } else if (pool->pages) {
+        while (taken < want) {
+            void *slot = pool__page_take(pool);
+            if (slot == NULL) slot = pool__take_fresh(pool);
+            if (slot == NULL) break;
+            out[taken++] = slot;
+        }
+    } else if (pool->free_stack) {
+        // pop a run off the top of the stack, then never-used slots
+        while (taken < want && pool->free_top > 0) {
+            out[taken++] = pool->buffer + (size_t)pool->free_stack[--pool->free_top] * pool->slot_size;
+        }
+        while (taken < want) {
+            out[taken++] = pool__take_fresh(pool);
+        }
+    } else {
+        // detach a run from the head of the free list
+        void *slot = pool->free_list;
+        while (taken < want && slot != NULL) {
+            void *next = pool__link_load(slot);
+#ifdef POOL_HARDENED
+            if (!pool__link_valid(pool, next)) {
+                // hand out what was checked, the broken link stays at the head
+                pool__link_corrupt(pool, slot);
+                want = taken;
+                break;
+            }
+#endif
+            out[taken++] = slot;
+            slot = next;
+        }
+        pool->free_list = slot;
+
+        // the rest are contiguous never-used slots, handed out without reading them
+        while (taken < want) {
+            out[taken++] = pool__take_fresh(pool);
+        }
+    }
+    pool->free_count -= taken;
+
+#ifdef POOL_DEFERRED_ZERO
+    // clean and never used slots ran out, zero dirty ones one at a time
+    while (taken < n && pool->dirty_count > 0) {
+        void *slot = pool__take_dirty(pool);
+        if (slot == NULL) break;
+        out[taken++] = slot;
+    }
+#endif
+#endif
+
+    for (size_t i = 0; i < taken; i++) {
+        pool__prepare_slot(pool, out[i]);
+    }
 
-    POOL_MEMSET(pool, 0, sizeof(pool_t));
+    return taken;
 }
 
-POOL_API void *pool_alloc(pool_t *pool) {
-    if (pool == NULL) return NULL;
+POOL_API size_t pool_alloc_bulk(pool_t *pool, void **out, size_t n) {
+    if (pool == NULL || out == NULL || n == 0) return 0;
 
-    if (pool->free_list == NULL) {
-        return NULL;
+#ifdef POOL_CONCURRENT
+    // another thread may take slots between our pops, so undo a short batch
+    size_t taken = 0;
+    while (taken < n) {
+        void *slot = pool__pop(pool);
+        if (slot == NULL) break;
+        out[taken++] = slot;
+    }
+    if (taken < n) {
+        pool__splice(pool, out, taken);
+        return 0;
+    }
+    for (size_t i = 0; i < taken; i++) {
+        pool__prepare_slot(pool, out[i]);
+    }
+    return taken;
+#else
+#ifdef POOL_REMOTE_FREE
+    pool__remote_refill(pool, n);
+#endif
+#ifdef POOL_DYNAMIC
+    while (pool->dynamic && pool__free_count(pool) < n) {
+        if (pool__grow(pool) != POOL_OK) break;
     }
+#endif
+    if (pool__free_count(pool) < n) return 0;
 
-    // pop from free list
-    void *slot = pool->free_list;
-    void **next_ptr = (void **)slot;
-    pool->free_list = *next_ptr;
-    pool->free_count--;
+    return pool_alloc_bulk_partial(pool, out, n);
+#endif
+}
 
+// marks ptrs[0..count) live again after a bulk free failed validation.
+static void pool__undo_batch(pool_t *pool, void **ptrs, size_t count) {
+    for (size_t j = 0; j < count; j++) {
 #ifdef POOL_DEBUG
-    size_t index = pool__slot_index(pool, slot);
-    POOL_ASSERT(!pool__bitmap_get(pool, index) && "Allocating already-allocated slot");
-    pool__bitmap_set(pool, index);
-
-    pool->total_allocs++;
-    size_t used = pool->slot_count - pool->free_count;
-    if (used > pool->peak_used) pool->peak_used = used;
+        size_t index;
+        uint8_t *bitmap = pool__debug_bitmap(pool, ptrs[j], &index);
+        pool__bitmap_set(bitmap, index);
 #endif
+        if (pool->occupancy) pool__occupancy_set(pool, ptrs[j], 1);
+    }
+}
 
-#ifdef POOL_ZERO_ON_ALLOC
-    POOL_MEMSET(slot, 0, pool->slot_size);
-#endif
+#ifndef POOL_CONCURRENT
+// the stack engine keeps no per slot state, so a slot listed twice in one
+// batch is found by sorting the batch's indices. they go in the unused part
+// of the stack above the top, which the push overwrites anyway, the caller
+// makes sure free_top + n fits.
+static int pool__stack_batch_unique(pool_t *pool, void **ptrs, size_t n) {
+    uint32_t *scratch = pool->free_stack + pool->free_top;
+    for (size_t i = 0; i < n; i++) {
+        scratch[i] = (uint32_t)pool__slot_index(pool, ptrs[i]);
+    }
+    pool__sort_indices(scratch, n);
 
-    return slot;
+    for (size_t i = 1; i < n; i++) {
+        if (scratch[i] == scratch[i - 1]) return 0;
+    }
+    return 1;
 }
 
-POOL_API int pool_free(pool_t *pool, void *ptr) {
+// keeps the first copy of each pointer, only run once a batch is known to repeat one.
+static size_t pool__drop_repeats(void **ptrs, size_t n) {
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = 0;
+        while (j < kept && ptrs[j] != ptrs[i]) j++;
+        if (j == kept) ptrs[kept++] = ptrs[i];
+    }
+    return kept;
+}
+#endif
+
+POOL_API int pool_free_bulk(pool_t *pool, void **ptrs, size_t n) {
     if (pool == NULL) return POOL_ERR_NULL_POOL;
-    if (ptr == NULL) return POOL_ERR_NULL_PTR;
+    if (n == 0) return POOL_OK;
+    if (ptrs == NULL) return POOL_ERR_NULL_PTR;
 
-    if (!pool_owns(pool, ptr)) {
+    // validate the whole batch before touching anything. live bits are
+    // cleared as we go so a pointer listed twice is caught, undo on failure
+    for (size_t i = 0; i < n; i++) {
+        int err = pool__check_free(pool, ptrs[i]);
+#ifndef POOL_CONCURRENT
+        // the stack has room for fresh - free_top more, counting the pending pushes
+        if (err == POOL_OK && pool->free_stack && pool->free_top + i >= pool->fresh) {
+            err = POOL_ERR_DOUBLE_FREE;
+        }
+#endif
+        if (err == POOL_OK) {
 #ifdef POOL_DEBUG
-        POOL_DBG_PRINTF("POOL: Invalid free - pointer %p not owned by pool\n", ptr);
-        POOL_ASSERT(0 && "Freeing pointer not owned by pool");
+            size_t index;
+            uint8_t *bitmap = pool__debug_bitmap(pool, ptrs[i], &index);
+            pool__bitmap_clear(bitmap, index);
 #endif
-        return POOL_ERR_INVALID_PTR;
+            if (pool->occupancy) pool__occupancy_set(pool, ptrs[i], 0);
+            continue;
+        }
+        pool__undo_batch(pool, ptrs, i);
+        return err;
     }
 
-#ifdef POOL_DEBUG
-    size_t index = pool__slot_index(pool, ptr);
-
-    // check double free via bitmap
-    if (!pool__bitmap_get(pool, index)) {
-        POOL_DBG_PRINTF("POOL: Double free detected at slot %zu (ptr=%p)\n", index, ptr);
-        POOL_ASSERT(0 && "Double free detected");
+#ifndef POOL_CONCURRENT
+    if (pool->free_stack && !pool->occupancy && !pool__stack_batch_unique(pool, ptrs, n)) {
+        pool__undo_batch(pool, ptrs, n);
         return POOL_ERR_DOUBLE_FREE;
     }
+#endif
 
-    // check double free via magic
-    if (pool->slot_size >= sizeof(void *) + sizeof(uintptr_t)) {
-        if (pool__has_free_magic((uint8_t *)ptr + sizeof(void *))) {
-            POOL_DBG_PRINTF("POOL: Double free detected via magic at slot %zu\n", index);
-            POOL_ASSERT(0 && "Double free detected via magic number");
-            return POOL_ERR_DOUBLE_FREE;
-        }
+    for (size_t i = 0; i < n; i++) {
+        pool__retire_slot(pool, ptrs[i]);
     }
+    pool__splice(pool, ptrs, n);
 
-    pool__bitmap_clear(pool, index);
-    pool->total_frees++;
-#endif
+    return POOL_OK;
+}
 
-#ifdef POOL_ZERO_ON_FREE
-    POOL_MEMSET(ptr, 0, pool->slot_size);
-#endif
+POOL_API size_t pool_free_bulk_partial(pool_t *pool, void **ptrs, size_t n) {
+    if (pool == NULL || ptrs == NULL) return 0;
 
-    // push to free list
-    void **next_ptr = (void **)ptr;
-    *next_ptr = pool->free_list;
-    pool->free_list = ptr;
-    pool->free_count++;
+    // compact the valid pointers to the front of the array, then splice them
+    size_t valid = 0;
+    for (size_t i = 0; i < n; i++) {
+        void *ptr = ptrs[i];
+        if (pool__check_free(pool, ptr) != POOL_OK) continue;
 
-#ifdef POOL_DEBUG
-    if (pool->slot_size >= sizeof(void *) + sizeof(uintptr_t)) {
-#ifndef POOL_ZERO_ON_FREE
-        pool__write_free_magic((uint8_t *)ptr + sizeof(void *));
-        pool__poison_slot(pool, ptr);
-#endif
+        // the splice clears it again, this only catches a pointer listed twice
+        if (pool->occupancy) pool__occupancy_set(pool, ptr, 0);
+        pool__retire_slot(pool, ptr);
+        ptrs[valid++] = ptr;
+    }
+
+#ifndef POOL_CONCURRENT
+    if (pool->free_stack && !pool->occupancy) {
+        // drop the repeats first, then whatever the stack has no room for
+        size_t room = pool->fresh - pool->free_top;
+        if (valid > room || !pool__stack_batch_unique(pool, ptrs, valid)) {
+            valid = pool__drop_repeats(ptrs, valid);
+        }
+        if (valid > room) valid = room;
     }
 #endif
+    pool__splice(pool, ptrs, valid);
 
-    return POOL_OK;
+    return valid;
 }
 
 POOL_API void pool_reset(pool_t *pool) {
     if (pool == NULL) return;
 
+    // cached slots were never zeroed on free, this clears them after the dtor
+    if (pool->cached) pool__destruct_all(pool);
+
+#ifdef POOL_REMOTE_FREE
+    pool->remote_head = NULL;
+#endif
+
+#ifdef POOL_DEFERRED_ZERO
+    // every dirty slot sits below the fresh cursor, the zeroing below covers it
+    pool->dirty_list = NULL;
+    pool->dirty_tail = NULL;
+    pool->dirty_count = 0;
+#endif
+
+    // only slots below the fresh cursor were ever handed out, the rest is
+    // still untouched (and possibly unfaulted) memory
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) {
+#ifdef POOL_ZERO_ON_FREE
+        for (pool_chunk_t *c = pool->chunks; c; c = c->next) {
+            if (c == pool->bump_chunk) {
+                POOL_MEMSET(c->slots, 0, pool->fresh * pool->slot_size);
+                break;
+            }
+            POOL_MEMSET(c->slots, 0, c->slot_count * pool->slot_size);
+        }
+#endif
+#ifdef POOL_DEBUG
+        for (pool_chunk_t *c = pool->chunks; c; c = c->next) {
+            POOL_MEMSET(c->alloc_bitmap, 0, (size_t)(c->slots - c->alloc_bitmap));
+        }
+#endif
+    } else
+#endif
+    {
 #ifdef POOL_ZERO_ON_FREE
-    size_t total_size = pool->slot_count * pool->slot_size;
-    POOL_MEMSET(pool->buffer, 0, total_size);
+        if (pool->engine == POOL_ENGINE_BITMAP) {
+            // free slots were zeroed when freed, clear the live ones
+            for (size_t w = 0; w < pool->occupancy_words; w++) {
+                uint64_t bits = pool__occupancy_word(pool, w);
+                while (bits != 0) {
+                    size_t index = w * 64 + pool__ctz64(bits);
+                    POOL_MEMSET(pool->buffer + index * pool->slot_size, 0, pool->slot_size);
+                    bits &= bits - 1;
+                }
+            }
+        } else {
+            size_t used = pool->fresh < pool->slot_count ? pool->fresh : pool->slot_count;
+#ifdef POOL_DEFERRED_ZERO
+            // left for pool_scrub, or zeroed one by one as the fresh cursor passes
+            if (pool__defers_zero(pool)) {
+                if (used > pool->dirty_fresh) pool->dirty_fresh = used;
+                used = 0;
+            }
+#endif
+            POOL_MEMSET(pool->buffer, 0, used * pool->slot_size);
+        }
+#endif
+#ifdef POOL_DEBUG
+        POOL_MEMSET(pool->alloc_bitmap, 0, pool->bitmap_size);
 #endif
+    }
 
 #ifdef POOL_DEBUG
-    POOL_MEMSET(pool->alloc_bitmap, 0, pool->bitmap_size);
     pool->total_allocs = 0;
     pool->total_frees = 0;
     pool->peak_used = 0;
 #endif
 
-    pool__build_free_list(pool);
+    // every outstanding handle goes stale, free slots included is cheaper than finding the live ones
+    if (pool->generations) {
+        for (size_t i = 0; i < pool->slot_count; i++) {
+            pool__bump_generation(pool, i);
+        }
+    }
+
+    pool__reset_free_list(pool);
 }
 
 POOL_API int pool_is_full(const pool_t *pool) {
     if (pool == NULL) return 1;
-    return pool->free_count == 0;
+    return pool__free_count(pool) == 0;
 }
 
 POOL_API int pool_is_empty(const pool_t *pool) {
     if (pool == NULL) return 1;
-    return pool->free_count == pool->slot_count;
+    return pool__free_count(pool) == pool->slot_count;
 }
 
 POOL_API size_t pool_slot_size(const pool_t *pool) {
@@ -545,12 +3552,12 @@ POOL_API size_t pool_capacity(const pool_t *pool) {
 
 POOL_API size_t pool_available(const pool_t *pool) {
     if (pool == NULL) return 0;
-    return pool->free_count;
+    return pool__free_count(pool);
 }
 
 POOL_API size_t pool_used(const pool_t *pool) {
     if (pool == NULL) return 0;
-    return pool->slot_count - pool->free_count;
+    return pool->slot_count - pool__free_count(pool);
 }
 
 POOL_API int pool_owns(const pool_t *pool, const void *ptr) {
@@ -558,13 +3565,20 @@ POOL_API int pool_owns(const pool_t *pool, const void *ptr) {
 
     const uint8_t *p = (const uint8_t *)ptr;
 
-    if (p < pool->buffer || p >= pool->buffer_end) return 0;
+#ifdef POOL_DYNAMIC
+    if (pool->dynamic) {
+        // a non-owned address may not be readable, so the table is checked before the header
+        uintptr_t base = (uintptr_t)pool__chunk_of(pool, ptr);
+        if (!pool__chunk_table_contains(pool, base)) return 0;
 
-    // check alignment offset from start
-    size_t offset = (size_t)(p - pool->buffer);
-    if (offset % pool->slot_size != 0) return 0;
+        const pool_chunk_t *chunk = (const pool_chunk_t *)base;
+        if (p < chunk->slots || p >= chunk->slots_end) return 0;
+        return pool__div_slot(pool, (size_t)(p - chunk->slots)) < chunk->slot_count;
+    }
+#endif
 
-    return 1;
+    // one unsigned compare also rejects pointers below the buffer
+    return pool__div_slot(pool, (size_t)((uintptr_t)p - (uintptr_t)pool->buffer)) < pool->slot_count;
 }
 
 POOL_API void pool_stats(const pool_t *pool, pool_stats_t *stats) {
@@ -575,8 +3589,12 @@ POOL_API void pool_stats(const pool_t *pool, pool_stats_t *stats) {
 
     stats->slot_size = pool->slot_size;
     stats->slot_count = pool->slot_count;
-    stats->free_count = pool->free_count;
-    stats->used_count = pool->slot_count - pool->free_count;
+    stats->free_count = pool__free_count(pool);
+    stats->used_count = pool->slot_count - stats->free_count;
+
+#ifdef POOL_DYNAMIC
+    stats->chunk_count = pool->chunk_count;
+#endif
 
 #ifdef POOL_DEBUG
     stats->total_allocs = pool->total_allocs;
@@ -585,6 +3603,227 @@ POOL_API void pool_stats(const pool_t *pool, pool_stats_t *stats) {
 #endif
 }
 
+POOL_API int pool_foreach_allocated(const pool_t *pool, pool_foreach_fn fn, void *ctx) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (fn == NULL) return POOL_ERR_NULL_PTR;
+    if (pool->occupancy == NULL) return POOL_ERR_UNSUPPORTED;
+
+    for (size_t w = 0; w < pool->occupancy_words; w++) {
+        uint64_t bits = pool__occupancy_word(pool, w);
+        while (bits != 0) {
+            size_t index = w * 64 + pool__ctz64(bits);
+            bits &= bits - 1;
+            if (fn(pool->buffer + index * pool->slot_size, ctx) != 0) return POOL_OK;
+        }
+    }
+
+    return POOL_OK;
+}
+
+POOL_API int pool_iter_init(pool_iter_t *it, const pool_t *pool) {
+    if (it == NULL) return POOL_ERR_NULL_PTR;
+    POOL_MEMSET(it, 0, sizeof(pool_iter_t));
+
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+    if (pool->occupancy == NULL) return POOL_ERR_UNSUPPORTED;
+
+    it->pool = pool;
+    it->bits = pool__occupancy_word(pool, 0);
+    return POOL_OK;
+}
+
+POOL_API void *pool_iter_next(pool_iter_t *it) {
+    if (it == NULL || it->pool == NULL) return NULL;
+
+    const pool_t *pool = it->pool;
+    while (it->bits == 0) {
+        if (++it->word >= pool->occupancy_words) {
+            it->pool = NULL;
+            return NULL;
+        }
+        it->bits = pool__occupancy_word(pool, it->word);
+    }
+
+    size_t index = it->word * 64 + pool__ctz64(it->bits);
+    it->bits &= it->bits - 1;
+    return pool->buffer + index * pool->slot_size;
+}
+
+POOL_API pool_handle_t pool_alloc_handle(pool_t *pool) {
+    if (pool == NULL || pool->generations == NULL) return POOL_HANDLE_NULL;
+
+    void *slot = pool_alloc(pool);
+    if (slot == NULL) return POOL_HANDLE_NULL;
+
+    return pool__make_handle(pool, pool__handle_entry(pool, pool__slot_index(pool, slot)));
+}
+
+POOL_API void *pool_resolve(const pool_t *pool, pool_handle_t handle) {
+    if (pool == NULL || pool->generations == NULL) return NULL;
+
+    size_t entry = handle & (((pool_handle_t)1 << POOL_HANDLE_INDEX_BITS) - 1);
+    if (entry >= pool->slot_count) return NULL;
+
+    // a free bumps the generation, so stale handles fail this one compare
+    if (pool__make_handle(pool, entry) != handle) return NULL;
+
+    return pool->buffer + pool__handle_target(pool, entry) * pool->slot_size;
+}
+
+POOL_API int pool_free_handle(pool_t *pool, pool_handle_t handle) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+
+    void *slot = pool_resolve(pool, handle);
+    if (slot == NULL) return POOL_ERR_STALE_HANDLE;
+
+    return pool_free(pool, slot);
+}
+
+POOL_API pool_handle_t pool_handle_of(const pool_t *pool, const void *ptr) {
+    if (pool == NULL || pool->generations == NULL) return POOL_HANDLE_NULL;
+    if (!pool_owns(pool, ptr)) return POOL_HANDLE_NULL;
+
+    return pool__make_handle(pool, pool__handle_entry(pool, pool__slot_index(pool, ptr)));
+}
+
+POOL_API int pool_sort_free_list(pool_t *pool) {
+    if (pool == NULL) return POOL_ERR_NULL_POOL;
+
+#ifdef POOL_CONCURRENT
+    return POOL_ERR_UNSUPPORTED;
+#else
+    // the bitmap index already hands out the lowest free slot
+    if (pool->engine == POOL_ENGINE_BITMAP) return POOL_OK;
+
+#ifdef POOL_DEFERRED_ZERO
+    // a housekeeping call like pool_scrub, the occupancy relink below would
+    // otherwise list the dirty slots a second time
+    pool_scrub(pool, 0);
+#endif
+
+    if (pool->pages) {
+        for (size_t i = 0; i < pool->page_count; i++) {
+            if (pool->pages[i].free > 1) pool->pages[i].head = pool__sort_list(pool->pages[i].head);
+        }
+        return POOL_OK;
+    }
+
+    if (pool->free_stack) {
+        if (pool->occupancy == NULL) {
+            pool__sort_indices(pool->free_stack, pool->free_top);
+            return POOL_OK;
+        }
+
+        // every clear bit below the fresh cursor is on the stack, refill it top down
+        size_t top = pool->free_top;
+        size_t words = (pool->fresh + 63) / 64;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t free_bits = ~pool->occupancy[w];
+            if (w == words - 1 && (pool->fresh & 63) != 0) {
+                free_bits &= ((uint64_t)1 << (pool->fresh & 63)) - 1;
+            }
+            while (free_bits != 0) {
+                pool->free_stack[--top] = (uint32_t)(w * 64 + pool__ctz64(free_bits));
+                free_bits &= free_bits - 1;
+            }
+        }
+        return POOL_OK;
+    }
+
+    if (pool->occupancy) {
+        // every clear bit below the fresh cursor is a listed slot, relink them in order
+        void *head = NULL;
+        void *tail = NULL;
+        size_t words = (pool->fresh + 63) / 64;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t free_bits = ~pool->occupancy[w];
+            if (w == words - 1 && (pool->fresh & 63) != 0) {
+                free_bits &= ((uint64_t)1 << (pool->fresh & 63)) - 1;
+            }
+            while (free_bits != 0) {
+                void *slot = pool->buffer + (w * 64 + pool__ctz64(free_bits)) * pool->slot_size;
+                free_bits &= free_bits - 1;
+                if (tail != NULL) {
+                    pool__link_store(tail, slot);
+                } else {
+                    head = slot;
+                }
+                tail = slot;
+            }
+        }
+        if (tail != NULL) pool__link_store(tail, NULL);
+        pool->free_list = head;
+        return POOL_OK;
+    }
+
+    pool->free_list = pool__sort_list(pool->free_list);
+    return POOL_OK;
+#endif
+}
+
+POOL_API size_t pool_compact(pool_t *pool, size_t budget) {
+    if (pool == NULL || pool->handle_slot == NULL) return 0;
+
+#ifdef POOL_CONCURRENT
+    (void)budget;
+    return 0;
+#else
+    size_t moved = 0;
+    size_t w = pool->occupancy_words;
+    uint64_t live = 0;
+
+    for (;;) {
+        // highest live slot, walking down from the top word
+        while (live == 0 && w > 0) {
+            live = pool__occupancy_word(pool, --w);
+        }
+        if (live == 0) break;
+        size_t high = w * 64 + pool__msb64(live);
+
+        size_t low = pool__bitmap_lowest_free(pool);
+        if (low > high) break;
+        if (budget != 0 && moved == budget) return moved;
+
+        uint8_t *from = pool->buffer + high * pool->slot_size;
+        uint8_t *to = pool->buffer + low * pool->slot_size;
+        POOL_MEMCPY(to, from, pool->slot_size);
+
+        // swap the handle entries, the live one now points at the low slot
+        size_t live_entry = pool__handle_entry(pool, high);
+        size_t free_entry = pool__handle_entry(pool, low);
+        pool->handle_slot[live_entry] = (uint32_t)(low ^ live_entry);
+        pool->handle_slot[free_entry] = (uint32_t)(high ^ free_entry);
+        pool->slot_handle[low] = (uint32_t)(live_entry ^ low);
+        pool->slot_handle[high] = (uint32_t)(free_entry ^ high);
+
+        pool__bitmap_mark(pool, low);
+        pool__bitmap_unmark(pool, high);
+        // reread, low may sit in the same word below high
+        live = pool__occupancy_word(pool, w) & (((uint64_t)1 << (high & 63)) - 1);
+
+#ifdef POOL_DEBUG
+        pool__bitmap_set(pool->alloc_bitmap, low);
+        pool__bitmap_clear(pool->alloc_bitmap, high);
+#endif
+#if defined(POOL_ZERO_ON_FREE)
+        POOL_MEMSET(from, 0, pool->slot_size);
+#elif defined(POOL_DEBUG)
+        POOL_MEMSET(from, POOL_POISON_BYTE, pool->slot_size);
+#endif
+        moved++;
+    }
+
+    // compact now, everything past the last live slot can go back to the os
+    size_t end = live != 0 ? w * 64 + pool__msb64(live) + 1 : 0;
+    if (end < pool->released_from) {
+        pool__release_pages(pool->buffer + end * pool->slot_size, pool->buffer_end);
+        pool->released_from = end;
+    }
+
+    return moved;
+#endif
+}
+
 POOL_API const char *pool_error_string(int error) {
     switch ((pool_error_t)error) {
         case POOL_OK:                   return "Success";
@@ -592,40 +3831,49 @@ POOL_API const char *pool_error_string(int error) {
         case POOL_ERR_NULL_BUFFER:      return "Buffer pointer is NULL";
         case POOL_ERR_BUFFER_TOO_SMALL: return "Buffer too small for even one slot";
         case POOL_ERR_INVALID_SLOT_SIZE:return "Slot size is invalid (zero)";
-        case POOL_ERR_INVALID_ALIGNMENT:return "POOL_ALIGN is not a power of two";
+        case POOL_ERR_INVALID_ALIGNMENT:return "Alignment is not a power of two";
         case POOL_ERR_NULL_PTR:         return "Pointer argument is NULL";
         case POOL_ERR_INVALID_PTR:      return "Pointer not owned by pool";
         case POOL_ERR_DOUBLE_FREE:      return "Double free detected";
+        case POOL_ERR_OUT_OF_MEMORY:    return "Backing allocator is out of memory";
+        case POOL_ERR_INVALID_CONFIG:   return "Invalid pool configuration";
+        case POOL_ERR_UNSUPPORTED:      return "Not supported by this pool or build";
+        case POOL_ERR_STALE_HANDLE:     return "Handle is stale or invalid";
         case POOL_ERR_COUNT:            break;
     }
     return "Unknown error";
 }
 
 POOL_API size_t pool_required_size(size_t slot_size, size_t slot_count) {
-    if (slot_size == 0 || slot_count == 0) return 0;
+    return pool_required_size_ex(slot_size, slot_count, NULL);
+}
 
-    size_t effective = slot_size;
-    if (effective < sizeof(void *)) effective = sizeof(void *);
-    effective = pool__align_up(effective, POOL_ALIGN);
+POOL_API size_t pool_required_size_ex(size_t slot_size, size_t slot_count, const pool_config_t *config) {
+    if (slot_size == 0 || slot_count == 0) return 0;
 
-#ifdef POOL_DEBUG
-    size_t min_debug_size = sizeof(void *) + sizeof(uintptr_t);
-    if (effective < min_debug_size) {
-        effective = pool__align_up(min_debug_size, POOL_ALIGN);
+    pool_config_t defaults;
+    if (config == NULL) {
+        pool__default_config(&defaults, slot_size);
+        config = &defaults;
     }
-    size_t bitmap = pool__align_up((slot_count + 7) / 8, POOL_ALIGN);
-#else
-    size_t bitmap = 0;
-#endif
+    if (pool__check_config(config) != POOL_OK) return 0;
+
+    unsigned flags = pool__config_flags(config);
+    if ((flags & POOL_FLAG_HANDLES) && slot_count > pool__handle_max_slots()) return 0;
 
-    return slot_count * effective + bitmap + POOL_ALIGN - 1;
+    int engine = pool__index_engine(config);
+    size_t effective = pool__effective_slot_size(slot_size, (int)config->engine, config->alignment);
+    size_t align = config->alignment ? config->alignment : (size_t)POOL_ALIGN;
+
+    return slot_count * effective + pool__side_size(slot_count, effective, engine, flags, (int)config->reuse) +
+           align - 1;
 }
 
 #ifdef POOL_DEBUG
 
 POOL_API void *pool_alloc_debug(pool_t *pool, const char *file, int line) {
     void *ptr = pool_alloc(pool);
-    if (ptr == NULL && pool != NULL && pool->free_count == 0) {
+    if (ptr == NULL && pool != NULL && pool__free_count(pool) == 0) {
         POOL_DBG_PRINTF("POOL: Allocation failed (pool exhausted) at %s:%d\n", file, line);
     }
     (void)file; (void)line;
@@ -646,10 +3894,203 @@ POOL_API int pool_is_allocated(const pool_t *pool, const void *ptr) {
     if (pool == NULL || ptr == NULL) return 0;
     if (!pool_owns(pool, ptr)) return 0;
 
-    size_t index = pool__slot_index(pool, ptr);
-    return pool__bitmap_get(pool, index);
+    size_t index;
+    const uint8_t *bitmap = pool__debug_bitmap(pool, ptr, &index);
+    return pool__bitmap_get(bitmap, index);
 }
 
 #endif // POOL_DEBUG
 
-#endif // POOL_IMPLEMENTATION
\ No newline at end of file
+#ifdef POOL_MAGAZINES
+
+struct pool_magazine {
+    pool_magazine_t *next;
+    size_t           count;
+    void            *rounds[1];     // magazine_size entries
+};
+
+// caller holds the depot lock for both helpers below.
+static pool_magazine_t *pool__depot_get_empty(pool_depot_t *depot) {
+    pool_magazine_t *mag = depot->empty;
+    if (mag) {
+        depot->empty = mag->next;
+        depot->empty_count--;
+        return mag;
+    }
+
+    mag = (pool_magazine_t *)POOL_SYS_MALLOC(sizeof(pool_magazine_t) +
+                                             (depot->magazine_size - 1) * sizeof(void *));
+    if (mag) mag->count = 0;
+    return mag;
+}
+
+static void pool__depot_put(pool_depot_t *depot, pool_magazine_t *mag) {
+    if (mag->count == depot->magazine_size) {
+        mag->next = depot->full;
+        depot->full = mag;
+        depot->full_count++;
+    } else {
+        // partial magazines never enter the depot, their rounds go back to the pool
+        while (mag->count > 0) {
+            pool_free(depot->pool, mag->rounds[--mag->count]);
+        }
+        mag->next = depot->empty;
+        depot->empty = mag;
+        depot->empty_count++;
+    }
+}
+
+POOL_API int pool_depot_init(pool_depot_t *depot, pool_t *pool, size_t magazine_size) {
+    if (depot == NULL || pool == NULL) return POOL_ERR_NULL_POOL;
+
+    POOL_MEMSET(depot, 0, sizeof(pool_depot_t));
+    depot->pool = pool;
+    depot->magazine_size = magazine_size ? magazine_size : (size_t)POOL_MAGAZINE_SIZE;
+    return POOL_OK;
+}
+
+POOL_API void pool_depot_destroy(pool_depot_t *depot) {
+    if (depot == NULL) return;
+
+    pool_magazine_t *mag = depot->full;
+    while (mag) {
+        pool_magazine_t *next = mag->next;
+        while (mag->count > 0) {
+            pool_free(depot->pool, mag->rounds[--mag->count]);
+        }
+        POOL_SYS_FREE(mag);
+        mag = next;
+    }
+
+    mag = depot->empty;
+    while (mag) {
+        pool_magazine_t *next = mag->next;
+        POOL_SYS_FREE(mag);
+        mag = next;
+    }
+
+    POOL_MEMSET(depot, 0, sizeof(pool_depot_t));
+}
+
+POOL_API void pool_cache_init(pool_cache_t *cache, pool_depot_t *depot) {
+    if (cache == NULL) return;
+    cache->depot = depot;
+    cache->loaded = NULL;
+    cache->previous = NULL;
+}
+
+POOL_API void *pool_cache_alloc(pool_cache_t *cache) {
+    if (cache == NULL || cache->depot == NULL) return NULL;
+
+    pool_magazine_t *loaded = cache->loaded;
+    if (loaded && loaded->count > 0) {
+        return loaded->rounds[--loaded->count];
+    }
+
+    pool_magazine_t *previous = cache->previous;
+    if (previous && previous->count > 0) {
+        cache->loaded = previous;
+        cache->previous = loaded;
+        return previous->rounds[--previous->count];
+    }
+
+    // both magazines are empty, trade one for a full magazine from the depot
+    pool_depot_t *depot = cache->depot;
+    void *slot = NULL;
+
+    POOL__LOCK(&depot->lock);
+    if (depot->full) {
+        pool_magazine_t *full = depot->full;
+        depot->full = full->next;
+        depot->full_count--;
+
+        if (previous) pool__depot_put(depot, previous);
+        cache->previous = loaded;
+        cache->loaded = full;
+        slot = full->rounds[--full->count];
+    } else {
+        // no full magazines, refill half of the loaded one straight from the pool
+        // so the next few frees do not have to come back here
+        if (loaded == NULL) loaded = cache->loaded = pool__depot_get_empty(depot);
+
+        if (loaded) {
+            size_t want = (depot->magazine_size + 1) / 2;
+            while (loaded->count < want) {
+                void *p = pool_alloc(depot->pool);
+                if (p == NULL) break;
+                loaded->rounds[loaded->count++] = p;
+            }
+            if (loaded->count > 0) slot = loaded->rounds[--loaded->count];
+        } else {
+            slot = pool_alloc(depot->pool);
+        }
+    }
+    POOL__UNLOCK(&depot->lock);
+
+    return slot;
+}
+
+POOL_API int pool_cache_free(pool_cache_t *cache, void *ptr) {
+    if (cache == NULL || cache->depot == NULL) return POOL_ERR_NULL_POOL;
+    if (ptr == NULL) return POOL_ERR_NULL_PTR;
+
+    pool_depot_t *depot = cache->depot;
+
+#ifdef POOL_DYNAMIC
+    // the chunk table of a growing pool can be rehashed under the depot lock,
+    // so dynamic pools validate when the round goes back to the pool instead
+    if (!depot->pool->dynamic && !pool_owns(depot->pool, ptr)) return POOL_ERR_INVALID_PTR;
+#else
+    if (!pool_owns(depot->pool, ptr)) return POOL_ERR_INVALID_PTR;
+#endif
+
+    pool_magazine_t *loaded = cache->loaded;
+    if (loaded && loaded->count < depot->magazine_size) {
+        loaded->rounds[loaded->count++] = ptr;
+        return POOL_OK;
+    }
+
+    pool_magazine_t *previous = cache->previous;
+    if (previous && previous->count == 0) {
+        cache->loaded = previous;
+        cache->previous = loaded;
+        previous->rounds[previous->count++] = ptr;
+        return POOL_OK;
+    }
+
+    // both magazines are full (or missing), hand one full magazine to the depot
+    int result = POOL_OK;
+
+    POOL__LOCK(&depot->lock);
+    pool_magazine_t *empty = pool__depot_get_empty(depot);
+    if (empty) {
+        if (previous) pool__depot_put(depot, previous);
+        cache->previous = loaded;
+        cache->loaded = empty;
+        empty->rounds[empty->count++] = ptr;
+    } else {
+        result = pool_free(depot->pool, ptr);
+    }
+    POOL__UNLOCK(&depot->lock);
+
+    return result;
+}
+
+POOL_API void pool_cache_flush(pool_cache_t *cache) {
+    if (cache == NULL || cache->depot == NULL) return;
+
+    pool_depot_t *depot = cache->depot;
+
+    POOL__LOCK(&depot->lock);
+    if (cache->loaded) pool__depot_put(depot, cache->loaded);
+    if (cache->previous) pool__depot_put(depot, cache->previous);
+    POOL__UNLOCK(&depot->lock);
+
+    cache->loaded = NULL;
+    cache->previous = NULL;
+}
+
+#endif // POOL_MAGAZINES
+
+
+#endif // POOL_IMPLEMENTATION
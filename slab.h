@@ -31,9 +31,10 @@
  *   SLAB_IMPLEMENTATION   - Include implementation (define in ONE file)
  *   SLAB_STATIC           - Make all functions static
  *   SLAB_DEBUG            - Enable debug features (poison, leak detection)
+ *   SLAB_HARDENED         - Mangle and check free list links (cheap, for release builds)
  *   SLAB_ASSERT(x)        - Custom assert (default: assert(x))
  *   SLAB_MAX_CLASSES      - Maximum size classes (default: 16)
- *   SLAB_ALIGNMENT        - Minimum alignment (default: 8)
+ *   SLAB_ALIGNMENT        - Minimum alignment of slots over 4 bytes (default: 8)
  *   SLAB_MEMSET           - Custom memset (default: memset)
  *   SLAB_POISON_BYTE      - Byte used to poison freed slots (default: 0xFE)
  *
@@ -56,6 +57,20 @@
  *     - Peak usage and lifetime counters are tracked
  *     - Has performance cost (memset on every free) , use only for debugging
  *
+ *   Tiny Slots:
+ *     Classes of 1 to 4 bytes get 2 or 4 byte slots instead of a pointer
+ *     each. their free list links are the next slot index + 1, 16-bit in a
+ *     2 byte slot and 32-bit in a 4 byte slot, aligned to the slot size. a
+ *     2 byte class only reaches 65534 slots, a bigger region gets 4 byte
+ *     slots. 1 byte requests share the 2 byte slot size.
+ *
+ *   Hardened Mode (SLAB_HARDENED):
+ *     - Same link mangling and double free checks as POOL_HARDENED, see
+ *       HARDENING in pool.h, applied per size class
+ *     - A broken link fires SLAB_ASSERT and the class returns NULL from then
+ *       on instead of handing out wild memory
+ *     - The free key is only kept without SLAB_DEBUG
+ *
  */
 
 /*
@@ -130,6 +145,8 @@ typedef struct slab_class {
     uint8_t *region_end;
     size_t   slot_count;
     size_t   free_count;
+    size_t   slot_shift;    // slot_size = odd << slot_shift
+    size_t   slot_inverse;  // odd * slot_inverse == 1 mod 2^N
 #ifdef SLAB_DEBUG
     size_t   peak_used;
     size_t   alloc_count;
@@ -145,6 +162,9 @@ typedef struct slab {
     slab_class_t  classes[SLAB_MAX_CLASSES];
     size_t        class_count;
     int           initialized;
+#ifdef SLAB_HARDENED
+    uintptr_t     free_key;     // second word of a free slot, marks it as already freed
+#endif
 } slab_t;
 
 // initializes slab. buffer is divided equally among size classes.
@@ -206,13 +226,81 @@ SLAB_API size_t slab_buffer_size_needed(const size_t sizes[], size_t count, size
 #define SLAB_MIN(a, b) ((a) < (b) ? (a) : (b))
 #define SLAB_MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#define SLAB_MIN_SLOT_SIZE SLAB_MAX(sizeof(void*), SLAB_ALIGNMENT)
+// slots below a pointer link by 16 or 32-bit slot index, never below 2 bytes.
+#define SLAB_MIN_SLOT_SIZE 2
+#define SLAB_PTR_SLOT_SIZE SLAB_MAX(sizeof(void*), SLAB_ALIGNMENT)
+#define SLAB__MAX_LINK16 0xFFFEu
 #define SLAB_MAGIC 0x534C4142
 
 typedef struct slab_free_node {
     struct slab_free_node *next;
 } slab_free_node_t;
 
+#ifdef SLAB_HARDENED
+// same link key as POOL__LINK_KEY in pool.h
+#define SLAB__LINK_KEY(node) ((uintptr_t)(node) >> 12)
+#else
+#define SLAB__LINK_KEY(node) ((uintptr_t)0)
+#endif
+
+#if defined(SLAB_HARDENED) && !defined(SLAB_DEBUG)
+#define SLAB__FREE_KEY
+#endif
+
+// exact slot index of a slot start, no division.
+static size_t slab__slot_index(const slab_class_t *cls, const void *ptr) {
+    size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)cls->region_start);
+    return (offset >> cls->slot_shift) * cls->slot_inverse;
+}
+
+static void slab__link_store(const slab_class_t *cls, slab_free_node_t *node, slab_free_node_t *next) {
+    uint32_t link;
+
+    if (cls->slot_size >= sizeof(void *)) {
+        node->next = (slab_free_node_t *)((uintptr_t)next ^ SLAB__LINK_KEY(node));
+        return;
+    }
+
+    // tiny slots hold the next slot index + 1, 0 ends the list
+    link = next == NULL ? 0 : (uint32_t)slab__slot_index(cls, next) + 1;
+    link ^= (uint32_t)SLAB__LINK_KEY(node);
+    if (cls->slot_size >= sizeof(uint32_t)) {
+        *(uint32_t *)node = link;
+    } else {
+        *(uint16_t *)node = (uint16_t)link;
+    }
+}
+
+static slab_free_node_t *slab__link_load(const slab_class_t *cls, const slab_free_node_t *node) {
+    uint32_t link;
+
+    if (cls->slot_size >= sizeof(void *)) {
+        return (slab_free_node_t *)((uintptr_t)node->next ^ SLAB__LINK_KEY(node));
+    }
+
+    if (cls->slot_size >= sizeof(uint32_t)) {
+        link = *(const uint32_t *)node ^ (uint32_t)SLAB__LINK_KEY(node);
+    } else {
+        link = (uint16_t)(*(const uint16_t *)node ^ (uint16_t)SLAB__LINK_KEY(node));
+    }
+    if (link == 0) return NULL;
+
+    // a corrupt index lands outside the class, where validation catches it
+    return (slab_free_node_t *)((uintptr_t)cls->region_start + (uintptr_t)(link - 1) * cls->slot_size);
+}
+
+// slot size for a requested class size. links need 2 bytes, classes of pointer size
+// and up keep SLAB_ALIGNMENT.
+static size_t slab__class_slot_size(size_t size, size_t region_size) {
+    if (size > sizeof(uint32_t)) {
+        return SLAB_MAX(SLAB_ALIGN_UP(size, SLAB_ALIGNMENT), SLAB_PTR_SLOT_SIZE);
+    }
+    if (size <= sizeof(uint16_t) && region_size / sizeof(uint16_t) <= SLAB__MAX_LINK16) {
+        return sizeof(uint16_t);
+    }
+    return sizeof(uint32_t);
+}
+
 static void slab__sort_sizes(size_t *arr, size_t count) {
     size_t i, j, key;
     for (i = 1; i < count; i++) {
@@ -249,23 +337,77 @@ static size_t slab__find_class_for_ptr(const slab_t *slab, const void *ptr) {
     return (size_t)-1;
 }
 
+// precomputes the shift and odd inverse so frees never divide by the slot size.
+static void slab__set_divisor(slab_class_t *cls) {
+    size_t shift = 0;
+    size_t odd, inverse;
+    int i;
+
+    while (((cls->slot_size >> shift) & 1) == 0) shift++;
+
+    // an odd number is its own inverse mod 8, each newton step doubles the good bits
+    odd = cls->slot_size >> shift;
+    inverse = odd;
+    for (i = 0; i < 5; i++) inverse *= 2 - odd * inverse;
+
+    cls->slot_shift = shift;
+    cls->slot_inverse = inverse;
+}
+
 static int slab__validate_ptr_in_class(const slab_class_t *cls, const void *ptr) {
-    const uint8_t *p = (const uint8_t *)ptr;
-    size_t offset;
+    size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)cls->region_start);
 
-    if (p < cls->region_start || p >= cls->region_end) {
+    if (offset & (((size_t)1 << cls->slot_shift) - 1)) {
         return 0;
     }
 
-    offset = (size_t)(p - cls->region_start);
-    if (offset % cls->slot_size != 0) {
-        return 0;
+    // exact division by the odd part, a non-multiple (or a pointer below the
+    // region) comes out larger than any slot index
+    return (offset >> cls->slot_shift) * cls->slot_inverse < cls->slot_count;
+}
+
+#ifdef SLAB_HARDENED
+// same mix as pool__make_free_key in pool.h, kept here so slab.h stands alone.
+static uintptr_t slab__make_free_key(const slab_t *slab) {
+    uint64_t x = (uint64_t)(uintptr_t)slab ^ 0x9E3779B97F4A7C15ull;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return (uintptr_t)x | 1;
+}
+
+// catches a slot that is already on its class free list, o(1) unless the key matches.
+static int slab__is_listed(const slab_t *slab, const slab_class_t *cls, const void *ptr) {
+    if (ptr == cls->free_list) return 1;
+
+#ifdef SLAB__FREE_KEY
+    {
+        const slab_free_node_t *node;
+        size_t steps;
+
+        if (cls->slot_size < 2 * sizeof(void *) || ((const uintptr_t *)ptr)[1] != slab->free_key) return 0;
+
+        // a match alone is not proof, as in pool.h
+        node = (const slab_free_node_t *)cls->free_list;
+        for (steps = cls->free_count; node != NULL && steps > 0; steps--) {
+            if ((const void *)node == ptr) return 1;
+            node = slab__link_load(cls, node);
+            if (node != NULL && !slab__validate_ptr_in_class(cls, node)) break;
+        }
     }
+#endif
+    (void)slab;
+    return 0;
+}
+#endif
 
-    return 1;
+#ifdef SLAB__FREE_KEY
+static void slab__set_free_key(const slab_class_t *cls, void *ptr, uintptr_t key) {
+    if (cls->slot_size >= 2 * sizeof(void *)) ((uintptr_t *)ptr)[1] = key;
 }
+#endif
 
-static void slab__build_free_list(slab_class_t *cls) {
+static void slab__build_free_list(const slab_t *slab, slab_class_t *cls) {
     size_t i;
     slab_free_node_t *prev = NULL;
     uint8_t *slot;
@@ -278,16 +420,20 @@ static void slab__build_free_list(slab_class_t *cls) {
     for (i = cls->slot_count; i > 0; i--) {
         slot = cls->region_start + (i - 1) * cls->slot_size;
         slab_free_node_t *node = (slab_free_node_t *)slot;
-        node->next = prev;
+        slab__link_store(cls, node, prev);
+#ifdef SLAB__FREE_KEY
+        slab__set_free_key(cls, node, slab->free_key);
+#endif
         prev = node;
     }
 
     cls->free_list = prev;
+    (void)slab;
 }
 
 #ifdef SLAB_DEBUG
 static void slab__poison(void *ptr, size_t size) {
-    size_t skip = sizeof(slab_free_node_t);
+    size_t skip = SLAB_MIN(sizeof(slab_free_node_t), size);
     if (size > skip) {
         SLAB_MEMSET((uint8_t *)ptr + skip, SLAB_POISON_BYTE, size - skip);
     }
@@ -346,6 +492,9 @@ SLAB_API int slab_init(slab_t *slab, void *buffer, size_t size, const size_t siz
     slab->aligned_start = slab->buffer + alignment_loss;
     slab->usable_capacity = size - alignment_loss;
     slab->class_count = count;
+#ifdef SLAB_HARDENED
+    slab->free_key = slab__make_free_key(slab);
+#endif
 
     region_size = slab->usable_capacity / count;
     region_size = (region_size / SLAB_ALIGNMENT) * SLAB_ALIGNMENT;
@@ -358,11 +507,16 @@ SLAB_API int slab_init(slab_t *slab, void *buffer, size_t size, const size_t siz
         size_t aligned_slot_size;
         size_t slots;
 
-        aligned_slot_size = SLAB_ALIGN_UP(sorted_sizes[i], SLAB_ALIGNMENT);
-        aligned_slot_size = SLAB_MAX(aligned_slot_size, SLAB_MIN_SLOT_SIZE);
+        aligned_slot_size = slab__class_slot_size(sorted_sizes[i], region_size);
 
         slots = region_size / aligned_slot_size;
 
+        // 32-bit links reach 4 billion slots, past that a tiny class links by pointer
+        if (aligned_slot_size == sizeof(uint32_t) && slots > (size_t)UINT32_MAX - 1) {
+            aligned_slot_size = SLAB_PTR_SLOT_SIZE;
+            slots = region_size / aligned_slot_size;
+        }
+
         if (slots == 0) {
             SLAB_MEMSET(slab, 0, sizeof(*slab));
             return SLAB_ERR_BUFFER_SMALL;
@@ -372,8 +526,9 @@ SLAB_API int slab_init(slab_t *slab, void *buffer, size_t size, const size_t siz
         cls->region_start = region_ptr;
         cls->slot_count = slots;
         cls->region_end = region_ptr + (slots * aligned_slot_size);
+        slab__set_divisor(cls);
 
-        slab__build_free_list(cls);
+        slab__build_free_list(slab, cls);
 
 #ifdef SLAB_DEBUG
         cls->peak_used = 0;
@@ -381,7 +536,7 @@ SLAB_API int slab_init(slab_t *slab, void *buffer, size_t size, const size_t siz
         cls->free_count_total = 0;
 
         SLAB_MEMSET(cls->region_start, SLAB_POISON_BYTE, slots * aligned_slot_size);
-        slab__build_free_list(cls);
+        slab__build_free_list(slab, cls);
 #endif
 
         region_ptr += region_size;
@@ -410,6 +565,7 @@ SLAB_API void *slab_alloc(slab_t *slab, size_t size) {
     size_t class_idx;
     slab_class_t *cls;
     slab_free_node_t *node;
+    slab_free_node_t *next;
     void *ptr;
 
     if (slab == NULL || slab->initialized != SLAB_MAGIC || size == 0) return NULL;
@@ -422,11 +578,25 @@ SLAB_API void *slab_alloc(slab_t *slab, size_t size) {
     if (cls->free_list == NULL) return NULL;
 
     node = (slab_free_node_t *)cls->free_list;
-    cls->free_list = node->next;
+    next = slab__link_load(cls, node);
+
+#ifdef SLAB_HARDENED
+    // a link must be null or a slot of this class, anything else is corruption
+    if (next != NULL && !slab__validate_ptr_in_class(cls, next)) {
+        SLAB_ASSERT(0 && "slab free list corruption detected");
+        return NULL;
+    }
+#endif
+
+    cls->free_list = next;
     cls->free_count--;
 
     ptr = (void *)node;
 
+#ifdef SLAB__FREE_KEY
+    slab__set_free_key(cls, ptr, 0);
+#endif
+
 #ifdef SLAB_DEBUG
     {
         size_t used = cls->slot_count - cls->free_count;
@@ -463,13 +633,23 @@ SLAB_API void slab_free(slab_t *slab, void *ptr) {
         return;
     }
 
+#ifdef SLAB_HARDENED
+    if (slab__is_listed(slab, cls, ptr)) {
+        SLAB_ASSERT(0 && "slab_free called on a slot that is already free");
+        return;
+    }
+#endif
+
 #ifdef SLAB_DEBUG
     slab__poison(ptr, cls->slot_size);
     cls->free_count_total++;
 #endif
 
     node = (slab_free_node_t *)ptr;
-    node->next = (slab_free_node_t *)cls->free_list;
+    slab__link_store(cls, node, (slab_free_node_t *)cls->free_list);
+#ifdef SLAB__FREE_KEY
+    slab__set_free_key(cls, node, slab->free_key);
+#endif
     cls->free_list = node;
     cls->free_count++;
 }
@@ -485,7 +665,7 @@ SLAB_API void slab_reset(slab_t *slab) {
         SLAB_MEMSET(cls->region_start, SLAB_POISON_BYTE, cls->slot_count * cls->slot_size);
 #endif
 
-        slab__build_free_list(cls);
+        slab__build_free_list(slab, cls);
 
 #ifdef SLAB_DEBUG
         cls->peak_used = 0;
@@ -611,8 +791,7 @@ SLAB_API size_t slab_buffer_size_needed(const size_t sizes[], size_t count, size
         size_t aligned_size;
         if (sizes[i] == 0) return 0;
 
-        aligned_size = SLAB_ALIGN_UP(sizes[i], SLAB_ALIGNMENT);
-        aligned_size = SLAB_MAX(aligned_size, SLAB_MIN_SLOT_SIZE);
+        aligned_size = slab__class_slot_size(sizes[i], slots_needed * sizeof(uint16_t));
 
         if (aligned_size > max_aligned_size) max_aligned_size = aligned_size;
     }
@@ -10,6 +10,9 @@
  *   # With block chaining
  *   gcc -Wall -Wextra -DARENA_BLOCK_CHAINING -O2 -o test_arena_chain test_arena.c && ./test_arena_chain
  *
+ *   # With chaining backed by mmap
+ *   gcc -Wall -Wextra -DARENA_BLOCK_CHAINING -DARENA_MMAP -O2 -o test_arena_mmap test_arena.c && ./test_arena_mmap
+ *
  *   # With both debug and chaining
  *   gcc -Wall -Wextra -DARENA_DEBUG -DARENA_BLOCK_CHAINING -O2 -o test_arena_full test_arena.c && ./test_arena_full
  *
@@ -25,6 +28,12 @@
 #include <stdbool.h>
 #include <time.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 static int tests_run = 0;
 static int tests_passed = 0;
@@ -847,8 +856,366 @@ TEST(test_block_chaining_user_buffer_no_grow) {
     arena_destroy(&arena);
 }
 
+TEST(test_block_chaining_reuse_after_reset) {
+    arena_t arena;
+    arena_init_dynamic(&arena, 256);
+
+    for (int i = 0; i < 40; i++) {
+        ASSERT_NOT_NULL(arena_alloc(&arena, 500));
+    }
+    size_t blocks = arena_stats(&arena).block_count;
+    ASSERT(blocks > 1);
+
+    // the same workload after a reset must reuse the chained blocks
+    arena_reset(&arena);
+    for (int i = 0; i < 40; i++) {
+        ASSERT_NOT_NULL(arena_alloc(&arena, 500));
+    }
+    ASSERT_EQ(arena_stats(&arena).block_count, blocks);
+
+    arena_destroy(&arena);
+}
+
+TEST(test_recycler_hit) {
+    arena_recycler_t rec;
+    arena_recycler_init(&rec, 1024 * 1024);
+
+    arena_t *a = arena_acquire(&rec, 1000);
+    ASSERT_NOT_NULL(a);
+    ASSERT(arena_capacity(a) >= 1000);
+    ASSERT_NOT_NULL(arena_alloc(a, 800));
+    arena_release(&rec, a);
+
+    arena_t *b = arena_acquire(&rec, 1000);
+    ASSERT(b == a);
+    ASSERT_EQ(arena_used(b), 0);
+
+    arena_recycler_stats_t stats = arena_recycler_stats(&rec);
+    ASSERT_EQ(stats.acquires, 2);
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT_EQ(stats.misses, 1);
+    ASSERT(stats.hit_rate > 0.49 && stats.hit_rate < 0.51);
+
+    arena_release(&rec, b);
+    ASSERT_EQ(arena_recycler_stats(&rec).cached_arenas, 1);
+
+    arena_recycler_destroy(&rec);
+}
+
+TEST(test_recycler_buckets) {
+    arena_recycler_t rec;
+    arena_recycler_init(&rec, 1024 * 1024);
+
+    arena_t *small = arena_acquire(&rec, 1024);
+    arena_t *big = arena_acquire(&rec, 1024);
+    ASSERT_NOT_NULL(small);
+    ASSERT_NOT_NULL(big);
+
+    // grow one arena well past its first block
+    for (int i = 0; i < 64; i++) {
+        ASSERT_NOT_NULL(arena_alloc(big, 1024));
+    }
+    size_t peak = arena_capacity(big);
+
+    arena_release(&rec, small);
+    arena_release(&rec, big);
+
+    // a large request must get the arena that already grew that far
+    arena_t *again = arena_acquire(&rec, peak / 2 + 1);
+    ASSERT(again == big);
+
+    // the next one fits the small arena
+    arena_t *other = arena_acquire(&rec, 512);
+    ASSERT(other == small);
+
+    arena_release(&rec, again);
+    arena_release(&rec, other);
+    arena_recycler_destroy(&rec);
+}
+
+TEST(test_recycler_cap) {
+    arena_recycler_t rec;
+    arena_recycler_init(&rec, ARENA_BLOCK_MIN_SIZE * 2);
+
+    arena_t *a = arena_acquire(&rec, ARENA_BLOCK_MIN_SIZE * 8);
+    ASSERT_NOT_NULL(a);
+    arena_release(&rec, a);
+
+    arena_recycler_stats_t stats = arena_recycler_stats(&rec);
+    ASSERT_EQ(stats.evictions, 1);
+    ASSERT_EQ(stats.cached_arenas, 0);
+    ASSERT_EQ(stats.cached_bytes, 0);
+
+    arena_t *b = arena_acquire(&rec, 100);
+    arena_t *c = arena_acquire(&rec, 100);
+    arena_release(&rec, b);
+    arena_release(&rec, c);
+    ASSERT(arena_recycler_stats(&rec).cached_bytes <= ARENA_BLOCK_MIN_SIZE * 2);
+
+    ASSERT(arena_recycler_trim(&rec, 0) > 0);
+    ASSERT_EQ(arena_recycler_stats(&rec).cached_arenas, 0);
+
+    arena_recycler_destroy(&rec);
+}
+
+TEST(test_budget_hard_limit) {
+    arena_budget_t budget;
+    arena_budget_init(&budget, 0, ARENA_BLOCK_MIN_SIZE * 4, NULL);
+
+    arena_t arena;
+    arena_init_dynamic(&arena, 256);
+    ASSERT(arena_set_budget(&arena, &budget));
+
+    // the block arena_init_dynamic made before the budget existed is charged on attach
+    ASSERT_EQ(arena_budget_used(&budget), arena__block_header_size() + arena.capacity);
+
+    size_t count = 0;
+    while (arena_alloc(&arena, 1000) && count < 1000) {
+        count++;
+    }
+
+    // growth stops cleanly at the hard limit instead of running to oom
+    ASSERT(count < 1000);
+    ASSERT(arena_budget_used(&budget) <= ARENA_BLOCK_MIN_SIZE * 4);
+    ASSERT(budget.failures >= 1);
+
+    arena_destroy(&arena);
+    ASSERT_EQ(arena_budget_used(&budget), 0);
+}
+
+static int soft_calls;
+static int hard_calls;
+
+static void count_pressure(arena_budget_t *budget, arena_pressure_t level, size_t requested, void *user) {
+    (void)budget; (void)requested; (void)user;
+    if (level == ARENA_PRESSURE_SOFT) soft_calls++;
+    else hard_calls++;
+}
+
+TEST(test_budget_soft_callback) {
+    arena_budget_t budget;
+    arena_budget_init(&budget, ARENA_BLOCK_MIN_SIZE * 2, 0, NULL);
+    arena_budget_set_callback(&budget, count_pressure, NULL);
+    soft_calls = 0;
+    hard_calls = 0;
+
+    arena_t arena;
+    arena_init_dynamic(&arena, 256);
+    arena_set_budget(&arena, &budget);
+
+    for (int i = 0; i < 40; i++) {
+        ASSERT_NOT_NULL(arena_alloc(&arena, 1000));
+    }
+
+    // soft limit only notifies once per crossing and never fails
+    ASSERT_EQ(soft_calls, 1);
+    ASSERT_EQ(hard_calls, 0);
+    ASSERT(budget.peak > ARENA_BLOCK_MIN_SIZE * 2);
+
+    arena_destroy(&arena);
+}
+
+static arena_t *victim_arena;
+
+TEST(test_budget_soft_after_parent_refuses) {
+    arena_budget_t group, budget;
+    arena_budget_init(&group, 0, 1, NULL);
+    arena_budget_init(&budget, 1, 0, &group);
+    arena_budget_set_callback(&budget, count_pressure, NULL);
+    arena_budget_set_callback(&group, count_pressure, NULL);
+    soft_calls = 0;
+    hard_calls = 0;
+
+    arena_t arena;
+    arena_init_dynamic(&arena, 256);
+
+    // the group refuses, so the child never saw a charge worth a soft callback,
+    // and the retry after the hard callback does not report it twice
+    ASSERT(!arena_set_budget(&arena, &budget));
+    ASSERT_EQ(soft_calls, 0);
+    ASSERT_EQ(hard_calls, 1);
+    ASSERT_EQ(arena_budget_used(&budget), 0);
+    ASSERT_EQ(arena_budget_used(&group), 0);
+    ASSERT_EQ(group.failures, 1);
+
+    // room in the group, the child crosses its soft limit exactly once
+    group.hard_limit = 0;
+    ASSERT(arena_set_budget(&arena, &budget));
+    ASSERT_EQ(soft_calls, 1);
+    ASSERT_EQ(hard_calls, 1);
+
+    arena_destroy(&arena);
+    ASSERT_EQ(arena_budget_used(&group), 0);
+}
+
+static void destroy_victim(arena_budget_t *budget, arena_pressure_t level, size_t requested, void *user) {
+    (void)budget; (void)requested; (void)user;
+    if (level == ARENA_PRESSURE_HARD && victim_arena) {
+        arena_destroy(victim_arena);
+        victim_arena = NULL;
+    }
+}
+
+TEST(test_budget_group) {
+    size_t block = ARENA_BLOCK_MIN_SIZE * 2;
+
+    arena_budget_t group, budget_a, budget_b;
+    arena_budget_init(&group, 0, 0, NULL);
+    arena_budget_init(&budget_a, 0, 0, &group);
+    arena_budget_init(&budget_b, 0, 0, &group);
+
+    arena_t a, b;
+    arena_init_dynamic(&a, block);
+    arena_init_dynamic(&b, block);
+    ASSERT(arena_set_budget(&a, &budget_a));
+    ASSERT(arena_set_budget(&b, &budget_b));
+    ASSERT_EQ(arena_budget_used(&group), arena_budget_used(&budget_a) + arena_budget_used(&budget_b));
+
+    // room for exactly one more block of the same size
+    group.hard_limit = arena_budget_used(&group) + arena_budget_used(&budget_a);
+
+    // fill both first blocks, then a chains the third block the group allows
+    ASSERT_NOT_NULL(arena_alloc(&b, block));
+    ASSERT_NOT_NULL(arena_alloc(&a, block));
+    ASSERT_NOT_NULL(arena_alloc(&a, block - 64));
+
+    // b is over the shared limit now
+    ASSERT_NULL(arena_alloc(&b, block));
+    ASSERT_EQ(arena_budget_used(&budget_b) + arena_budget_used(&budget_a), arena_budget_used(&group));
+
+    // with a pressure callback that sheds a, b gets its block
+    victim_arena = &a;
+    arena_budget_set_callback(&group, destroy_victim, NULL);
+    ASSERT_NOT_NULL(arena_alloc(&b, block));
+    ASSERT_NULL(victim_arena);
+    ASSERT_EQ(arena_budget_used(&budget_a), 0);
+
+    arena_destroy(&b);
+    ASSERT_EQ(arena_budget_used(&group), 0);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static void *recycler_worker(void *arg) {
+    arena_recycler_t *rec = (arena_recycler_t *)arg;
+    for (int i = 0; i < 2000; i++) {
+        arena_t *a = arena_acquire(rec, (size_t)(256 + (i % 7) * 1024));
+        if (!a) return (void *)1;
+        char *p = (char *)arena_alloc(a, 200);
+        if (!p) return (void *)1;
+        memset(p, i & 0xFF, 200);
+        arena_release(rec, a);
+    }
+    return NULL;
+}
+
+TEST(test_recycler_threads) {
+    arena_recycler_t rec;
+    arena_recycler_init(&rec, 1024 * 1024);
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(pthread_create(&threads[i], NULL, recycler_worker, &rec), 0);
+    }
+    for (int i = 0; i < 4; i++) {
+        void *ret = NULL;
+        pthread_join(threads[i], &ret);
+        ASSERT_NULL(ret);
+    }
+
+    arena_recycler_stats_t stats = arena_recycler_stats(&rec);
+    ASSERT_EQ(stats.acquires, 8000);
+    ASSERT_EQ(stats.releases, 8000);
+    ASSERT(stats.hits > stats.misses);
+
+    arena_recycler_destroy(&rec);
+}
+#endif
+
 #endif /* ARENA_BLOCK_CHAINING */
 
+TEST(test_freeze_thaw) {
+    // several pages so the interior pages of the buffer can be protected
+    size_t size = 4 * 4096;
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    ASSERT_NOT_NULL(buffer);
+
+    arena_t arena;
+    arena_init(&arena, buffer, size);
+
+    char *table = (char *)arena_alloc(&arena, 2 * 4096);
+    ASSERT_NOT_NULL(table);
+    memset(table, 'x', 2 * 4096);
+
+    ASSERT(!arena_is_frozen(&arena));
+    ASSERT(arena_freeze(&arena));
+    ASSERT(arena_is_frozen(&arena));
+
+    // reads are still fine
+    ASSERT_EQ(table[0], 'x');
+    ASSERT_EQ(table[2 * 4096 - 1], 'x');
+
+    // freezing twice is a no-op
+    ASSERT(arena_freeze(&arena));
+
+    ASSERT(arena_thaw(&arena));
+    ASSERT(!arena_is_frozen(&arena));
+
+    table[4096] = 'y';
+    ASSERT_NOT_NULL(arena_alloc(&arena, 64));
+
+    arena_destroy(&arena);
+    free(buffer);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(test_freeze_write_faults) {
+    size_t size = 4 * 4096;
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    ASSERT_NOT_NULL(buffer);
+
+    arena_t arena;
+    arena_init(&arena, buffer, size);
+
+    char *data = (char *)arena_alloc(&arena, size / 2);
+    ASSERT_NOT_NULL(data);
+    memset(data, 0, size / 2);
+    ASSERT(arena_freeze(&arena));
+
+    // the middle of the buffer always lies on a fully contained page
+    pid_t pid = fork();
+    if (pid == 0) {
+        ((volatile char *)buffer)[size / 2] = 1;
+        _exit(0);
+    }
+    ASSERT(pid > 0);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT(!(WIFEXITED(status) && WEXITSTATUS(status) == 0));
+
+    arena_destroy(&arena);
+    free(buffer);
+}
+#endif
+
+#ifdef ARENA_BLOCK_CHAINING
+TEST(test_freeze_dynamic) {
+    arena_t arena;
+    arena_init_dynamic(&arena, 8192);
+
+    int *values = arena_new_array(&arena, int, 4096);
+    ASSERT_NOT_NULL(values);
+    for (int i = 0; i < 4096; i++) values[i] = i;
+
+    ASSERT(arena_freeze(&arena));
+    ASSERT_EQ(values[4095], 4095);
+    ASSERT_EQ(arena_used(&arena), 4096 * sizeof(int));
+
+    // destroying a frozen arena thaws it first
+    arena_destroy(&arena);
+}
+#endif
+
 #ifdef ARENA_DEBUG
 
 TEST(test_debug_stats_tracking) {
@@ -1159,6 +1526,25 @@ int main(void) {
     RUN_TEST(test_block_chaining_reset);
     RUN_TEST(test_block_chaining_save_restore);
     RUN_TEST(test_block_chaining_user_buffer_no_grow);
+    RUN_TEST(test_block_chaining_reuse_after_reset);
+    RUN_TEST(test_budget_hard_limit);
+    RUN_TEST(test_budget_soft_callback);
+    RUN_TEST(test_budget_soft_after_parent_refuses);
+    RUN_TEST(test_budget_group);
+    RUN_TEST(test_recycler_hit);
+    RUN_TEST(test_recycler_buckets);
+    RUN_TEST(test_recycler_cap);
+#if defined(__unix__) || defined(__APPLE__)
+    RUN_TEST(test_recycler_threads);
+#endif
+#endif
+
+    RUN_TEST(test_freeze_thaw);
+#if defined(__unix__) || defined(__APPLE__)
+    RUN_TEST(test_freeze_write_faults);
+#endif
+#ifdef ARENA_BLOCK_CHAINING
+    RUN_TEST(test_freeze_dynamic);
 #endif
 
 #ifdef ARENA_DEBUG
@@ -0,0 +1,441 @@
+/*
+ * tests for bufpool.h
+ *
+ *   # super basic tests
+ *   gcc -Wall -Wextra -O2 -o tests_bufpool tests_bufpool.c && ./tests_bufpool
+ *
+ *   # with pool debug features
+ *   gcc -Wall -Wextra -DPOOL_DEBUG -O2 -o tests_bufpool_debug tests_bufpool.c && ./tests_bufpool_debug
+ *
+ *   # readers on other threads, releasing into an owner's pool
+ *   gcc -Wall -Wextra -DPOOL_REMOTE_FREE -O2 -o tests_bufpool_remote tests_bufpool.c -lpthread && ./tests_bufpool_remote
+ *
+ *   # readers on other threads, lock-free pool
+ *   gcc -Wall -Wextra -DPOOL_CONCURRENT -O2 -o tests_bufpool_concurrent tests_bufpool.c -lpthread && ./tests_bufpool_concurrent
+ */
+
+#define POOL_IMPLEMENTATION
+#define BUFPOOL_IMPLEMENTATION
+#include "../bufpool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(POOL_REMOTE_FREE) || defined(POOL_CONCURRENT)
+#include <pthread.h>
+#endif
+
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) static void name(void)
+
+#define RUN_TEST(name)                                                         \
+  do {                                                                         \
+    printf("  Running %-40s ", #name "...");                                   \
+    fflush(stdout);                                                            \
+    tests_run++;                                                               \
+    name();                                                                    \
+    printf("\033[32mPASSED\033[0m\n");                                         \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define ASSERT(cond)                                                           \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("\033[31mFAILED\033[0m\n");                                       \
+      printf("    Assertion failed: %s\n", #cond);                             \
+      printf("    Location: %s:%d\n", __FILE__, __LINE__);                     \
+      tests_failed++;                                                          \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT_EQ(a, b)                                                        \
+  do {                                                                         \
+    if ((a) != (b)) {                                                          \
+      printf("\033[31mFAILED\033[0m\n");                                       \
+      printf("    Assertion failed: %s == %s\n", #a, #b);                      \
+      printf("    Got: %zu, Expected: %zu\n", (size_t)(a), (size_t)(b));       \
+      printf("    Location: %s:%d\n", __FILE__, __LINE__);                     \
+      tests_failed++;                                                          \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT_NOT_NULL(ptr)                                                   \
+  do {                                                                         \
+    if ((ptr) == NULL) {                                                       \
+      printf("\033[31mFAILED\033[0m\n");                                       \
+      printf("    Assertion failed: %s != NULL\n", #ptr);                      \
+      printf("    Location: %s:%d\n", __FILE__, __LINE__);                     \
+      tests_failed++;                                                          \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT_NULL(ptr)                                                       \
+  do {                                                                         \
+    if ((ptr) != NULL) {                                                       \
+      printf("\033[31mFAILED\033[0m\n");                                       \
+      printf("    Assertion failed: %s == NULL\n", #ptr);                      \
+      printf("    Location: %s:%d\n", __FILE__, __LINE__);                     \
+      tests_failed++;                                                          \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+// free buffers once every release has reached the pool.
+static size_t settled_available(bufpool_t *bp) {
+#ifdef POOL_REMOTE_FREE
+  pool_drain_remote(&bp->pool);
+#endif
+  return pool_available(&bp->pool);
+}
+
+TEST(test_init_destroy) {
+  uint8_t memory[8192];
+  bufpool_t bp;
+
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 100), POOL_OK);
+  ASSERT_EQ(bufpool_buf_size(&bp), 100);
+  ASSERT(pool_capacity(&bp.pool) > 0);
+  ASSERT_EQ(pool_available(&bp.pool), pool_capacity(&bp.pool));
+
+  bufpool_destroy(&bp);
+}
+
+#ifndef POOL_CONCURRENT
+static void noop_dtor(void *obj, void *ctx) {
+  (void)obj;
+  (void)ctx;
+}
+#endif
+
+TEST(test_init_errors) {
+  uint8_t memory[1024];
+  bufpool_t bp;
+
+  ASSERT_EQ(bufpool_init(NULL, memory, sizeof(memory), 64), POOL_ERR_NULL_POOL);
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 0), POOL_ERR_INVALID_SLOT_SIZE);
+  ASSERT_EQ(bufpool_init(&bp, NULL, sizeof(memory), 64), POOL_ERR_NULL_BUFFER);
+  ASSERT_EQ(bufpool_init(&bp, memory, 16, 64), POOL_ERR_BUFFER_TOO_SMALL);
+
+#ifndef POOL_CONCURRENT
+  // the header would overwrite a cached object
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.dtor = noop_dtor;
+  ASSERT_EQ(bufpool_init_ex(&bp, memory, sizeof(memory), 64, &cfg), POOL_ERR_INVALID_CONFIG);
+#endif
+}
+
+TEST(test_alloc_release) {
+  uint8_t memory[8192];
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 200), POOL_OK);
+  size_t capacity = pool_capacity(&bp.pool);
+
+  uint8_t *buf = (uint8_t *)bufpool_alloc(&bp);
+  ASSERT_NOT_NULL(buf);
+  ASSERT_EQ((uintptr_t)buf % BUFPOOL_ALIGN, 0);
+  ASSERT_EQ(bufpool_refcount(buf), 1);
+  memset(buf, 0x5A, 200);
+
+  ASSERT_EQ(bufpool_release(buf), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity);
+
+  ASSERT_EQ(bufpool_release(NULL), POOL_ERR_NULL_PTR);
+  ASSERT_NULL(bufpool_retain(NULL));
+  ASSERT_EQ(bufpool_refcount(NULL), 0);
+
+  bufpool_destroy(&bp);
+}
+
+TEST(test_retain_release) {
+  uint8_t memory[8192];
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 64), POOL_OK);
+  size_t capacity = pool_capacity(&bp.pool);
+
+  void *buf = bufpool_alloc(&bp);
+  ASSERT(bufpool_retain(buf) == buf);
+  bufpool_retain(buf);
+  bufpool_retain(buf);
+  ASSERT_EQ(bufpool_refcount(buf), 4);
+
+  // only the last release gives the slot back
+  for (size_t refs = 4; refs > 1; refs--) {
+    ASSERT_EQ(bufpool_release(buf), POOL_OK);
+    ASSERT_EQ(bufpool_refcount(buf), refs - 1);
+    ASSERT_EQ(settled_available(&bp), capacity - 1);
+  }
+  ASSERT_EQ(bufpool_release(buf), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity);
+
+  bufpool_destroy(&bp);
+}
+
+TEST(test_exhaust_and_reuse) {
+  uint8_t memory[4096];
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 100), POOL_OK);
+  size_t capacity = pool_capacity(&bp.pool);
+
+  void *bufs[64];
+  ASSERT(capacity <= 64);
+  for (size_t i = 0; i < capacity; i++) {
+    bufs[i] = bufpool_alloc(&bp);
+    ASSERT_NOT_NULL(bufs[i]);
+    memset(bufs[i], (int)i, 100);
+  }
+  ASSERT_NULL(bufpool_alloc(&bp));
+
+  // the buffers do not overlap
+  for (size_t i = 0; i < capacity; i++) {
+    ASSERT_EQ(((uint8_t *)bufs[i])[0], (uint8_t)i);
+    ASSERT_EQ(((uint8_t *)bufs[i])[99], (uint8_t)i);
+  }
+
+  // a released buffer can be allocated again, with a fresh count
+  ASSERT_EQ(bufpool_release(bufs[3]), POOL_OK);
+  bufs[3] = bufpool_alloc(&bp);
+  ASSERT_NOT_NULL(bufs[3]);
+  ASSERT_EQ(bufpool_refcount(bufs[3]), 1);
+
+  for (size_t i = 0; i < capacity; i++) ASSERT_EQ(bufpool_release(bufs[i]), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity);
+
+  bufpool_destroy(&bp);
+}
+
+TEST(test_slices) {
+  uint8_t memory[8192];
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 128), POOL_OK);
+  size_t capacity = pool_capacity(&bp.pool);
+
+  uint8_t *buf = (uint8_t *)bufpool_alloc(&bp);
+  for (int i = 0; i < 128; i++) buf[i] = (uint8_t)i;
+
+  bufpool_slice_t body = bufpool_slice(buf, 14, 100);
+  ASSERT(body.data == buf + 14);
+  ASSERT_EQ(body.length, 100);
+  ASSERT(body.buf == buf);
+  ASSERT_EQ(bufpool_refcount(buf), 2);
+
+  // a slice of a slice points into the same bytes
+  bufpool_slice_t payload = bufpool_slice_sub(&body, 20, 50);
+  ASSERT(payload.data == buf + 34);
+  ASSERT_EQ(payload.data[0], 34);
+  ASSERT_EQ(payload.length, 50);
+  ASSERT_EQ(bufpool_refcount(buf), 3);
+
+  bufpool_slice_t copy = bufpool_slice_share(&payload);
+  ASSERT(copy.data == payload.data && copy.length == payload.length);
+  ASSERT_EQ(bufpool_refcount(buf), 4);
+
+  // the writer lets go first, the slices keep the bytes alive
+  ASSERT_EQ(bufpool_release(buf), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity - 1);
+  ASSERT_EQ(copy.data[49], 83);
+
+  ASSERT_EQ(bufpool_slice_release(&body), POOL_OK);
+  ASSERT_NULL(body.data);
+  ASSERT_EQ(bufpool_slice_release(&body), POOL_OK);
+  ASSERT_EQ(bufpool_slice_release(&payload), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity - 1);
+  ASSERT_EQ(bufpool_slice_release(&copy), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), capacity);
+
+  bufpool_destroy(&bp);
+}
+
+TEST(test_slice_bounds) {
+  uint8_t memory[8192];
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, sizeof(memory), 64), POOL_OK);
+
+  void *buf = bufpool_alloc(&bp);
+
+  // the whole buffer and an empty view at its end are fine
+  bufpool_slice_t all = bufpool_slice(buf, 0, 64);
+  ASSERT_NOT_NULL(all.data);
+  bufpool_slice_t end = bufpool_slice(buf, 64, 0);
+  ASSERT_NOT_NULL(end.data);
+  ASSERT_EQ(bufpool_refcount(buf), 3);
+
+  // out of range views take no reference
+  bufpool_slice_t bad = bufpool_slice(buf, 60, 5);
+  ASSERT_NULL(bad.data);
+  ASSERT_NULL(bad.buf);
+  bad = bufpool_slice(buf, 65, 0);
+  ASSERT_NULL(bad.data);
+  bad = bufpool_slice(buf, 1, SIZE_MAX);
+  ASSERT_NULL(bad.data);
+  bad = bufpool_slice_sub(&all, 10, 55);
+  ASSERT_NULL(bad.data);
+  bad = bufpool_slice_share(&bad);
+  ASSERT_NULL(bad.data);
+  bad = bufpool_slice(NULL, 0, 0);
+  ASSERT_NULL(bad.data);
+  ASSERT_EQ(bufpool_refcount(buf), 3);
+
+  ASSERT_EQ(bufpool_slice_release(&all), POOL_OK);
+  ASSERT_EQ(bufpool_slice_release(&end), POOL_OK);
+  ASSERT_EQ(bufpool_slice_release(NULL), POOL_ERR_NULL_PTR);
+  ASSERT_EQ(bufpool_release(buf), POOL_OK);
+
+  bufpool_destroy(&bp);
+}
+
+TEST(test_required_size) {
+  size_t size = bufpool_required_size(1500, 10);
+  uint8_t *memory = (uint8_t *)malloc(size);
+  ASSERT_NOT_NULL(memory);
+
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, size, 1500), POOL_OK);
+  ASSERT(pool_capacity(&bp.pool) >= 10);
+
+  void *bufs[10];
+  for (int i = 0; i < 10; i++) {
+    bufs[i] = bufpool_alloc(&bp);
+    ASSERT_NOT_NULL(bufs[i]);
+    memset(bufs[i], 0xEE, 1500);
+  }
+  for (int i = 0; i < 10; i++) bufpool_release(bufs[i]);
+
+  bufpool_destroy(&bp);
+  free(memory);
+}
+
+#ifdef POOL_DYNAMIC
+TEST(test_dynamic) {
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init_dynamic(&bp, 1000, NULL), POOL_OK);
+
+  // grows past the first chunk, buffers stay aligned
+  void *bufs[200];
+  for (int i = 0; i < 200; i++) {
+    bufs[i] = bufpool_alloc(&bp);
+    ASSERT_NOT_NULL(bufs[i]);
+    ASSERT_EQ((uintptr_t)bufs[i] % BUFPOOL_ALIGN, 0);
+    memset(bufs[i], i, 1000);
+  }
+  bufpool_slice_t slice = bufpool_slice(bufs[150], 10, 20);
+  ASSERT_EQ(slice.data[0], 150);
+
+  for (int i = 0; i < 200; i++) ASSERT_EQ(bufpool_release(bufs[i]), POOL_OK);
+  ASSERT_EQ(bufpool_slice_release(&slice), POOL_OK);
+  ASSERT_EQ(settled_available(&bp), pool_capacity(&bp.pool));
+
+  bufpool_destroy(&bp);
+}
+#endif
+
+#if defined(POOL_REMOTE_FREE) || defined(POOL_CONCURRENT)
+
+#define FANOUT_READERS 4
+#define FANOUT_MESSAGES 32
+#define FANOUT_ROUNDS 200
+
+typedef struct {
+  bufpool_slice_t slices[FANOUT_MESSAGES];
+  size_t bad;
+} fanout_reader_t;
+
+static void *fanout_worker(void *p) {
+  fanout_reader_t *reader = (fanout_reader_t *)p;
+  for (int i = 0; i < FANOUT_MESSAGES; i++) {
+    bufpool_slice_t *s = &reader->slices[i];
+    // every byte of a message holds its index
+    for (size_t j = 0; j < s->length; j++) {
+      if (s->data[j] != (uint8_t)i) reader->bad++;
+    }
+    bufpool_slice_release(s);
+  }
+  return NULL;
+}
+
+TEST(test_fanout_threads) {
+  size_t size = bufpool_required_size(256, FANOUT_MESSAGES);
+  uint8_t *memory = (uint8_t *)malloc(size);
+  bufpool_t bp;
+  ASSERT_EQ(bufpool_init(&bp, memory, size, 256), POOL_OK);
+
+  fanout_reader_t readers[FANOUT_READERS];
+  pthread_t threads[FANOUT_READERS];
+
+  for (int round = 0; round < FANOUT_ROUNDS; round++) {
+    memset(readers, 0, sizeof(readers));
+
+    // one copy of each message, a slice of it per reader
+    for (int i = 0; i < FANOUT_MESSAGES; i++) {
+      uint8_t *msg = (uint8_t *)bufpool_alloc(&bp);
+      ASSERT_NOT_NULL(msg);
+      memset(msg, i, 256);
+      bufpool_slice_t body = bufpool_slice(msg, 16, 240);
+      for (int r = 0; r < FANOUT_READERS; r++) {
+        readers[r].slices[i] = r + 1 < FANOUT_READERS ? bufpool_slice_share(&body) : body;
+      }
+      bufpool_release(msg);
+    }
+
+    for (int r = 0; r < FANOUT_READERS; r++) pthread_create(&threads[r], NULL, fanout_worker, &readers[r]);
+    for (int r = 0; r < FANOUT_READERS; r++) pthread_join(threads[r], NULL);
+
+    for (int r = 0; r < FANOUT_READERS; r++) ASSERT_EQ(readers[r].bad, 0);
+    ASSERT_EQ(settled_available(&bp), pool_capacity(&bp.pool));
+  }
+
+  bufpool_destroy(&bp);
+  free(memory);
+}
+#endif
+
+int main(void) {
+  printf("\n");
+  printf(" buffer pool tests \n");
+  printf("configuration:\n");
+#ifdef POOL_REMOTE_FREE
+  printf("   POOL_REMOTE_FREE: enabled\n");
+#endif
+#ifdef POOL_CONCURRENT
+  printf("   POOL_CONCURRENT: enabled\n");
+#endif
+#ifdef POOL_DEBUG
+  printf("   POOL_DEBUG: enabled\n");
+#else
+  printf("   POOL_DEBUG: disabled\n");
+#endif
+
+  RUN_TEST(test_init_destroy);
+  RUN_TEST(test_init_errors);
+  RUN_TEST(test_alloc_release);
+  RUN_TEST(test_retain_release);
+  RUN_TEST(test_exhaust_and_reuse);
+  RUN_TEST(test_slices);
+  RUN_TEST(test_slice_bounds);
+  RUN_TEST(test_required_size);
+#ifdef POOL_DYNAMIC
+  RUN_TEST(test_dynamic);
+#endif
+#if defined(POOL_REMOTE_FREE) || defined(POOL_CONCURRENT)
+  RUN_TEST(test_fanout_threads);
+#endif
+
+  printf("    %d/%d tests passed\n", tests_passed, tests_run);
+  if (tests_failed > 0) {
+    printf("   \033[31m%d TESTS FAILED\033[0m\n", tests_failed);
+  } else {
+    printf("   \033[32mALL TESTS PASSED\033[0m\n");
+  }
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -6,9 +6,33 @@
  *
  *   # with debug features
  *   gcc -Wall -Wextra -DPOOL_DEBUG -O2 -o tests_pool_debug tests_pool.c && ./tests_pool_debug
+ *
+ *   # growable pools
+ *   gcc -Wall -Wextra -DPOOL_DYNAMIC -O2 -o tests_pool_dynamic tests_pool.c && ./tests_pool_dynamic
+ *
+ *   # lock-free pool
+ *   gcc -Wall -Wextra -DPOOL_CONCURRENT -O2 -o tests_pool_concurrent tests_pool.c -lpthread && ./tests_pool_concurrent
+ *
+ *   # per-thread magazine caches
+ *   gcc -Wall -Wextra -DPOOL_MAGAZINES -O2 -o tests_pool_magazines tests_pool.c -lpthread && ./tests_pool_magazines
+ *
+ *   # frees from other threads into an owner's pool
+ *   gcc -Wall -Wextra -DPOOL_REMOTE_FREE -O2 -o tests_pool_remote tests_pool.c -lpthread && ./tests_pool_remote
+ *
+ *   # zero on free in the background
+ *   gcc -Wall -Wextra -DPOOL_ZERO_ON_FREE -DPOOL_DEFERRED_ZERO -O2 -o tests_pool_deferred tests_pool.c && ./tests_pool_deferred
+ *
+ *   # hardened free list
+ *   gcc -Wall -Wextra -DPOOL_HARDENED -O2 -o tests_pool_hardened tests_pool.c && ./tests_pool_hardened
 
  */
 
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+// count corruption reports instead of aborting so the tests can see them
+static int hardened_reports = 0;
+#define POOL_ASSERT(x) ((x) ? (void)0 : (void)hardened_reports++)
+#endif
+
 #define POOL_IMPLEMENTATION
 #include "../pool.h"
 
@@ -19,6 +43,10 @@
 #include <string.h>
 #include <time.h>
 
+#if defined(POOL_CONCURRENT) || defined(POOL_MAGAZINES) || defined(POOL_REMOTE_FREE)
+#include <pthread.h>
+#endif
+
 static int tests_run = 0;
 static int tests_passed = 0;
 static int tests_failed = 0;
@@ -84,6 +112,27 @@ static bool is_aligned(const void *ptr, size_t align) {
   return ((uintptr_t)ptr % align) == 0;
 }
 
+// with POOL_DEFERRED_ZERO freed slots wait on the dirty list and only come
+// back last freed first once scrubbed, tests that check reuse order call this.
+static void scrub_frees(pool_t *pool) {
+#ifdef POOL_DEFERRED_ZERO
+  pool_scrub(pool, 0);
+#else
+  (void)pool;
+#endif
+}
+
+#ifndef POOL_CONCURRENT
+// mallocs a buffer sized for cfg and inits the pool in it, the caller frees *buffer.
+static int config_pool_init(pool_t *pool, uint8_t **buffer, size_t slot_size, size_t count,
+                            const pool_config_t *cfg) {
+  size_t size = pool_required_size_ex(slot_size, count, cfg);
+  *buffer = (uint8_t *)malloc(size);
+  if (*buffer == NULL) return POOL_ERR_NULL_BUFFER;
+  return pool_init_ex(pool, *buffer, size, slot_size, cfg);
+}
+#endif
+
 TEST(test_basic_alloc_free) {
   uint8_t buffer[1024];
   pool_t pool;
@@ -124,8 +173,8 @@ TEST(test_slot_size_honored) {
     ASSERT_EQ(err, POOL_OK);
 
     size_t actual = pool_slot_size(&pool);
+    // slots smaller than a pointer are no longer rounded up to one
     ASSERT(actual >= requested);
-    ASSERT(actual >= sizeof(void *));
 
     // allocate two slots and verify they don't overlap
     void *slot1 = pool_alloc(&pool);
@@ -208,6 +257,7 @@ TEST(test_free_reuse) {
   ASSERT_NOT_NULL(slot1);
 
   pool_free(&pool, slot1);
+  scrub_frees(&pool);
 
   // next allocation should return the same slot lifo
   void *slot2 = pool_alloc(&pool);
@@ -269,7 +319,7 @@ TEST(test_owns) {
   ASSERT(!pool_owns(&pool1, slot2));
   ASSERT(!pool_owns(&pool2, slot1));
 
-  int stack_var;
+  int stack_var = 0;
   ASSERT(!pool_owns(&pool1, &stack_var));
   ASSERT(!pool_owns(&pool1, NULL));
 
@@ -417,6 +467,106 @@ TEST(test_stats) {
   pool_destroy(&pool);
 }
 
+TEST(test_tiny_slots) {
+  size_t sizes[] = {1, 2, 3, 4};
+
+  for (size_t s = 0; s < 4; s++) {
+    size_t required = pool_required_size(sizes[s], 1000);
+    uint8_t *buffer = (uint8_t *)malloc(required);
+    ASSERT_NOT_NULL(buffer);
+
+    pool_t pool;
+    ASSERT_EQ(pool_init(&pool, buffer, required, sizes[s]), POOL_OK);
+    ASSERT(pool_capacity(&pool) >= 1000);
+    ASSERT_EQ(required, pool_required_size_ex(sizes[s], 1000, NULL));
+
+    size_t slot_size = pool_slot_size(&pool);
+    ASSERT(slot_size >= sizes[s]);
+#if defined(POOL_CONCURRENT)
+#ifndef POOL_DEBUG
+    // lock-free links are 32-bit indices
+    ASSERT_EQ(slot_size, 4);
+#endif
+#else
+    ASSERT_EQ(slot_size, sizes[s]);
+#ifndef POOL_DEBUG
+    ASSERT(required < 1000 * sizes[s] + 1000 / 4 + 64);
+#endif
+#endif
+
+    // every slot is usable and keeps its own bytes
+    uint8_t **slots = (uint8_t **)malloc(1000 * sizeof(uint8_t *));
+    for (size_t i = 0; i < 1000; i++) {
+      slots[i] = (uint8_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(slots[i]);
+      memset(slots[i], (int)(i & 0xFF), sizes[s]);
+    }
+    for (size_t i = 0; i < 1000; i++) {
+      for (size_t b = 0; b < sizes[s]; b++) ASSERT_EQ(slots[i][b], (uint8_t)(i & 0xFF));
+    }
+
+    for (size_t i = 0; i < 1000; i += 2) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+    for (size_t i = 0; i < 1000; i += 2) ASSERT_NOT_NULL(pool_alloc(&pool));
+    for (size_t i = 0; i < 1000; i++) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+    ASSERT(pool_is_empty(&pool));
+
+    free(slots);
+    pool_destroy(&pool);
+    free(buffer);
+  }
+}
+
+TEST(test_pool_alignment) {
+  uint8_t *buffer = (uint8_t *)malloc(8192);
+  ASSERT_NOT_NULL(buffer);
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  // a cache line per slot, even out of a buffer that is not aligned at all
+  pool_t wide;
+  cfg.alignment = 64;
+  size_t required = pool_required_size_ex(24, 20, &cfg);
+  ASSERT(required > 0);
+  ASSERT_EQ(pool_init_ex(&wide, buffer + 1, required, 24, &cfg), POOL_OK);
+  ASSERT_EQ(pool_slot_size(&wide), 64);
+  ASSERT(pool_capacity(&wide) >= 20);
+
+  void *slots[20];
+  for (int i = 0; i < 20; i++) {
+    slots[i] = pool_alloc(&wide);
+    ASSERT_NOT_NULL(slots[i]);
+    ASSERT(is_aligned(slots[i], 64));
+  }
+  for (int i = 0; i < 20; i++) ASSERT_EQ(pool_free(&wide, slots[i]), POOL_OK);
+  pool_destroy(&wide);
+
+  // and a tight pool next to it in the same translation unit
+  pool_t tight;
+  cfg.alignment = 8;
+  ASSERT_EQ(pool_init_ex(&tight, buffer + 4096, 4096, 24, &cfg), POOL_OK);
+  ASSERT_EQ(pool_slot_size(&tight), 24);
+  void *p = pool_alloc(&tight);
+  ASSERT(is_aligned(p, 8));
+  ASSERT_EQ(pool_free(&tight, p), POOL_OK);
+  pool_destroy(&tight);
+
+#ifndef POOL_CONCURRENT
+  // engines without links round to the alignment alone
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.alignment = 16;
+  ASSERT_EQ(pool_init_ex(&tight, buffer, 4096, 4, &cfg), POOL_OK);
+  ASSERT_EQ(pool_slot_size(&tight), 16);
+  pool_destroy(&tight);
+  cfg.engine = POOL_ENGINE_FREELIST;
+#endif
+
+  cfg.alignment = 48;
+  ASSERT_EQ(pool_init_ex(&tight, buffer, 4096, 24, &cfg), POOL_ERR_INVALID_ALIGNMENT);
+  ASSERT_EQ(pool_required_size_ex(24, 20, &cfg), 0);
+
+  free(buffer);
+}
+
 TEST(test_minimum_pool) {
   // smallest possible pool with 1 slot
   size_t required = pool_required_size(1, 1);
@@ -535,135 +685,3100 @@ TEST(test_null_pool_queries) {
   pool_reset(NULL);
 }
 
-#ifdef POOL_DEBUG
+TEST(test_lazy_init_untouched) {
+  static uint8_t buffer[64 * 1024];
+  memset(buffer, 0xCD, sizeof(buffer));
 
-TEST(test_debug_double_free) {
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 64), POOL_OK);
+  size_t slot_size = pool_slot_size(&pool);
+  size_t capacity = pool_capacity(&pool);
+
+  // init does not write into any slot
+  uint8_t *first = (uint8_t *)pool_alloc(&pool);
+  ASSERT_NOT_NULL(first);
+  for (size_t i = slot_size; i < (capacity - 1) * slot_size; i++) {
+    ASSERT_EQ(first[i], 0xCD);
+  }
+
+  // never-used slots come out in address order
+  uint8_t *second = (uint8_t *)pool_alloc(&pool);
+  uint8_t *third = (uint8_t *)pool_alloc(&pool);
+  ASSERT(second == first + slot_size);
+  ASSERT(third == second + slot_size);
+
+  // freed slots are reused before new ones
+  pool_free(&pool, second);
+  scrub_frees(&pool);
+  ASSERT(pool_alloc(&pool) == second);
+  ASSERT_EQ(pool_available(&pool), capacity - 3);
+
+  // reset is o(1) and leaves the untouched tail alone
+  pool_reset(&pool);
+  ASSERT(pool_is_empty(&pool));
+  for (size_t i = 3 * slot_size; i < (capacity - 1) * slot_size; i++) {
+    ASSERT_EQ(first[i], 0xCD);
+  }
+  ASSERT(pool_alloc(&pool) == first);
+
+  // the whole capacity is still reachable
+  size_t got = 1;
+  while (pool_alloc(&pool) != NULL) got++;
+  ASSERT_EQ(got, capacity);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
+
+TEST(test_alloc_near_fallback) {
   uint8_t buffer[1024];
   pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+
+  // a plain free list has no page index, so it hands out what pool_alloc would
+  void *a = pool_alloc_near(&pool, NULL);
+  void *b = pool_alloc_near(&pool, a);
+  ASSERT_NOT_NULL(a);
+  ASSERT_NOT_NULL(b);
+  pool_free(&pool, a);
+  scrub_frees(&pool);
+  int outside = 0;
+  ASSERT(pool_alloc_near(&pool, &outside) == a);
+  ASSERT_EQ(pool_used(&pool), 2);
+
+  ASSERT_NULL(pool_alloc_near(NULL, a));
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
 
+TEST(test_bulk_alloc_free) {
+  uint8_t buffer[8192];
+  pool_t pool;
   pool_init(&pool, buffer, sizeof(buffer), 32);
+  size_t capacity = pool_capacity(&pool);
 
-  void *slot = pool_alloc(&pool);
-  ASSERT_NOT_NULL(slot);
-  ASSERT(pool_is_allocated(&pool, slot));
+  void *slots[64];
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, 64), 64);
+  ASSERT_EQ(pool_used(&pool), 64);
 
-  int err = pool_free(&pool, slot);
-  ASSERT_EQ(err, POOL_OK);
-  ASSERT(!pool_is_allocated(&pool, slot));
+  for (int i = 0; i < 64; i++) {
+    ASSERT(pool_owns(&pool, slots[i]));
+    for (int j = 0; j < i; j++) {
+      ASSERT(slots[i] != slots[j]);
+    }
+    memset(slots[i], 0xAB, 32);
+  }
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots, 64), POOL_OK);
+  ASSERT_EQ(pool_available(&pool), capacity);
+
+  // the freed run comes back first, and single allocs still work
+  scrub_frees(&pool);
+  void *one = pool_alloc(&pool);
+  ASSERT(one == slots[0]);
+  pool_free(&pool, one);
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots, 0), POOL_OK);
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, 0), 0);
+  ASSERT_EQ(pool_alloc_bulk(NULL, slots, 4), 0);
 
-  // actual double free triggers assert so we just verify state tracking here
   pool_destroy(&pool);
 }
 
-TEST(test_debug_stats) {
-  uint8_t buffer[2048];
+TEST(test_bulk_all_or_nothing) {
+  uint8_t buffer[1024];
   pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+  size_t capacity = pool_capacity(&pool);
+
+  void *slots[128];
+  void *extra = pool_alloc(&pool);
+  ASSERT_NOT_NULL(extra);
+
+  // asking for more than is free leaves the pool untouched
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, capacity), 0);
+  ASSERT_EQ(pool_available(&pool), capacity - 1);
 
+  // the partial variant takes what is there
+  size_t got = pool_alloc_bulk_partial(&pool, slots, capacity);
+  ASSERT_EQ(got, capacity - 1);
+  ASSERT(pool_is_full(&pool));
+  ASSERT_EQ(pool_alloc_bulk_partial(&pool, slots + got, 4), 0);
+
+  slots[got++] = extra;
+  ASSERT_EQ(pool_free_bulk(&pool, slots, got), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+}
+
+#ifndef POOL_DEBUG
+TEST(test_bulk_free_invalid) {
+  uint8_t buffer[1024];
+  pool_t pool;
   pool_init(&pool, buffer, sizeof(buffer), 32);
 
-  void *s1 = pool_alloc(&pool);
-  void *s2 = pool_alloc(&pool);
-  void *s3 = pool_alloc(&pool);
-  // peak is 3
+  void *slots[4];
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, 3), 3);
+
+  // one bad pointer rejects the whole batch
+  int local = 0;
+  slots[3] = &local;
+  ASSERT_EQ(pool_free_bulk(&pool, slots, 4), POOL_ERR_INVALID_PTR);
+  ASSERT_EQ(pool_used(&pool), 3);
+
+  // the partial variant frees the good ones and moves them to the front
+  void *mixed[4] = {slots[0], &local, slots[1], slots[2]};
+  ASSERT_EQ(pool_free_bulk_partial(&pool, mixed, 4), 3);
+  ASSERT(mixed[0] == slots[0] && mixed[1] == slots[1] && mixed[2] == slots[2]);
+  ASSERT(pool_is_empty(&pool));
 
-  pool_free(&pool, s1);
-  pool_free(&pool, s2);
-  // used is 1
+  pool_destroy(&pool);
+}
+#endif
 
-  void *s4 = pool_alloc(&pool);
-  void *s5 = pool_alloc(&pool);
-  // used is 3 peak still 3
+TEST(test_engine_config_errors) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
 
-  pool_stats_t stats;
-  pool_stats(&pool, &stats);
+  // null config is plain pool_init
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, NULL), POOL_OK);
+  ASSERT_EQ(pool_required_size_ex(32, 10, NULL), pool_required_size(32, 10));
+  pool_destroy(&pool);
 
-  ASSERT_EQ(stats.total_allocs, 5);
-  ASSERT_EQ(stats.total_frees, 2);
-  ASSERT_EQ(stats.peak_used, 3);
-  ASSERT_EQ(stats.used_count, 3);
+  cfg.engine = (pool_engine_t)42;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  ASSERT_EQ(pool_required_size_ex(32, 10, &cfg), 0);
+
+  // the index stack only reuses lifo
+  cfg.engine = POOL_ENGINE_STACK;
+  cfg.reuse = POOL_REUSE_ADDRESS;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.reuse = POOL_REUSE_PAGE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.reuse = POOL_REUSE_DEFAULT;
+#ifdef POOL_CONCURRENT
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+#endif
 
-  pool_free(&pool, s3);
-  pool_free(&pool, s4);
-  pool_free(&pool, s5);
+  cfg.engine = POOL_ENGINE_FREELIST;
+  cfg.flags = 1u << 20;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+
+#ifdef POOL_CONCURRENT
+  cfg.flags = POOL_FLAG_HANDLES;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+  cfg.flags = POOL_FLAG_OCCUPANCY;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+  cfg.flags = 0;
+  cfg.engine = POOL_ENGINE_BITMAP;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+  cfg.engine = POOL_ENGINE_FREELIST;
+  cfg.reuse = POOL_REUSE_ADDRESS;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+  cfg.reuse = POOL_REUSE_PAGE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_UNSUPPORTED);
+  cfg.reuse = POOL_REUSE_LIFO;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_OK);
+  ASSERT_EQ(pool_sort_free_list(&pool), POOL_ERR_UNSUPPORTED);
+  pool_destroy(&pool);
+#endif
+
+  // the bitmap engine only reuses in address order
+  cfg.flags = 0;
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.reuse = POOL_REUSE_LIFO;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.reuse = POOL_REUSE_PAGE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.engine = POOL_ENGINE_FREELIST;
+  cfg.reuse = (pool_reuse_t)42;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  ASSERT_EQ(pool_required_size_ex(32, 10, &cfg), 0);
+  ASSERT_EQ(pool_sort_free_list(NULL), POOL_ERR_NULL_POOL);
+}
+
+#ifndef POOL_CONCURRENT
+
+static int bitmap_pool_init(pool_t *pool, void *buffer, size_t size, size_t slot_size) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  return pool_init_ex(pool, buffer, size, slot_size, &cfg);
+}
+
+TEST(test_bitmap_address_order) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(bitmap_pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+  size_t slot_size = pool_slot_size(&pool);
 
+  uint8_t *slots[10];
+  for (int i = 0; i < 10; i++) {
+    slots[i] = (uint8_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    if (i > 0) ASSERT(slots[i] == slots[i - 1] + slot_size);
+  }
+
+  // freed slots come back lowest address first, not in lifo order
+  pool_free(&pool, slots[7]);
+  pool_free(&pool, slots[3]);
+  pool_free(&pool, slots[5]);
+  ASSERT(pool_alloc(&pool) == slots[3]);
+  ASSERT(pool_alloc(&pool) == slots[5]);
+  ASSERT(pool_alloc(&pool) == slots[7]);
+  ASSERT(pool_alloc(&pool) == slots[9] + slot_size);
+  ASSERT_EQ(pool_used(&pool), 11);
+
+  // the whole capacity is reachable, then reset starts over at the front
+  size_t got = 11;
+  while (pool_alloc(&pool) != NULL) got++;
+  ASSERT_EQ(got, pool_capacity(&pool));
+  ASSERT(pool_is_full(&pool));
+
+  pool_reset(&pool);
+  ASSERT(pool_is_empty(&pool));
+  ASSERT(pool_alloc(&pool) == slots[0]);
+
+  pool_reset(&pool);
   pool_destroy(&pool);
 }
 
-#endif // POOL_DEBUG
+TEST(test_bitmap_tiny_slots) {
+  uint8_t buffer[1024];
+  pool_t pool;
 
-TEST(test_stress_perf) {
-  size_t slot_size = 64;
-  size_t slot_count = 10000;
-  size_t required = pool_required_size(slot_size, slot_count);
+  size_t sizes[] = {1, 2, 3, 4, 6, 12};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t size = sizes[s];
+    ASSERT_EQ(bitmap_pool_init(&pool, buffer, sizeof(buffer), size), POOL_OK);
+
+    // no pointer sized minimum, slots keep their natural alignment
+    ASSERT_EQ(pool_slot_size(&pool), size);
+    ASSERT(pool_capacity(&pool) > sizeof(buffer) / size / 2);
+
+    size_t capacity = pool_capacity(&pool);
+    uint8_t *prev = NULL;
+    for (size_t i = 0; i < capacity; i++) {
+      uint8_t *p = (uint8_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(p);
+      ASSERT_EQ((uintptr_t)p % (size & (~size + 1)), 0);
+      if (prev) ASSERT(p == prev + size);
+      memset(p, (int)(i & 0xFF), size);
+      prev = p;
+    }
+    ASSERT_NULL(pool_alloc(&pool));
+
+    // filling every slot did not clobber the bitmaps behind them
+    ASSERT_EQ(pool_free(&pool, prev), POOL_OK);
+    ASSERT(pool_alloc(&pool) == prev);
+
+    pool_reset(&pool);
+    pool_destroy(&pool);
+  }
+}
+
+TEST(test_bitmap_many_slots) {
+  // enough slots for several summary words
+  size_t count = 20000;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
 
+  size_t required = pool_required_size_ex(4, count, &cfg);
   uint8_t *buffer = (uint8_t *)malloc(required);
   ASSERT_NOT_NULL(buffer);
 
   pool_t pool;
-  pool_init(&pool, buffer, required, slot_size);
+  ASSERT_EQ(pool_init_ex(&pool, buffer, required, 4, &cfg), POOL_OK);
+  ASSERT(pool_capacity(&pool) >= count);
 
-  size_t actual_count = pool_capacity(&pool);
-  void **slots = (void **)malloc(actual_count * sizeof(void *));
+  uint32_t **slots = (uint32_t **)malloc(count * sizeof(uint32_t *));
   ASSERT_NOT_NULL(slots);
-
-  clock_t start = clock();
-  for (size_t i = 0; i < actual_count; i++) {
-    slots[i] = pool_alloc(&pool);
+  for (size_t i = 0; i < count; i++) {
+    slots[i] = (uint32_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    *slots[i] = (uint32_t)i;
   }
-  clock_t alloc_time = clock() - start;
 
-  start = clock();
-  for (size_t i = 0; i < actual_count; i++) {
-    pool_free(&pool, slots[i]);
+  // free every third slot past the first summary word, refill lowest first
+  for (size_t i = 5000; i < count; i += 3) {
+    ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  }
+  for (size_t i = 5000; i < count; i += 3) {
+    ASSERT(pool_alloc(&pool) == (void *)slots[i]);
+  }
+  for (size_t i = 0; i < count; i++) {
+    if ((i < 5000 || (i - 5000) % 3 != 0)) ASSERT_EQ(*slots[i], i);
   }
-  clock_t free_time = clock() - start;
 
-  // just ensure it didn't crash and actually did work
-  ASSERT(alloc_time >= 0);
-  ASSERT(free_time >= 0);
+  for (size_t i = 0; i < count; i++) {
+    ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  }
+  ASSERT(pool_is_empty(&pool));
 
-  free(slots);
   pool_destroy(&pool);
+  free(slots);
   free(buffer);
 }
 
-int main(void) {
-  printf("\n");
-  printf(" pool allocator tests \n");
-  printf("configuration:\n");
-#ifdef POOL_DEBUG
-  printf("   POOL_DEBUG: enabled\n");
-#else
-  printf("   POOL_DEBUG: disabled\n");
-#endif
-  printf("   Default alignment: %zu bytes\n", (size_t)POOL_ALIGN);
+TEST(test_bitmap_required_size) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
 
-  RUN_TEST(test_basic_alloc_free);
-  RUN_TEST(test_slot_size_honored);
-  RUN_TEST(test_alignment);
-  RUN_TEST(test_exhaust_pool);
-  RUN_TEST(test_free_reuse);
-  RUN_TEST(test_reset);
-  RUN_TEST(test_owns);
-  RUN_TEST(test_interleaved);
+  size_t test_sizes[] = {1, 2, 5, 8, 24, 64, 256};
+  size_t test_counts[] = {1, 63, 64, 65, 1000, 4097};
 
-  RUN_TEST(test_init_errors);
-  RUN_TEST(test_free_errors);
+  for (size_t si = 0; si < sizeof(test_sizes) / sizeof(test_sizes[0]); si++) {
+    for (size_t ci = 0; ci < sizeof(test_counts) / sizeof(test_counts[0]); ci++) {
+      size_t required = pool_required_size_ex(test_sizes[si], test_counts[ci], &cfg);
 
-  RUN_TEST(test_stats);
+      uint8_t *buffer = (uint8_t *)malloc(required);
+      ASSERT_NOT_NULL(buffer);
 
-  RUN_TEST(test_minimum_pool);
-  RUN_TEST(test_large_slots);
-  RUN_TEST(test_required_size);
-  RUN_TEST(test_error_strings);
-  RUN_TEST(test_null_pool_queries);
+      pool_t pool;
+      ASSERT_EQ(pool_init_ex(&pool, buffer, required, test_sizes[si], &cfg), POOL_OK);
+      ASSERT(pool_capacity(&pool) >= test_counts[ci]);
 
-#ifdef POOL_DEBUG
-  RUN_TEST(test_debug_double_free);
-  RUN_TEST(test_debug_stats);
+      pool_destroy(&pool);
+      free(buffer);
+    }
+  }
+}
+
+TEST(test_bitmap_bulk) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(bitmap_pool_init(&pool, buffer, sizeof(buffer), 16), POOL_OK);
+  size_t capacity = pool_capacity(&pool);
+
+  void *slots[100];
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, 100), 100);
+  for (int i = 1; i < 100; i++) {
+    ASSERT((uint8_t *)slots[i] == (uint8_t *)slots[i - 1] + 16);
+  }
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots + 50, 50), POOL_OK);
+  ASSERT_EQ(pool_used(&pool), 50);
+  ASSERT(pool_alloc(&pool) == slots[50]);
+  ASSERT_EQ(pool_free(&pool, slots[50]), POOL_OK);
+
+  ASSERT_EQ(pool_free_bulk_partial(&pool, slots, 50), 50);
+  ASSERT_EQ(pool_available(&pool), capacity);
+
+  pool_destroy(&pool);
+}
+
+#ifndef POOL_DEBUG
+TEST(test_bitmap_double_free) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  ASSERT_EQ(bitmap_pool_init(&pool, buffer, sizeof(buffer), 8), POOL_OK);
+
+  // the occupancy bitmap catches double frees without POOL_DEBUG
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, a), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, a), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_used(&pool), 1);
+
+  // a pointer listed twice rejects the whole batch
+  void *c = pool_alloc(&pool);
+  void *batch[3] = {b, c, b};
+  ASSERT_EQ(pool_free_bulk(&pool, batch, 3), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_used(&pool), 2);
+
+  ASSERT_EQ(pool_free_bulk_partial(&pool, batch, 3), 2);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+}
 #endif
 
-  RUN_TEST(test_stress_perf);
+typedef struct foreach_ctx {
+  void *seen[256];
+  size_t count;
+  size_t stop_after;
+} foreach_ctx_t;
+
+static int collect_slot(void *slot, void *ctx) {
+  foreach_ctx_t *c = (foreach_ctx_t *)ctx;
+  c->seen[c->count++] = slot;
+  return c->stop_after != 0 && c->count == c->stop_after;
+}
+
+TEST(test_foreach_allocated) {
+  pool_engine_t engines[] = {POOL_ENGINE_FREELIST, POOL_ENGINE_BITMAP};
+
+  for (int e = 0; e < 2; e++) {
+    uint8_t buffer[8192];
+    pool_t pool;
+    pool_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.engine = engines[e];
+    cfg.flags = POOL_FLAG_OCCUPANCY;
+    ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_OK);
+
+    // spread live slots over several occupancy words
+    void *slots[200];
+    for (int i = 0; i < 200; i++) {
+      slots[i] = pool_alloc(&pool);
+      ASSERT_NOT_NULL(slots[i]);
+    }
+    for (int i = 0; i < 200; i++) {
+      if (i % 7 != 0 && !(i >= 64 && i < 128)) pool_free(&pool, slots[i]);
+    }
+
+    foreach_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ASSERT_EQ(pool_foreach_allocated(&pool, collect_slot, &ctx), POOL_OK);
+    ASSERT_EQ(ctx.count, pool_used(&pool));
+    for (size_t i = 1; i < ctx.count; i++) {
+      ASSERT((uint8_t *)ctx.seen[i] > (uint8_t *)ctx.seen[i - 1]);
+    }
+    for (size_t i = 0; i < ctx.count; i++) {
+      ASSERT(pool_owns(&pool, ctx.seen[i]));
+    }
+
+    // non zero from the callback stops the walk
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.stop_after = 3;
+    ASSERT_EQ(pool_foreach_allocated(&pool, collect_slot, &ctx), POOL_OK);
+    ASSERT_EQ(ctx.count, 3);
+
+    pool_reset(&pool);
+    memset(&ctx, 0, sizeof(ctx));
+    ASSERT_EQ(pool_foreach_allocated(&pool, collect_slot, &ctx), POOL_OK);
+    ASSERT_EQ(ctx.count, 0);
+
+    pool_destroy(&pool);
+  }
+}
+
+TEST(test_iter_free_while_walking) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.flags = POOL_FLAG_OCCUPANCY;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 16, &cfg), POOL_OK);
+
+  size_t capacity = pool_capacity(&pool);
+  for (size_t i = 0; i < capacity; i++) {
+    uint32_t *v = (uint32_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(v);
+    *v = (uint32_t)i;
+  }
+
+  // the walk sees every slot once, and may free the slot it is on
+  pool_iter_t it;
+  ASSERT_EQ(pool_iter_init(&it, &pool), POOL_OK);
+  size_t visited = 0;
+  for (uint32_t *v; (v = (uint32_t *)pool_iter_next(&it)) != NULL;) {
+    ASSERT_EQ(*v, visited);
+    if (visited % 2 == 0) pool_free(&pool, v);
+    visited++;
+  }
+  ASSERT_EQ(visited, capacity);
+  ASSERT_NULL(pool_iter_next(&it));
+  ASSERT_EQ(pool_used(&pool), capacity / 2);
+
+  ASSERT_EQ(pool_iter_init(&it, &pool), POOL_OK);
+  visited = 0;
+  for (uint32_t *v; (v = (uint32_t *)pool_iter_next(&it)) != NULL;) {
+    ASSERT_EQ(*v % 2, 1);
+    visited++;
+  }
+  ASSERT_EQ(visited, capacity / 2);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
+
+TEST(test_iter_requires_occupancy) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  pool_iter_t it;
+  ASSERT_EQ(pool_iter_init(&it, &pool), POOL_ERR_UNSUPPORTED);
+  ASSERT_NULL(pool_iter_next(&it));
+  ASSERT_EQ(pool_foreach_allocated(&pool, collect_slot, NULL), POOL_ERR_UNSUPPORTED);
+  ASSERT_EQ(pool_foreach_allocated(NULL, collect_slot, NULL), POOL_ERR_NULL_POOL);
+
+  pool_destroy(&pool);
+}
+
+#ifndef POOL_DEBUG
+TEST(test_occupancy_double_free) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.flags = POOL_FLAG_OCCUPANCY;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_OK);
+
+  void *a = pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, a), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, a), POOL_ERR_DOUBLE_FREE);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+}
+#endif
+
+static int handle_pool_init(pool_t *pool, void *buffer, size_t size, size_t slot_size) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.flags = POOL_FLAG_HANDLES;
+  return pool_init_ex(pool, buffer, size, slot_size, &cfg);
+}
+
+TEST(test_handle_basic) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(handle_pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+
+  pool_handle_t a = pool_alloc_handle(&pool);
+  pool_handle_t b = pool_alloc_handle(&pool);
+  ASSERT(a != POOL_HANDLE_NULL && b != POOL_HANDLE_NULL && a != b);
+
+  int *pa = (int *)pool_resolve(&pool, a);
+  ASSERT_NOT_NULL(pa);
+  ASSERT(pool_owns(&pool, pa));
+  ASSERT(pool_handle_of(&pool, pa) == a);
+  *pa = 42;
+  ASSERT_EQ(*(int *)pool_resolve(&pool, a), 42);
+
+  // once freed the handle is stale, even after the slot is reused
+  ASSERT_EQ(pool_free_handle(&pool, a), POOL_OK);
+  ASSERT_NULL(pool_resolve(&pool, a));
+  ASSERT_EQ(pool_free_handle(&pool, a), POOL_ERR_STALE_HANDLE);
+
+  scrub_frees(&pool);
+  pool_handle_t c = pool_alloc_handle(&pool);
+  ASSERT(pool_resolve(&pool, c) == (void *)pa);
+  ASSERT(c != a);
+  ASSERT_NULL(pool_resolve(&pool, a));
+
+  // freeing by pointer also retires the handle
+  void *pb = pool_resolve(&pool, b);
+  ASSERT_EQ(pool_free(&pool, pb), POOL_OK);
+  ASSERT_NULL(pool_resolve(&pool, b));
+
+  // garbage and out of range handles resolve to null
+  ASSERT_NULL(pool_resolve(&pool, POOL_HANDLE_NULL));
+  ASSERT_NULL(pool_resolve(&pool, 0xFFFFFFFFu));
+
+  pool_free_handle(&pool, c);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+
+TEST(test_handle_generation_wrap) {
+  uint8_t buffer[256];
+  pool_t pool;
+  ASSERT_EQ(handle_pool_init(&pool, buffer, sizeof(buffer), 16), POOL_OK);
+
+  // cycle one slot through every generation, handles are never null and
+  // never repeat until the generation space wraps
+  size_t generations = ((size_t)1 << (32 - POOL_HANDLE_INDEX_BITS)) - 1;
+  pool_handle_t first = pool_alloc_handle(&pool);
+  pool_handle_t prev = first;
+  ASSERT_EQ(pool_free_handle(&pool, first), POOL_OK);
+
+  for (size_t i = 1; i < generations; i++) {
+    scrub_frees(&pool);
+    pool_handle_t h = pool_alloc_handle(&pool);
+    ASSERT(h != POOL_HANDLE_NULL);
+    ASSERT(h != prev && h != first);
+    ASSERT_NULL(pool_resolve(&pool, prev));
+    ASSERT_EQ(pool_free_handle(&pool, h), POOL_OK);
+    prev = h;
+  }
+
+  scrub_frees(&pool);
+  ASSERT(pool_alloc_handle(&pool) == first);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
+
+TEST(test_handle_reset) {
+  uint8_t buffer[2048];
+  pool_t pool;
+  ASSERT_EQ(handle_pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+
+  pool_handle_t handles[8];
+  for (int i = 0; i < 8; i++) {
+    handles[i] = pool_alloc_handle(&pool);
+    ASSERT(handles[i] != POOL_HANDLE_NULL);
+  }
+
+  // reset invalidates every outstanding handle
+  pool_reset(&pool);
+  for (int i = 0; i < 8; i++) {
+    ASSERT_NULL(pool_resolve(&pool, handles[i]));
+  }
+
+  pool_handle_t h = pool_alloc_handle(&pool);
+  ASSERT_NOT_NULL(pool_resolve(&pool, h));
+  ASSERT(h != handles[0]);
+
+  pool_free_handle(&pool, h);
+  pool_destroy(&pool);
+}
+
+TEST(test_handle_errors) {
+  uint8_t buffer[1024];
+  pool_t pool;
+
+  // a pool without handles hands out none
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+  ASSERT_EQ(pool_alloc_handle(&pool), POOL_HANDLE_NULL);
+  ASSERT_EQ(pool_used(&pool), 0);
+  ASSERT_NULL(pool_resolve(&pool, 1u << POOL_HANDLE_INDEX_BITS));
+  ASSERT_EQ(pool_free_handle(&pool, 1u << POOL_HANDLE_INDEX_BITS), POOL_ERR_STALE_HANDLE);
+  pool_destroy(&pool);
+
+  ASSERT_EQ(pool_alloc_handle(NULL), POOL_HANDLE_NULL);
+  ASSERT_NULL(pool_resolve(NULL, 1));
+  ASSERT_EQ(pool_free_handle(NULL, 1), POOL_ERR_NULL_POOL);
+
+  // handles run out of index bits before the buffer does
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.flags = POOL_FLAG_HANDLES;
+  size_t max = (size_t)1 << POOL_HANDLE_INDEX_BITS;
+  ASSERT_EQ(pool_required_size_ex(1, max + 1, &cfg), 0);
+  ASSERT(pool_required_size_ex(1, max, &cfg) > 0);
+
+  size_t size = pool_required_size_ex(1, max, &cfg) + 4096;
+  uint8_t *big = (uint8_t *)malloc(size);
+  ASSERT_NOT_NULL(big);
+  ASSERT_EQ(pool_init_ex(&pool, big, size, 1, &cfg), POOL_OK);
+  ASSERT_EQ(pool_capacity(&pool), max);
+  pool_destroy(&pool);
+  free(big);
+}
+
+TEST(test_handle_bitmap_engine) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.flags = POOL_FLAG_HANDLES;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 4, &cfg), POOL_OK);
+
+  pool_handle_t h[4];
+  for (int i = 0; i < 4; i++) h[i] = pool_alloc_handle(&pool);
+
+  // bulk frees retire handles too
+  void *ptrs[2] = {pool_resolve(&pool, h[1]), pool_resolve(&pool, h[3])};
+  ASSERT_EQ(pool_free_bulk(&pool, ptrs, 2), POOL_OK);
+  ASSERT_NOT_NULL(pool_resolve(&pool, h[0]));
+  ASSERT_NULL(pool_resolve(&pool, h[1]));
+  ASSERT_NOT_NULL(pool_resolve(&pool, h[2]));
+  ASSERT_NULL(pool_resolve(&pool, h[3]));
+
+  pool_free_handle(&pool, h[0]);
+  pool_free_handle(&pool, h[2]);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+
+TEST(test_compact_moves_objects) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.flags = POOL_FLAG_RELOCATABLE;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 64, 1000, &cfg), POOL_OK);
+  size_t slot_size = pool_slot_size(&pool);
+
+  pool_handle_t handles[1000];
+  for (size_t i = 0; i < 1000; i++) {
+    handles[i] = pool_alloc_handle(&pool);
+    ASSERT(handles[i] != POOL_HANDLE_NULL);
+    *(size_t *)pool_resolve(&pool, handles[i]) = i;
+  }
+
+  // keep every tenth object, the survivors are spread over the whole buffer
+  for (size_t i = 0; i < 1000; i++) {
+    if (i % 10 != 0) ASSERT_EQ(pool_free_handle(&pool, handles[i]), POOL_OK);
+  }
+  ASSERT_EQ(pool_used(&pool), 100);
+
+  size_t moved = pool_compact(&pool, 0);
+  ASSERT(moved > 0 && moved < 100);
+  ASSERT_EQ(pool_used(&pool), 100);
+  ASSERT_EQ(pool_compact(&pool, 0), 0);
+
+  // handles follow their objects, which now fill the first 100 slots
+  uint8_t *low = NULL;
+  uint8_t *high = NULL;
+  for (size_t i = 0; i < 1000; i++) {
+    uint8_t *p = (uint8_t *)pool_resolve(&pool, handles[i]);
+    if (i % 10 != 0) {
+      ASSERT_NULL(p);
+      continue;
+    }
+    ASSERT_NOT_NULL(p);
+    ASSERT_EQ(*(size_t *)p, i);
+    ASSERT(pool_handle_of(&pool, p) == handles[i]);
+    if (low == NULL || p < low) low = p;
+    if (high == NULL || p > high) high = p;
+  }
+  ASSERT_EQ((size_t)(high - low), 99 * slot_size);
+
+  // the next allocation lands right after the packed block
+  pool_handle_t h = pool_alloc_handle(&pool);
+  ASSERT((uint8_t *)pool_resolve(&pool, h) == high + slot_size);
+  pool_free_handle(&pool, h);
+
+  for (size_t i = 0; i < 1000; i += 10) {
+    ASSERT_EQ(pool_free_handle(&pool, handles[i]), POOL_OK);
+  }
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_compact_budget) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.flags = POOL_FLAG_RELOCATABLE;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 32, 512, &cfg), POOL_OK);
+
+  pool_handle_t handles[512];
+  size_t capacity = pool_capacity(&pool);
+  size_t n = capacity < 512 ? capacity : 512;
+  for (size_t i = 0; i < n; i++) {
+    handles[i] = pool_alloc_handle(&pool);
+    *(uint32_t *)pool_resolve(&pool, handles[i]) = (uint32_t)i * 3;
+  }
+  for (size_t i = 0; i < n / 2; i++) {
+    pool_free_handle(&pool, handles[i]);
+  }
+
+  // a small budget spreads the work over several calls
+  size_t total = 0;
+  size_t calls = 0;
+  for (;;) {
+    size_t moved = pool_compact(&pool, 7);
+    ASSERT(moved <= 7);
+    calls++;
+    if (moved == 0) break;
+    total += moved;
+  }
+  ASSERT(calls > 2);
+  ASSERT(total <= n - n / 2);
+
+  for (size_t i = n / 2; i < n; i++) {
+    uint32_t *v = (uint32_t *)pool_resolve(&pool, handles[i]);
+    ASSERT_NOT_NULL(v);
+    ASSERT_EQ(*v, (uint32_t)i * 3);
+  }
+
+  // slots above the packed block were released, they still allocate fine
+  void *slots[512];
+  size_t got = pool_alloc_bulk_partial(&pool, slots, 512);
+  ASSERT_EQ(got, capacity - (n - n / 2));
+  for (size_t i = 0; i < got; i++) memset(slots[i], 0x5A, 32);
+  ASSERT(pool_is_full(&pool));
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_compact_errors) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  // relocation needs the bitmap engine
+  cfg.flags = POOL_FLAG_RELOCATABLE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_ERR_INVALID_CONFIG);
+
+  // plain handle pools never move anything
+  cfg.flags = POOL_FLAG_HANDLES;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 32, &cfg), POOL_OK);
+  pool_handle_t a = pool_alloc_handle(&pool);
+  pool_handle_t b = pool_alloc_handle(&pool);
+  pool_free_handle(&pool, a);
+  ASSERT_EQ(pool_compact(&pool, 0), 0);
+  pool_free_handle(&pool, b);
+  pool_destroy(&pool);
+
+  ASSERT_EQ(pool_compact(NULL, 0), 0);
+}
+
+static size_t page_number(const void *ptr) {
+  return (size_t)((uintptr_t)ptr / POOL_PAGE_SIZE);
+}
+
+TEST(test_reuse_address_order) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.reuse = POOL_REUSE_ADDRESS;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 4, 16, &cfg), POOL_OK);
+
+  // the freelist engine's slot size rules still apply
+  ASSERT(pool_slot_size(&pool) >= sizeof(void *));
+  ASSERT(pool_capacity(&pool) >= 16);
+
+  uint8_t *slots[16];
+  for (int i = 0; i < 16; i++) slots[i] = (uint8_t *)pool_alloc(&pool);
+
+  int freed[] = {9, 3, 12, 0, 7};
+  for (int i = 0; i < 5; i++) ASSERT_EQ(pool_free(&pool, slots[freed[i]]), POOL_OK);
+
+  int expected[] = {0, 3, 7, 9, 12};
+  for (int i = 0; i < 5; i++) ASSERT(pool_alloc(&pool) == slots[expected[i]]);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_reuse_page_affinity) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.reuse = POOL_REUSE_PAGE;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 64, 256, &cfg), POOL_OK);
+
+  size_t count = pool_capacity(&pool);
+  ASSERT(count >= 256);
+  void **slots = (void **)malloc(count * sizeof(void *));
+  for (size_t i = 0; i < count; i++) {
+    slots[i] = pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+  }
+  ASSERT_NULL(pool_alloc(&pool));
+
+  size_t page_b = page_number(slots[170]);
+  size_t page_c = page_number(slots[30]);
+
+  // page c empties out, page b keeps most of its slots free, page a just one
+  size_t c_free = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (page_number(slots[i]) == page_c) {
+      pool_free(&pool, slots[i]);
+      c_free++;
+    }
+  }
+  size_t b_free = 0;
+  for (size_t i = 0; i < count && b_free < 10; i++) {
+    if (page_number(slots[i]) == page_b) {
+      pool_free(&pool, slots[i]);
+      b_free++;
+    }
+  }
+  void *a_slot = slots[100];
+  pool_free(&pool, a_slot);
+  ASSERT(c_free > b_free);
+
+  // the fullest page first, the empty one last
+  scrub_frees(&pool);
+  ASSERT(pool_alloc(&pool) == a_slot);
+  for (size_t i = 0; i < b_free; i++) ASSERT_EQ(page_number(pool_alloc(&pool)), page_b);
+  for (size_t i = 0; i < c_free; i++) ASSERT_EQ(page_number(pool_alloc(&pool)), page_c);
+  ASSERT_NULL(pool_alloc(&pool));
+
+  free(slots);
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_reuse_page_bulk_and_reset) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.reuse = POOL_REUSE_PAGE;
+  cfg.flags = POOL_FLAG_OCCUPANCY;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 48, 300, &cfg), POOL_OK);
+
+  cfg.flags = 0;
+  ASSERT(pool_required_size_ex(48, 300, &cfg) > pool_required_size(48, 300));
+
+  size_t count = pool_capacity(&pool);
+  void **slots = (void **)malloc(count * sizeof(void *));
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, count), count);
+  ASSERT(pool_is_full(&pool));
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots, count), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+  ASSERT_EQ(pool_alloc_bulk_partial(&pool, slots, count + 5), count);
+  ASSERT_EQ(pool_free_bulk_partial(&pool, slots, count), count);
+
+  for (size_t i = 0; i < count / 2; i++) ASSERT_NOT_NULL(pool_alloc(&pool));
+  pool_reset(&pool);
+  ASSERT(pool_is_empty(&pool));
+  for (size_t i = 0; i < count; i++) ASSERT_NOT_NULL(pool_alloc(&pool));
+  ASSERT_NULL(pool_alloc(&pool));
+
+  free(slots);
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_sort_free_list) {
+  pool_reuse_t reuses[] = {POOL_REUSE_LIFO, POOL_REUSE_LIFO, POOL_REUSE_PAGE};
+  unsigned flags[] = {0, POOL_FLAG_OCCUPANCY, 0};
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  for (int c = 0; c < 3; c++) {
+    cfg.reuse = reuses[c];
+    cfg.flags = flags[c];
+
+    pool_t pool;
+    uint8_t *buffer;
+    ASSERT_EQ(config_pool_init(&pool, &buffer, 32, 64, &cfg), POOL_OK);
+
+    uint8_t *slots[64];
+    for (int i = 0; i < 64; i++) slots[i] = (uint8_t *)pool_alloc(&pool);
+
+    // scramble the free order, leave a few live ones in between
+    for (int i = 0; i < 64; i++) {
+      int k = (i * 37) % 64;
+      if (k % 5 != 0) pool_free(&pool, slots[k]);
+    }
+    ASSERT_EQ(pool_sort_free_list(&pool), POOL_OK);
+
+    // ascending within the list (within each page for page reuse)
+    uint8_t *prev = (uint8_t *)pool_alloc(&pool);
+    for (size_t n = 1; n < 50; n++) {
+      uint8_t *next = (uint8_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(next);
+      ASSERT((int)((next - prev) % 32) == 0);
+      if (reuses[c] != POOL_REUSE_PAGE || page_number(next) == page_number(prev)) ASSERT(next > prev);
+      prev = next;
+    }
+
+    pool_reset(&pool);
+    pool_destroy(&pool);
+    free(buffer);
+  }
+
+  // address ordered pools have nothing to sort
+  cfg.reuse = POOL_REUSE_ADDRESS;
+  cfg.flags = 0;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 32, 8, &cfg), POOL_OK);
+  ASSERT_EQ(pool_sort_free_list(&pool), POOL_OK);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_alloc_near_page) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.reuse = POOL_REUSE_PAGE;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 64, 1024, &cfg), POOL_OK);
+
+  size_t count = pool_capacity(&pool);
+  ASSERT(count >= 1024);
+  void **slots = (void **)malloc(count * sizeof(void *));
+  for (size_t i = 0; i < count; i++) slots[i] = pool_alloc(&pool);
+
+  // a few slots on the hint's page, one on the next page, one far away
+  void *hint = slots[100];
+  size_t page = page_number(hint);
+  size_t own = 0, next = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (slots[i] != hint && page_number(slots[i]) == page && own < 3) {
+      pool_free(&pool, slots[i]);
+      own++;
+    } else if (page_number(slots[i]) == page + 1 && next < 1) {
+      pool_free(&pool, slots[i]);
+      next++;
+    }
+  }
+  void *far = slots[900];
+  pool_free(&pool, far);
+
+  for (size_t i = 0; i < own; i++) ASSERT_EQ(page_number(pool_alloc_near(&pool, hint)), page);
+  ASSERT_EQ(page_number(pool_alloc_near(&pool, (uint8_t *)hint + 5)), page + 1);
+
+  // nothing close is free, so it falls back to the normal path
+  ASSERT(pool_alloc_near(&pool, hint) == far);
+  ASSERT_NULL(pool_alloc_near(&pool, hint));
+
+  free(slots);
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+
+  // never used slots count as free on their page
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 64, 256, &cfg), POOL_OK);
+  void *first = pool_alloc(&pool);
+  void *child = pool_alloc_near(&pool, first);
+  ASSERT_NOT_NULL(child);
+  ASSERT(page_number(child) - page_number(first) <= 1);
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_alloc_near_bitmap) {
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  size_t size = pool_required_size_ex(32, 512, &cfg);
+  uint8_t *buffer = (uint8_t *)malloc(size);
+  ASSERT_EQ(pool_init_ex(&pool, buffer, size, 32, &cfg), POOL_OK);
+
+  uint8_t *slots[512];
+  for (int i = 0; i < 512; i++) slots[i] = (uint8_t *)pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, slots[5]), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, slots[100]), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, slots[150]), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, slots[300]), POOL_OK);
+
+  // closest free slot, not the lowest one
+  ASSERT(pool_alloc_near(&pool, slots[148]) == slots[150]);
+  ASSERT(pool_alloc_near(&pool, slots[6] + 3) == slots[5]);
+  ASSERT(pool_alloc_near(&pool, slots[400]) == slots[300]);
+  ASSERT_EQ(pool_available(&pool), 1);
+
+  // past POOL_NEAR_PAGES the lowest free slot comes back as usual
+  ASSERT(pool_alloc_near(&pool, slots[511]) == slots[100]);
+  ASSERT_NULL(pool_alloc_near(&pool, slots[511]));
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_alloc_run_bitmap) {
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  size_t size = pool_required_size_ex(16, 1000, &cfg);
+  uint8_t *buffer = (uint8_t *)malloc(size);
+  ASSERT_EQ(pool_init_ex(&pool, buffer, size, 16, &cfg), POOL_OK);
+  size_t count = pool_capacity(&pool);
+
+  uint8_t *slots[1000];
+  for (int i = 0; i < 1000; i++) slots[i] = (uint8_t *)pool_alloc(&pool);
+
+  // holes of 3 (inside a word), 70 (across two word edges) and 5
+  for (int i = 10; i < 13; i++) pool_free(&pool, slots[i]);
+  for (int i = 100; i < 170; i++) pool_free(&pool, slots[i]);
+  for (int i = 300; i < 305; i++) pool_free(&pool, slots[i]);
+
+  // first fit, the lowest hole big enough
+  ASSERT(pool_alloc_run(&pool, 3) == slots[10]);
+  ASSERT(pool_alloc_run(&pool, 4) == slots[100]);
+  ASSERT(pool_alloc_run(&pool, 66) == slots[104]);
+  ASSERT(pool_alloc_run(&pool, 5) == slots[300]);
+  ASSERT_NULL(pool_alloc_run(&pool, 2));
+  ASSERT_EQ(pool_used(&pool), 1000);
+
+  // the run frees as one, then serves single slots and longer runs again
+  ASSERT_EQ(pool_free_run(&pool, slots[104], 66), POOL_OK);
+  ASSERT(pool_alloc(&pool) == slots[104]);
+  uint8_t *run = (uint8_t *)pool_alloc_run(&pool, 65);
+  ASSERT(run == slots[105]);
+  for (size_t i = 0; i < 65; i++) memset(run + i * pool_slot_size(&pool), 0xAB, pool_slot_size(&pool));
+
+  // the never used tail is one long run, past the end there is none
+  size_t tail = count - 1000;
+  if (tail > 0) {
+    ASSERT(pool_alloc_run(&pool, tail) == slots[999] + pool_slot_size(&pool));
+    ASSERT_EQ(pool_free_run(&pool, slots[999] + pool_slot_size(&pool), tail), POOL_OK);
+  }
+  ASSERT_NULL(pool_alloc_run(&pool, tail + 1));
+
+  pool_reset(&pool);
+  ASSERT(pool_alloc_run(&pool, count) == slots[0]);
+  ASSERT(pool_is_full(&pool));
+  ASSERT_EQ(pool_free_run(&pool, slots[0], count), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_alloc_run_fresh) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+  size_t slot_size = pool_slot_size(&pool);
+
+  uint8_t *a = (uint8_t *)pool_alloc(&pool);
+  uint8_t *run = (uint8_t *)pool_alloc_run(&pool, 8);
+  ASSERT(run == a + slot_size);
+  ASSERT_EQ(pool_used(&pool), 9);
+
+  // freed runs go back slot by slot, front first
+  ASSERT_EQ(pool_free_run(&pool, run, 8), POOL_OK);
+  scrub_frees(&pool);
+  ASSERT(pool_alloc(&pool) == run);
+  ASSERT(pool_alloc(&pool) == run + slot_size);
+
+  // listed slots never form a run, the rest of the buffer does
+  size_t left = pool_capacity(&pool) - 9;
+  ASSERT_NULL(pool_alloc_run(&pool, left + 1));
+  ASSERT_NOT_NULL(pool_alloc_run(&pool, left));
+  ASSERT_NULL(pool_alloc_run(&pool, 2));
+  ASSERT_NOT_NULL(pool_alloc_run(&pool, 1));
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
+
+#ifndef POOL_DEBUG
+TEST(test_free_run_errors) {
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  uint8_t buffer[2048];
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 16, &cfg), POOL_OK);
+
+  uint8_t *run = (uint8_t *)pool_alloc_run(&pool, 4);
+  ASSERT_NOT_NULL(run);
+  ASSERT_NOT_NULL(pool_alloc(&pool));
+
+  // the sixth slot was never handed out, so none of the run is freed
+  ASSERT_EQ(pool_free_run(&pool, run, 6), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_used(&pool), 5);
+  ASSERT_EQ(pool_free_run(&pool, run + 1, 2), POOL_ERR_INVALID_PTR);
+  ASSERT_EQ(pool_free_run(&pool, NULL, 2), POOL_ERR_NULL_PTR);
+  ASSERT_EQ(pool_free_run(NULL, run, 2), POOL_ERR_NULL_POOL);
+  ASSERT_EQ(pool_free_run(&pool, run, 0), POOL_OK);
+  ASSERT_NULL(pool_alloc_run(&pool, 0));
+  ASSERT_NULL(pool_alloc_run(NULL, 4));
+
+  ASSERT_EQ(pool_free_run(&pool, run, 5), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+#endif
+
+TEST(test_stack_engine_lifo) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 4, 100, &cfg), POOL_OK);
+
+  // nothing lives in a free slot, so small slots stay small
+  ASSERT_EQ(pool_slot_size(&pool), 4);
+  ASSERT_EQ(pool_capacity(&pool), 100);
+  ASSERT(pool_required_size_ex(4, 100, &cfg) >= 100 * 4 + 100 * sizeof(uint32_t));
+
+  uint32_t *slots[100];
+  for (int i = 0; i < 100; i++) {
+    slots[i] = (uint32_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    *slots[i] = (uint32_t)i;
+  }
+  ASSERT_NULL(pool_alloc(&pool));
+
+  ASSERT_EQ(pool_free(&pool, slots[10]), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, slots[70]), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, slots[30]), POOL_OK);
+  ASSERT(pool_alloc(&pool) == slots[30]);
+  ASSERT(pool_alloc(&pool) == slots[70]);
+  ASSERT(pool_alloc(&pool) == slots[10]);
+
+  // neighbours kept their data
+  for (int i = 0; i < 100; i++) {
+    if (i != 10 && i != 30 && i != 70) ASSERT_EQ(*slots[i], (uint32_t)i);
+  }
+
+  pool_reset(&pool);
+  ASSERT(pool_is_empty(&pool));
+  ASSERT(pool_alloc(&pool) == slots[0]);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_stack_engine_bulk) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+  cfg.flags = POOL_FLAG_OCCUPANCY;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 48, 64, &cfg), POOL_OK);
+
+  void *batch[64];
+  ASSERT_EQ(pool_alloc_bulk(&pool, batch, 40), 40);
+  ASSERT_EQ(pool_free_bulk(&pool, batch + 10, 20), POOL_OK);
+  ASSERT_EQ(pool_used(&pool), 20);
+
+  // the spliced batch comes back in its own order, then the fresh slots
+  void *again[30];
+  ASSERT_EQ(pool_alloc_bulk(&pool, again, 30), 30);
+  for (int i = 0; i < 20; i++) ASSERT(again[i] == batch[10 + i]);
+  for (int i = 20; i < 30; i++) ASSERT((uint8_t *)again[i] == (uint8_t *)batch[39] + (i - 19) * pool_slot_size(&pool));
+
+  size_t live = 0;
+  pool_iter_t it;
+  ASSERT_EQ(pool_iter_init(&it, &pool), POOL_OK);
+  while (pool_iter_next(&it) != NULL) live++;
+  ASSERT_EQ(live, 50);
+
+  ASSERT_EQ(pool_alloc_bulk(&pool, batch, 15), 0);
+  ASSERT_EQ(pool_alloc_bulk_partial(&pool, batch, 15), 14);
+  ASSERT(pool_is_full(&pool));
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+#ifndef POOL_DEBUG
+TEST(test_stack_engine_double_free) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 16, 8, &cfg), POOL_OK);
+
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, a), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, b), POOL_OK);
+
+  // every handed out slot is back, one more push can only be a double free
+  ASSERT_EQ(pool_free(&pool, a), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_available(&pool), pool_capacity(&pool));
+
+  // a slot past the fresh cursor was never handed out
+  void *c = pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, (uint8_t *)c + 4 * pool_slot_size(&pool)), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_free(&pool, c), POOL_OK);
+
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_stack_engine_bulk_double_free) {
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, 16, 4, &cfg), POOL_OK);
+
+  // room on the stack for both, but a is listed twice
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  void *twice[3] = {a, b, a};
+  ASSERT_EQ(pool_free_bulk(&pool, twice, 3), POOL_ERR_DOUBLE_FREE);
+  void *thrice[3] = {a, a, a};
+  ASSERT_EQ(pool_free_bulk(&pool, thrice, 3), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_used(&pool), 2);
+
+  // the partial free keeps one copy
+  ASSERT_EQ(pool_free_bulk_partial(&pool, twice, 3), 2);
+  ASSERT_EQ(pool_used(&pool), 0);
+  void *x = pool_alloc(&pool);
+  void *y = pool_alloc(&pool);
+  ASSERT(x != y);
+
+  // a full pool has no room for more pushes than slots handed out
+  void *slots[4] = {x, y, pool_alloc(&pool), pool_alloc(&pool)};
+  void *many[8] = {x, x, x, x, x, x, x, x};
+  ASSERT_EQ(pool_free_bulk(&pool, many, 8), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_free_bulk_partial(&pool, many, 8), 1);
+  ASSERT_EQ(pool_free_bulk(&pool, slots + 1, 3), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_stack_engine_run_double_free) {
+  unsigned flags[] = {0, POOL_FLAG_OCCUPANCY};
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  for (int c = 0; c < 2; c++) {
+    cfg.flags = flags[c];
+
+    pool_t pool;
+    uint8_t *buffer;
+    ASSERT_EQ(config_pool_init(&pool, &buffer, 16, 10, &cfg), POOL_OK);
+    ASSERT_EQ(pool_capacity(&pool), 10);
+
+    uint8_t *p[10];
+    for (int i = 0; i < 10; i++) p[i] = (uint8_t *)pool_alloc(&pool);
+    for (int i = 0; i < 9; i++) ASSERT_EQ(pool_free(&pool, p[i]), POOL_OK);
+
+    // 7 and 8 are on the stack already, the push would overflow it
+    ASSERT_EQ(pool_free_run(&pool, p[7], 3), POOL_ERR_DOUBLE_FREE);
+    ASSERT_EQ(pool_available(&pool), 9);
+
+    // room for the run, but it overlaps a listed slot
+    for (int i = 0; i < 9; i++) ASSERT(pool_alloc(&pool) != NULL);
+    ASSERT_EQ(pool_free_run(&pool, p[0], 4), POOL_OK);
+    ASSERT_EQ(pool_free_run(&pool, p[3], 2), POOL_ERR_DOUBLE_FREE);
+    ASSERT_EQ(pool_available(&pool), 4);
+
+    // nothing was pushed twice, every slot comes back once
+    ASSERT_EQ(pool_free_run(&pool, p[4], 6), POOL_OK);
+    ASSERT(pool_is_empty(&pool));
+    uint8_t *again[10];
+    for (int i = 0; i < 10; i++) {
+      again[i] = (uint8_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(again[i]);
+      for (int j = 0; j < i; j++) ASSERT(again[i] != again[j]);
+    }
+    ASSERT_NULL(pool_alloc(&pool));
+
+    ASSERT_EQ(pool_free_run(&pool, p[0], 10), POOL_OK);
+    pool_destroy(&pool);
+    free(buffer);
+  }
+}
+#endif
+
+TEST(test_stack_engine_sort) {
+  unsigned flags[] = {0, POOL_FLAG_OCCUPANCY};
+
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  for (int c = 0; c < 2; c++) {
+    cfg.flags = flags[c];
+
+    pool_t pool;
+    uint8_t *buffer;
+    ASSERT_EQ(config_pool_init(&pool, &buffer, 32, 128, &cfg), POOL_OK);
+
+    uint8_t *slots[128];
+    for (int i = 0; i < 128; i++) slots[i] = (uint8_t *)pool_alloc(&pool);
+    for (int i = 0; i < 128; i++) {
+      int k = (i * 53) % 128;
+      if (k % 7 != 0) pool_free(&pool, slots[k]);
+    }
+    ASSERT_EQ(pool_sort_free_list(&pool), POOL_OK);
+
+    uint8_t *prev = (uint8_t *)pool_alloc(&pool);
+    size_t got = 1;
+    for (uint8_t *next; (next = (uint8_t *)pool_alloc(&pool)) != NULL; prev = next) {
+      ASSERT(next > prev);
+      got++;
+    }
+    ASSERT_EQ(got, 128 - 19);
+
+    pool_reset(&pool);
+    pool_destroy(&pool);
+    free(buffer);
+  }
+}
+
+typedef struct cached_conn {
+  uint32_t magic;
+  uint32_t state;
+  char    *buf;
+} cached_conn_t;
+
+typedef struct cache_counts {
+  int ctors;
+  int dtors;
+} cache_counts_t;
+
+static void conn_ctor(void *obj, void *ctx) {
+  cached_conn_t *c = (cached_conn_t *)obj;
+  c->magic = 0xC0DE;
+  c->state = 0;
+  c->buf = (char *)malloc(64);
+  ((cache_counts_t *)ctx)->ctors++;
+}
+
+static void conn_dtor(void *obj, void *ctx) {
+  cached_conn_t *c = (cached_conn_t *)obj;
+  ASSERT(c->magic == 0xC0DE);
+  free(c->buf);
+  c->magic = 0;
+  ((cache_counts_t *)ctx)->dtors++;
+}
+
+TEST(test_object_cache_state) {
+  pool_engine_t engines[2] = { POOL_ENGINE_STACK, POOL_ENGINE_BITMAP };
+
+  for (int e = 0; e < 2; e++) {
+    cache_counts_t counts = { 0, 0 };
+    pool_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.engine = engines[e];
+    cfg.ctor = conn_ctor;
+    cfg.dtor = conn_dtor;
+    cfg.cache_ctx = &counts;
+
+    pool_t pool;
+    uint8_t *buffer;
+    ASSERT_EQ(config_pool_init(&pool, &buffer, sizeof(cached_conn_t), 32, &cfg), POOL_OK);
+    ASSERT_EQ(counts.ctors, 0);
+
+    cached_conn_t *conns[32];
+    for (int i = 0; i < 32; i++) {
+      conns[i] = (cached_conn_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(conns[i]);
+      ASSERT(conns[i]->magic == 0xC0DE);
+      ASSERT_EQ(conns[i]->state, 0);
+      conns[i]->state = (uint32_t)i + 1;
+      conns[i]->buf[0] = (char)('a' + i % 26);
+    }
+    ASSERT_EQ(counts.ctors, 32);
+
+    // freed objects come back untouched, no ctor or dtor in between
+    for (int round = 0; round < 3; round++) {
+      for (int i = 0; i < 32; i += 2) ASSERT_EQ(pool_free(&pool, conns[i]), POOL_OK);
+      for (int i = 0; i < 32; i += 2) {
+        cached_conn_t *c = (cached_conn_t *)pool_alloc(&pool);
+        ASSERT_NOT_NULL(c);
+        ASSERT(c->magic == 0xC0DE);
+        size_t index = (size_t)(c - conns[0]);
+        ASSERT(index < 32 && c == conns[index]);
+        ASSERT_EQ(c->state, (uint32_t)index + 1);
+        ASSERT_EQ(c->buf[0], (char)('a' + index % 26));
+      }
+    }
+    ASSERT_EQ(counts.ctors, 32);
+    ASSERT_EQ(counts.dtors, 0);
+
+    // reset sends every object out of the cache, the next round constructs again
+    pool_reset(&pool);
+    ASSERT_EQ(counts.dtors, 32);
+    cached_conn_t *c = (cached_conn_t *)pool_alloc(&pool);
+    ASSERT(c->magic == 0xC0DE);
+    ASSERT_EQ(c->state, 0);
+    ASSERT_EQ(counts.ctors, 33);
+
+    ASSERT_EQ(pool_free(&pool, c), POOL_OK);
+    pool_destroy(&pool);
+    ASSERT_EQ(counts.dtors, 33);
+    free(buffer);
+  }
+}
+
+TEST(test_object_cache_skips_ahead) {
+  cache_counts_t counts = { 0, 0 };
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  cfg.ctor = conn_ctor;
+  cfg.dtor = conn_dtor;
+  cfg.cache_ctx = &counts;
+
+  pool_t pool;
+  uint8_t *buffer;
+  ASSERT_EQ(config_pool_init(&pool, &buffer, sizeof(cached_conn_t), 1000, &cfg), POOL_OK);
+
+  // a placement hint far into the pool constructs everything below it too
+  uint8_t *first = (uint8_t *)pool_alloc(&pool);
+  ASSERT_NOT_NULL(first);
+  cached_conn_t *far = (cached_conn_t *)pool_alloc_near(&pool, first + 900 * pool_slot_size(&pool));
+  ASSERT_NOT_NULL(far);
+  size_t index = (size_t)((uint8_t *)far - first) / pool_slot_size(&pool);
+  ASSERT(index > 1);
+  ASSERT_EQ(counts.ctors, (int)index + 1);
+
+  // the slots in between were constructed without being handed out
+  cached_conn_t *next = (cached_conn_t *)pool_alloc(&pool);
+  ASSERT(next == (cached_conn_t *)(first + pool_slot_size(&pool)));
+  ASSERT(next->magic == 0xC0DE);
+  ASSERT_EQ(counts.ctors, (int)index + 1);
+
+  // runs past the mark get constructed as well
+  cached_conn_t *run = (cached_conn_t *)pool_alloc_run(&pool, 8);
+  ASSERT_NOT_NULL(run);
+  for (int i = 0; i < 8; i++) ASSERT(run[i].magic == 0xC0DE);
+
+  pool_reset(&pool);
+  ASSERT_EQ(counts.dtors, counts.ctors);
+  pool_destroy(&pool);
+  ASSERT_EQ(counts.dtors, counts.ctors);
+  free(buffer);
+}
+
+TEST(test_object_cache_config) {
+  cache_counts_t counts = { 0, 0 };
+  uint8_t buffer[4096];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.ctor = conn_ctor;
+  cfg.dtor = conn_dtor;
+  cfg.cache_ctx = &counts;
+
+  // a free list link would overwrite the object
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), sizeof(cached_conn_t), &cfg), POOL_ERR_INVALID_CONFIG);
+  ASSERT_EQ(pool_required_size_ex(sizeof(cached_conn_t), 10, &cfg), 0);
+  cfg.reuse = POOL_REUSE_PAGE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), sizeof(cached_conn_t), &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.reuse = POOL_REUSE_ADDRESS;
+  cfg.flags = POOL_FLAG_RELOCATABLE;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), sizeof(cached_conn_t), &cfg), POOL_ERR_INVALID_CONFIG);
+
+  // address order runs on the bitmap index, which keeps out of the slots
+  cfg.flags = 0;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), sizeof(cached_conn_t), &cfg), POOL_OK);
+  void *p = pool_alloc(&pool);
+  ASSERT_NOT_NULL(p);
+  ASSERT_EQ(pool_free(&pool, p), POOL_OK);
+  pool_destroy(&pool);
+  ASSERT_EQ(counts.ctors, 1);
+  ASSERT_EQ(counts.dtors, 1);
+}
+
+#endif // POOL_CONCURRENT
+
+#ifdef POOL_DEBUG
+
+TEST(test_debug_double_free) {
+  uint8_t buffer[1024];
+  pool_t pool;
+
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  void *slot = pool_alloc(&pool);
+  ASSERT_NOT_NULL(slot);
+  ASSERT(pool_is_allocated(&pool, slot));
+
+  int err = pool_free(&pool, slot);
+  ASSERT_EQ(err, POOL_OK);
+  ASSERT(!pool_is_allocated(&pool, slot));
+
+  // actual double free triggers assert so we just verify state tracking here
+  pool_destroy(&pool);
+}
+
+TEST(test_debug_stats) {
+  uint8_t buffer[2048];
+  pool_t pool;
+
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  void *s1 = pool_alloc(&pool);
+  void *s2 = pool_alloc(&pool);
+  void *s3 = pool_alloc(&pool);
+  // peak is 3
+
+  pool_free(&pool, s1);
+  pool_free(&pool, s2);
+  // used is 1
+
+  void *s4 = pool_alloc(&pool);
+  void *s5 = pool_alloc(&pool);
+  // used is 3 peak still 3
+
+  pool_stats_t stats;
+  pool_stats(&pool, &stats);
+
+  ASSERT_EQ(stats.total_allocs, 5);
+  ASSERT_EQ(stats.total_frees, 2);
+  ASSERT_EQ(stats.peak_used, 3);
+  ASSERT_EQ(stats.used_count, 3);
+
+  pool_free(&pool, s3);
+  pool_free(&pool, s4);
+  pool_free(&pool, s5);
+
+  pool_destroy(&pool);
+}
+
+#endif // POOL_DEBUG
+
+#ifdef POOL_DYNAMIC
+
+TEST(test_dynamic_grows) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 48, &cfg), POOL_OK);
+
+  size_t first_capacity = pool_capacity(&pool);
+  ASSERT(first_capacity > 0);
+
+  // allocate well past a single chunk
+  size_t count = first_capacity * 10;
+  void **slots = (void **)malloc(count * sizeof(void *));
+  ASSERT_NOT_NULL(slots);
+
+  for (size_t i = 0; i < count; i++) {
+    slots[i] = pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    ASSERT(is_aligned(slots[i], POOL_ALIGN));
+    memset(slots[i], (int)(i & 0xFF), 48);
+  }
+
+  pool_stats_t stats;
+  pool_stats(&pool, &stats);
+  ASSERT(stats.chunk_count > 1);
+  ASSERT_EQ(stats.used_count, count);
+  ASSERT(pool_capacity(&pool) >= count);
+
+  // data survives growth
+  for (size_t i = 0; i < count; i++) {
+    ASSERT_EQ(((uint8_t *)slots[i])[47], i & 0xFF);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  }
+  ASSERT(pool_is_empty(&pool));
+
+  free(slots);
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_growth_policy) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+  cfg.growth = POOL_GROW_LINEAR;
+
+  pool_t linear;
+  ASSERT_EQ(pool_init_dynamic(&linear, 64, &cfg), POOL_OK);
+
+  cfg.growth = POOL_GROW_GEOMETRIC;
+  pool_t geometric;
+  ASSERT_EQ(pool_init_dynamic(&geometric, 64, &cfg), POOL_OK);
+
+  size_t per_chunk = pool_capacity(&linear);
+
+  // exhaust the first chunk, then trigger one growth step each time
+  pool_stats_t stats;
+  for (int step = 1; step <= 3; step++) {
+    while (!pool_is_full(&linear)) pool_alloc(&linear);
+    ASSERT_NOT_NULL(pool_alloc(&linear));
+    pool_stats(&linear, &stats);
+    ASSERT_EQ(stats.chunk_count, (size_t)step + 1);
+  }
+
+  // init took the first step of one chunk, geometric then adds 2, 4, 8
+  size_t expected = 1;
+  for (int step = 1; step <= 3; step++) {
+    while (!pool_is_full(&geometric)) pool_alloc(&geometric);
+    ASSERT_NOT_NULL(pool_alloc(&geometric));
+    expected += (size_t)1 << step;
+    pool_stats(&geometric, &stats);
+    ASSERT_EQ(stats.chunk_count, expected);
+    ASSERT_EQ(pool_capacity(&geometric), expected * per_chunk);
+  }
+
+  pool_reset(&linear);
+  pool_reset(&geometric);
+  pool_destroy(&linear);
+  pool_destroy(&geometric);
+}
+
+TEST(test_dynamic_owns) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 40, &cfg), POOL_OK);
+
+  void *first = pool_alloc(&pool);
+  while (!pool_is_full(&pool)) pool_alloc(&pool);
+  void *later = pool_alloc(&pool);
+  ASSERT_NOT_NULL(first);
+  ASSERT_NOT_NULL(later);
+
+  ASSERT(pool_owns(&pool, first));
+  ASSERT(pool_owns(&pool, later));
+  ASSERT(!pool_owns(&pool, (uint8_t *)later + 1));
+
+  // foreign memory, including stack and heap, is rejected without touching it
+  int local = 0;
+  ASSERT(!pool_owns(&pool, &local));
+  void *heap = calloc(1, 64);
+  ASSERT(!pool_owns(&pool, heap));
+#ifndef POOL_DEBUG
+  ASSERT_EQ(pool_free(&pool, &local), POOL_ERR_INVALID_PTR);
+#endif
+  free(heap);
+
+  pool_reset(&pool);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_max_slots) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+  cfg.max_slots = 100;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 64, &cfg), POOL_OK);
+
+  size_t got = 0;
+  while (pool_alloc(&pool) != NULL) got++;
+
+  // growth stops once max_slots is reached, a chunk is never split
+  ASSERT(got >= 100);
+  ASSERT(got < 100 + pool_capacity(&pool) / 2 + 64);
+  ASSERT_EQ(pool_available(&pool), 0);
+
+  pool_reset(&pool);
+  ASSERT_EQ(pool_available(&pool), got);
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_alignment_coloring) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+  cfg.alignment = 64;
+  cfg.color_step = 64;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 1000, &cfg), POOL_OK);
+  ASSERT_EQ(pool_slot_size(&pool), 1024);
+  size_t per_chunk = pool_capacity(&pool);
+  ASSERT(per_chunk > 0);
+
+  // never-used slots come out in chunk order, the first of each chunk sits one color further in
+  void *slots[4 * 8];
+  ASSERT(per_chunk <= 8);
+  size_t count = 4 * per_chunk;
+  for (size_t i = 0; i < count; i++) {
+    slots[i] = pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    ASSERT(is_aligned(slots[i], 64));
+  }
+  for (size_t c = 1; c < 4; c++) {
+    uintptr_t prev = (uintptr_t)slots[(c - 1) * per_chunk] & (cfg.chunk_size - 1);
+    uintptr_t cur = (uintptr_t)slots[c * per_chunk] & (cfg.chunk_size - 1);
+    ASSERT_EQ(cur, prev + 64);
+  }
+
+  for (size_t i = 0; i < count; i++) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  pool_destroy(&pool);
+
+  cfg.alignment = 24;
+  ASSERT_EQ(pool_init_dynamic(&pool, 64, &cfg), POOL_ERR_INVALID_ALIGNMENT);
+}
+
+TEST(test_dynamic_mmap_backing) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.backing = POOL_BACKING_MMAP;
+  cfg.chunk_size = 65536;
+
+  pool_t pool;
+  int err = pool_init_dynamic(&pool, 128, &cfg);
+  if (err == POOL_ERR_OUT_OF_MEMORY) return; // no anonymous mappings on this target
+  ASSERT_EQ(err, POOL_OK);
+
+  void *slots[2000];
+  for (int i = 0; i < 2000; i++) {
+    slots[i] = pool_alloc(&pool);
+    ASSERT_NOT_NULL(slots[i]);
+    memset(slots[i], 0x5A, 128);
+  }
+
+  pool_stats_t stats;
+  pool_stats(&pool, &stats);
+  ASSERT(stats.chunk_count > 1);
+
+  for (int i = 0; i < 2000; i++) {
+    ASSERT(pool_owns(&pool, slots[i]));
+    ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  }
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_bulk) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 64, &cfg), POOL_OK);
+
+  // a bulk request larger than the pool grows it first
+  size_t n = pool_capacity(&pool) * 5;
+  void **slots = (void **)malloc(n * sizeof(void *));
+  ASSERT_NOT_NULL(slots);
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, n), n);
+  ASSERT_EQ(pool_used(&pool), n);
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots, n), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+
+  free(slots);
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_alloc_run) {
+  pool_dynamic_config_t cfg = {0};
+  cfg.chunk_size = 4096;
+
+  pool_t pool;
+  ASSERT_EQ(pool_init_dynamic(&pool, 64, &cfg), POOL_OK);
+  size_t per = pool_capacity(&pool);
+  size_t slot_size = pool_slot_size(&pool);
+  ASSERT(per > 4);
+
+  uint8_t *a = (uint8_t *)pool_alloc_run(&pool, per - 2);
+  ASSERT_NOT_NULL(a);
+
+  // the tail is too short, the run comes from a new chunk
+  uint8_t *b = (uint8_t *)pool_alloc_run(&pool, 4);
+  ASSERT_NOT_NULL(b);
+  ASSERT(pool_capacity(&pool) > per);
+  for (size_t i = 0; i < 4; i++) ASSERT(pool_owns(&pool, b + i * slot_size));
+
+  // and the tail it skipped is still handed out
+  uint8_t *tail = a + (per - 2) * slot_size;
+  for (int i = 0; i < 2; i++) {
+    uint8_t *p = (uint8_t *)pool_alloc(&pool);
+    ASSERT(p == tail || p == tail + slot_size);
+  }
+  ASSERT_EQ(pool_used(&pool), per + 4);
+
+  // a run never spans chunks
+  ASSERT_NULL(pool_alloc_run(&pool, per + 1));
+
+  ASSERT_EQ(pool_free_run(&pool, a, per), POOL_OK);
+  ASSERT_EQ(pool_free_run(&pool, b, 4), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+
+  // with no room to grow the run fails and the tail stays free
+  cfg.max_slots = per;
+  ASSERT_EQ(pool_init_dynamic(&pool, 64, &cfg), POOL_OK);
+  a = (uint8_t *)pool_alloc_run(&pool, per - 2);
+  ASSERT_NOT_NULL(a);
+  ASSERT_NULL(pool_alloc_run(&pool, 4));
+  ASSERT_EQ(pool_available(&pool), 2);
+  ASSERT_NOT_NULL(pool_alloc_run(&pool, 2));
+
+  ASSERT_EQ(pool_free_run(&pool, a, per), POOL_OK);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+
+TEST(test_dynamic_config_errors) {
+  pool_t pool;
+  pool_dynamic_config_t cfg = {0};
+
+  cfg.chunk_size = 5000;
+  ASSERT_EQ(pool_init_dynamic(&pool, 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  ASSERT_EQ(pool_init_dynamic(NULL, 32, NULL), POOL_ERR_NULL_POOL);
+  ASSERT_EQ(pool_init_dynamic(&pool, 0, NULL), POOL_ERR_INVALID_SLOT_SIZE);
+
+  // slots larger than the chunk get a bigger chunk
+  cfg.chunk_size = 1024;
+  ASSERT_EQ(pool_init_dynamic(&pool, 3000, &cfg), POOL_OK);
+  void *big = pool_alloc(&pool);
+  ASSERT_NOT_NULL(big);
+  memset(big, 1, 3000);
+  pool_free(&pool, big);
+  pool_destroy(&pool);
+
+  // mapped chunks come in whole pages
+  cfg.backing = POOL_BACKING_MMAP;
+  ASSERT_EQ(pool_init_dynamic(&pool, 32, &cfg), POOL_ERR_INVALID_CONFIG);
+  cfg.chunk_size = 65536;
+  int err = pool_init_dynamic(&pool, 32, &cfg);
+  if (err != POOL_ERR_OUT_OF_MEMORY) { // no anonymous mappings on this target
+    ASSERT_EQ(err, POOL_OK);
+    pool_destroy(&pool);
+  }
+
+  // null config uses defaults
+  ASSERT_EQ(pool_init_dynamic(&pool, 32, NULL), POOL_OK);
+  ASSERT(pool_capacity(&pool) > 0);
+  pool_destroy(&pool);
+}
+
+#endif // POOL_DYNAMIC
+
+#ifdef POOL_CONCURRENT
+
+#define STRESS_THREADS 8
+#define STRESS_ROUNDS 20000
+#define STRESS_HELD 16
+
+typedef struct {
+  pool_t *pool;
+  uint32_t id;
+  size_t failures;
+  size_t corrupted;
+} stress_arg_t;
+
+static void *concurrent_worker(void *p) {
+  stress_arg_t *arg = (stress_arg_t *)p;
+  uint32_t *held[STRESS_HELD];
+  uint32_t seed = arg->id * 2654435761u + 1;
+
+  for (int round = 0; round < STRESS_ROUNDS; round++) {
+    // hold a random number of slots, stamp them, check nobody else did
+    int n = 1 + (int)((seed = seed * 1103515245u + 12345u) >> 16) % STRESS_HELD;
+    int got = 0;
+    for (int i = 0; i < n; i++) {
+      held[got] = (uint32_t *)pool_alloc(arg->pool);
+      if (held[got] == NULL) {
+        arg->failures++;
+        continue;
+      }
+      held[got][0] = arg->id;
+      held[got][1] = (uint32_t)round;
+      got++;
+    }
+    for (int i = 0; i < got; i++) {
+      if (held[i][0] != arg->id || held[i][1] != (uint32_t)round) arg->corrupted++;
+      pool_free(arg->pool, held[i]);
+    }
+  }
+  return NULL;
+}
+
+TEST(test_concurrent_stress) {
+  size_t slot_count = STRESS_THREADS * STRESS_HELD / 2; // force contention and exhaustion
+  size_t required = pool_required_size(16, slot_count);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, required, 16), POOL_OK);
+  size_t capacity = pool_capacity(&pool);
+
+  pthread_t threads[STRESS_THREADS];
+  stress_arg_t args[STRESS_THREADS];
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    args[i].pool = &pool;
+    args[i].id = (uint32_t)i + 1;
+    args[i].failures = 0;
+    args[i].corrupted = 0;
+    pthread_create(&threads[i], NULL, concurrent_worker, &args[i]);
+  }
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    ASSERT_EQ(args[i].corrupted, 0);
+  }
+
+  // once quiet the count is exact and every slot comes back exactly once
+  ASSERT_EQ(pool_available(&pool), capacity);
+  ASSERT(pool_is_empty(&pool));
+
+  uint8_t **all = (uint8_t **)malloc(capacity * sizeof(uint8_t *));
+  ASSERT_NOT_NULL(all);
+  for (size_t i = 0; i < capacity; i++) {
+    all[i] = (uint8_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(all[i]);
+    all[i][0] = 0;
+  }
+  ASSERT_NULL(pool_alloc(&pool));
+  for (size_t i = 0; i < capacity; i++) {
+    ASSERT_EQ(all[i][0], 0);
+    all[i][0] = 1;
+  }
+  for (size_t i = 0; i < capacity; i++) {
+    pool_free(&pool, all[i]);
+  }
+  ASSERT_EQ(pool_available(&pool), capacity);
+
+  free(all);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+static void *concurrent_bulk_worker(void *p) {
+  stress_arg_t *arg = (stress_arg_t *)p;
+  void *held[STRESS_HELD];
+
+  for (int round = 0; round < STRESS_ROUNDS; round++) {
+    size_t want = 1 + (size_t)(round % STRESS_HELD);
+    size_t got = (round & 1) ? pool_alloc_bulk(arg->pool, held, want)
+                             : pool_alloc_bulk_partial(arg->pool, held, want);
+    if (got == 0) arg->failures++;
+    for (size_t i = 0; i < got; i++) ((uint32_t *)held[i])[1] = arg->id;
+    for (size_t i = 0; i < got; i++) {
+      if (((uint32_t *)held[i])[1] != arg->id) arg->corrupted++;
+    }
+    pool_free_bulk(arg->pool, held, got);
+  }
+  return NULL;
+}
+
+TEST(test_concurrent_bulk) {
+  size_t slot_count = STRESS_THREADS * STRESS_HELD / 2;
+  size_t required = pool_required_size(16, slot_count);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, required, 16), POOL_OK);
+
+  pthread_t threads[STRESS_THREADS];
+  stress_arg_t args[STRESS_THREADS];
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    args[i].pool = &pool;
+    args[i].id = (uint32_t)i + 1;
+    args[i].failures = 0;
+    args[i].corrupted = 0;
+    pthread_create(&threads[i], NULL, concurrent_bulk_worker, &args[i]);
+  }
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    ASSERT_EQ(args[i].corrupted, 0);
+  }
+
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+#endif // POOL_CONCURRENT
+
+#ifdef POOL_MAGAZINES
+
+TEST(test_magazine_basic) {
+  size_t required = pool_required_size(32, 256);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, required, 32), POOL_OK);
+
+  pool_depot_t depot;
+  ASSERT_EQ(pool_depot_init(&depot, &pool, 0), POOL_OK);
+  ASSERT_EQ(depot.magazine_size, POOL_MAGAZINE_SIZE);
+  pool_depot_destroy(&depot);
+
+  ASSERT_EQ(pool_depot_init(&depot, &pool, 8), POOL_OK);
+
+  pool_cache_t cache;
+  pool_cache_init(&cache, &depot);
+
+  void *a = pool_cache_alloc(&cache);
+  void *b = pool_cache_alloc(&cache);
+  ASSERT_NOT_NULL(a);
+  ASSERT_NOT_NULL(b);
+  ASSERT(a != b);
+  ASSERT(pool_owns(&pool, a));
+
+  // the cache refills in batches, so the pool sees more than two slots in use
+  ASSERT(pool_used(&pool) >= 2);
+
+  // frees stay in the loaded magazine and come straight back
+  ASSERT_EQ(pool_cache_free(&cache, b), POOL_OK);
+  ASSERT(pool_cache_alloc(&cache) == b);
+
+  int local = 0;
+  ASSERT_EQ(pool_cache_free(&cache, &local), POOL_ERR_INVALID_PTR);
+  ASSERT_EQ(pool_cache_free(&cache, NULL), POOL_ERR_NULL_PTR);
+
+  pool_cache_free(&cache, a);
+  pool_cache_free(&cache, b);
+  pool_cache_flush(&cache);
+  pool_depot_destroy(&depot);
+
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_magazine_exchange) {
+  size_t required = pool_required_size(32, 256);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  pool_init(&pool, buffer, required, 32);
+
+  pool_depot_t depot;
+  pool_depot_init(&depot, &pool, 8);
+
+  pool_cache_t producer, consumer;
+  pool_cache_init(&producer, &depot);
+  pool_cache_init(&consumer, &depot);
+
+  void *slots[64];
+  for (int i = 0; i < 64; i++) {
+    slots[i] = pool_cache_alloc(&producer);
+    ASSERT_NOT_NULL(slots[i]);
+  }
+  for (int i = 0; i < 64; i++) {
+    ASSERT_EQ(pool_cache_free(&producer, slots[i]), POOL_OK);
+  }
+
+  // the producer keeps two magazines and pushes the rest to the depot as full ones
+  ASSERT(depot.full_count >= 5);
+
+  // the consumer is served from those magazines without touching the pool
+  size_t used_before = pool_used(&pool);
+  for (int i = 0; i < 32; i++) {
+    slots[i] = pool_cache_alloc(&consumer);
+    ASSERT_NOT_NULL(slots[i]);
+  }
+  ASSERT_EQ(pool_used(&pool), used_before);
+
+  for (int i = 0; i < 32; i++) {
+    pool_cache_free(&consumer, slots[i]);
+  }
+
+  pool_cache_flush(&producer);
+  pool_cache_flush(&consumer);
+  pool_depot_destroy(&depot);
+
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_magazine_exhaustion) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+  size_t capacity = pool_capacity(&pool);
+
+  pool_depot_t depot;
+  pool_depot_init(&depot, &pool, 4);
+
+  pool_cache_t cache;
+  pool_cache_init(&cache, &depot);
+
+  size_t got = 0;
+  void *slots[64];
+  while (got < 64 && (slots[got] = pool_cache_alloc(&cache)) != NULL) got++;
+  ASSERT_EQ(got, capacity);
+
+  for (size_t i = 0; i < got; i++) {
+    ASSERT_EQ(pool_cache_free(&cache, slots[i]), POOL_OK);
+  }
+
+  pool_cache_flush(&cache);
+  pool_depot_destroy(&depot);
+  ASSERT(pool_is_empty(&pool));
+  pool_destroy(&pool);
+}
+
+#define MAGAZINE_THREADS 4
+#define MAGAZINE_ROUNDS 50000
+
+typedef struct {
+  pool_depot_t *depot;
+  uint32_t id;
+  size_t corrupted;
+} magazine_arg_t;
+
+static void *magazine_worker(void *p) {
+  magazine_arg_t *arg = (magazine_arg_t *)p;
+  pool_cache_t cache;
+  pool_cache_init(&cache, arg->depot);
+
+  uint32_t *held[24];
+  int count = 0;
+  uint32_t seed = arg->id * 2654435761u + 7;
+
+  for (int round = 0; round < MAGAZINE_ROUNDS; round++) {
+    seed = seed * 1103515245u + 12345u;
+    if ((count < 24 && ((seed >> 16) & 1)) || count == 0) {
+      uint32_t *slot = (uint32_t *)pool_cache_alloc(&cache);
+      if (slot) {
+        slot[0] = arg->id;
+        held[count++] = slot;
+      }
+    } else {
+      uint32_t *slot = held[--count];
+      if (slot[0] != arg->id) arg->corrupted++;
+      pool_cache_free(&cache, slot);
+    }
+  }
+  while (count > 0) pool_cache_free(&cache, held[--count]);
+
+  pool_cache_flush(&cache);
+  return NULL;
+}
+
+TEST(test_magazine_threads) {
+  size_t required = pool_required_size(32, 1024);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  pool_init(&pool, buffer, required, 32);
+
+  pool_depot_t depot;
+  pool_depot_init(&depot, &pool, 16);
+
+  pthread_t threads[MAGAZINE_THREADS];
+  magazine_arg_t args[MAGAZINE_THREADS];
+  for (int i = 0; i < MAGAZINE_THREADS; i++) {
+    args[i].depot = &depot;
+    args[i].id = (uint32_t)i + 1;
+    args[i].corrupted = 0;
+    pthread_create(&threads[i], NULL, magazine_worker, &args[i]);
+  }
+  for (int i = 0; i < MAGAZINE_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    ASSERT_EQ(args[i].corrupted, 0);
+  }
+
+  pool_depot_destroy(&depot);
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+#endif // POOL_MAGAZINES
+
+#ifdef POOL_REMOTE_FREE
+
+TEST(test_remote_free_basic) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 32), POOL_OK);
+  size_t capacity = pool_capacity(&pool);
+
+  void *slots[256];
+  ASSERT(capacity <= 256);
+  for (size_t i = 0; i < capacity; i++) slots[i] = pool_alloc(&pool);
+
+  // remote frees stay on the queue until the owner needs them
+  for (size_t i = 0; i < 8; i++) ASSERT_EQ(pool_free_remote(&pool, slots[i]), POOL_OK);
+  ASSERT_EQ(pool_used(&pool), capacity);
+  ASSERT(pool_is_full(&pool));
+
+  // running dry drains the whole queue at once
+  void *p = pool_alloc(&pool);
+  ASSERT_NOT_NULL(p);
+  ASSERT_EQ(pool_used(&pool), capacity - 7);
+  ASSERT_EQ(pool_drain_remote(&pool), 0);
+
+  // bulk alloc drains when the batch does not fit
+  void *batch[8];
+  ASSERT_EQ(pool_free_remote(&pool, p), POOL_OK);
+  ASSERT_EQ(pool_alloc_bulk(&pool, batch, 7), 7);
+  ASSERT_EQ(pool_alloc_bulk(&pool, batch + 7, 1), 1);
+  ASSERT(pool_is_full(&pool));
+
+  ASSERT_EQ(pool_free_remote(&pool, NULL), POOL_ERR_NULL_PTR);
+  ASSERT_EQ(pool_free_remote(NULL, p), POOL_ERR_NULL_POOL);
+  uint64_t foreign[4];
+  ASSERT_EQ(pool_free_remote(&pool, foreign), POOL_ERR_INVALID_PTR);
+
+  // the owner can drain on its own schedule too
+  for (size_t i = 8; i < capacity; i++) ASSERT_EQ(pool_free_remote(&pool, slots[i]), POOL_OK);
+  ASSERT_EQ(pool_drain_remote(&pool), capacity - 8);
+
+  // destroy reclaims whatever is still queued
+  for (size_t i = 0; i < 8; i++) ASSERT_EQ(pool_free_remote(&pool, batch[i]), POOL_OK);
+  pool_destroy(&pool);
+}
+
+TEST(test_remote_free_unsupported) {
+  uint8_t buffer[1024];
+  pool_t pool;
+
+  // a slot smaller than a pointer can not hold the queue link
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 2), POOL_OK);
+  void *p = pool_alloc(&pool);
+  ASSERT_EQ(pool_free_remote(&pool, p), POOL_ERR_UNSUPPORTED);
+  ASSERT_EQ(pool_free(&pool, p), POOL_OK);
+  pool_destroy(&pool);
+}
+
+#define REMOTE_THREADS 4
+#define REMOTE_ROUNDS 200
+
+typedef struct {
+  pool_t *pool;
+  uint32_t **slots;
+  size_t count;
+  volatile int go;
+  size_t corrupted;
+} remote_arg_t;
+
+static void *remote_worker(void *p) {
+  remote_arg_t *arg = (remote_arg_t *)p;
+  while (!__atomic_load_n(&arg->go, __ATOMIC_ACQUIRE)) {
+  }
+  for (size_t i = 0; i < arg->count; i++) {
+    if (*arg->slots[i] != (uint32_t)i) arg->corrupted++;
+    if (pool_free_remote(arg->pool, arg->slots[i]) != POOL_OK) arg->corrupted++;
+  }
+  return NULL;
+}
+
+TEST(test_remote_free_threads) {
+  size_t count = 1024;
+  size_t required = pool_required_size(32, count);
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, required, 32), POOL_OK);
+  count = pool_capacity(&pool);
+
+  uint32_t **slots = (uint32_t **)malloc(count * sizeof(uint32_t *));
+  void **held = (void **)malloc(count * sizeof(void *));
+  size_t per = count / REMOTE_THREADS;
+
+  for (int round = 0; round < REMOTE_ROUNDS; round++) {
+    for (size_t i = 0; i < count; i++) {
+      slots[i] = (uint32_t *)pool_alloc(&pool);
+      ASSERT_NOT_NULL(slots[i]);
+      *slots[i] = (uint32_t)(i % per);
+    }
+
+    pthread_t threads[REMOTE_THREADS];
+    remote_arg_t args[REMOTE_THREADS];
+    for (int t = 0; t < REMOTE_THREADS; t++) {
+      args[t].pool = &pool;
+      args[t].slots = slots + (size_t)t * per;
+      args[t].count = per;
+      args[t].go = 0;
+      args[t].corrupted = 0;
+      pthread_create(&threads[t], NULL, remote_worker, &args[t]);
+    }
+    for (int t = 0; t < REMOTE_THREADS; t++) __atomic_store_n(&args[t].go, 1, __ATOMIC_RELEASE);
+
+    // the owner keeps allocating while the others free, it gets every slot back
+    size_t got = 0;
+    while (got < per * REMOTE_THREADS) {
+      void *p = pool_alloc(&pool);
+      if (p != NULL) held[got++] = p;
+    }
+
+    for (int t = 0; t < REMOTE_THREADS; t++) {
+      pthread_join(threads[t], NULL);
+      ASSERT_EQ(args[t].corrupted, 0);
+    }
+
+    ASSERT_EQ(pool_drain_remote(&pool), 0);
+    for (size_t i = 0; i < got; i++) ASSERT_EQ(pool_free(&pool, held[i]), POOL_OK);
+    for (size_t i = got; i < count; i++) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+    ASSERT(pool_is_empty(&pool));
+  }
+
+  pool_destroy(&pool);
+  free(held);
+  free(slots);
+  free(buffer);
+}
+
+#endif // POOL_REMOTE_FREE
+
+#ifdef POOL_DEFERRED_ZERO
+
+// a free slot keeps its link (and the hardened key) in the first two words.
+static bool zero_past_links(const void *slot, size_t size) {
+  const uint8_t *p = (const uint8_t *)slot;
+  for (size_t i = 2 * sizeof(void *); i < size; i++) {
+    if (p[i] != 0) return false;
+  }
+  return true;
+}
+
+TEST(test_deferred_zero_scrub) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 64), POOL_OK);
+
+  void *slots[8];
+  for (int i = 0; i < 8; i++) {
+    slots[i] = pool_alloc(&pool);
+    memset(slots[i], 0xAB, 64);
+  }
+  for (int i = 0; i < 8; i++) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+
+  // the free left the bytes alone, the slots are still free to the caller
+  ASSERT(!zero_past_links(slots[3], 64));
+  ASSERT(pool_is_empty(&pool));
+
+  ASSERT_EQ(pool_scrub(&pool, 3), 3);
+  ASSERT_EQ(pool_scrub(&pool, 0), 5);
+  ASSERT_EQ(pool_scrub(&pool, 0), 0);
+  for (int i = 0; i < 8; i++) ASSERT(zero_past_links(slots[i], 64));
+  ASSERT(pool_is_empty(&pool));
+
+  pool_destroy(&pool);
+}
+
+TEST(test_deferred_zero_alloc_takes_one) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 64), POOL_OK);
+  size_t capacity = pool_capacity(&pool);
+  size_t half = capacity / 2;
+
+  void *slots[64];
+  ASSERT(capacity <= 64 && half > 1);
+  for (size_t i = 0; i < half; i++) {
+    slots[i] = pool_alloc(&pool);
+    memset(slots[i], 0xCD, 64);
+  }
+  for (size_t i = 0; i < half; i++) ASSERT_EQ(pool_free(&pool, slots[i]), POOL_OK);
+  ASSERT_EQ(pool.dirty_count, half);
+
+  // never used slots go first, the backlog stays queued
+  for (size_t i = half; i < capacity; i++) {
+    slots[i] = pool_alloc(&pool);
+    ASSERT(slots[i] == (uint8_t *)slots[0] + i * pool_slot_size(&pool));
+  }
+  ASSERT_EQ(pool.dirty_count, half);
+
+  // with nothing clean left an alloc zeroes only the slot it returns, oldest first
+  for (size_t i = 0; i < half; i++) {
+    void *p = pool_alloc(&pool);
+    ASSERT(p == slots[i]);
+    ASSERT(zero_past_links(p, 64));
+    ASSERT_EQ(pool.dirty_count, half - 1 - i);
+    if (i + 1 < half) ASSERT(!zero_past_links(slots[i + 1], 64));
+  }
+  ASSERT_NULL(pool_alloc(&pool));
+
+  // bulk allocs take dirty slots the same way and leave the rest for the scrub
+  for (size_t i = 0; i < capacity; i++) memset(slots[i], 0xCD, 64);
+  ASSERT_EQ(pool_free_bulk(&pool, slots, capacity), POOL_OK);
+  ASSERT_EQ(pool_alloc_bulk(&pool, slots, 2), 2);
+  ASSERT(zero_past_links(slots[0], 64));
+  ASSERT(zero_past_links(slots[1], 64));
+  ASSERT_EQ(pool.dirty_count, capacity - 2);
+  ASSERT_EQ(pool_scrub(&pool, 0), capacity - 2);
+
+  ASSERT_EQ(pool_free_bulk(&pool, slots, 2), POOL_OK);
+  pool_destroy(&pool);
+}
+
+TEST(test_deferred_zero_reset) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  ASSERT_EQ(pool_init(&pool, buffer, sizeof(buffer), 64), POOL_OK);
+  size_t capacity = pool_capacity(&pool);
+
+  uint8_t *first = (uint8_t *)pool_alloc(&pool);
+  for (size_t i = 1; i < capacity; i++) ASSERT_NOT_NULL(pool_alloc(&pool));
+  memset(first, 0xEE, capacity * 64);
+
+  // reset touches nothing, the slots are zeroed as they come back out
+  pool_reset(&pool);
+  ASSERT_EQ(first[100], 0xEE);
+  uint8_t *p = (uint8_t *)pool_alloc(&pool);
+  ASSERT(p == first);
+  for (size_t i = 0; i < 64; i++) ASSERT_EQ(p[i], 0);
+  uint8_t *run = (uint8_t *)pool_alloc_run(&pool, 4);
+  ASSERT_NOT_NULL(run);
+  for (size_t i = 0; i < 4 * 64; i++) ASSERT_EQ(run[i], 0);
+
+  // or by a scrub, top down
+  ASSERT_EQ(pool_scrub(&pool, 2), 2);
+  ASSERT_EQ(first[(capacity - 1) * 64], 0);
+  ASSERT_EQ(first[(capacity - 3) * 64], 0xEE);
+  ASSERT_EQ(pool_scrub(&pool, 0), capacity - 7);
+  for (size_t i = 5 * 64; i < capacity * 64; i++) ASSERT_EQ(first[i], 0);
+
+  pool_reset(&pool);
+  pool_destroy(&pool);
+}
+
+#ifndef POOL_CONCURRENT
+TEST(test_deferred_zero_bitmap) {
+  uint8_t buffer[4096];
+  pool_t pool;
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_BITMAP;
+  ASSERT_EQ(pool_init_ex(&pool, buffer, sizeof(buffer), 64, &cfg), POOL_OK);
+
+  // the bitmap engine has no link to park a slot with, it zeroes on free
+  uint8_t *p = (uint8_t *)pool_alloc(&pool);
+  memset(p, 0x11, 64);
+  ASSERT_EQ(pool_free(&pool, p), POOL_OK);
+  for (size_t i = 0; i < 64; i++) ASSERT_EQ(p[i], 0);
+  ASSERT_EQ(pool_scrub(&pool, 0), 0);
+
+  pool_destroy(&pool);
+}
+#endif
+
+#endif // POOL_DEFERRED_ZERO
+
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+
+TEST(test_hardened_link_encoding) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  ASSERT_EQ(pool_free(&pool, a), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, b), POOL_OK);
+#ifdef POOL_DEFERRED_ZERO
+  pool_scrub(&pool, 0);
+#endif
+
+  // b links to a, stored xor b's page number
+  uintptr_t stored = *(uintptr_t *)b;
+  ASSERT_EQ(stored, (uintptr_t)a ^ ((uintptr_t)b >> 12));
+  ASSERT(stored != (uintptr_t)a);
+
+  ASSERT(pool_alloc(&pool) == b);
+  ASSERT(pool_alloc(&pool) == a);
+  ASSERT_EQ(hardened_reports, 0);
+
+  pool_destroy(&pool);
+}
+
+TEST(test_hardened_double_free) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  void *c = pool_alloc(&pool);
+  size_t available = pool_available(&pool);
+
+  // freeing the head again
+  ASSERT_EQ(pool_free(&pool, a), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, a), POOL_ERR_DOUBLE_FREE);
+
+  // freeing a slot deeper in the list, found through its key
+  ASSERT_EQ(pool_free(&pool, b), POOL_OK);
+  ASSERT_EQ(pool_free(&pool, a), POOL_ERR_DOUBLE_FREE);
+  ASSERT_EQ(pool_available(&pool), available + 2);
+
+  // user data that happens to hold the key is not a double free
+  ((uintptr_t *)c)[1] = pool.free_key;
+  ASSERT_EQ(pool_free(&pool, c), POOL_OK);
+
+  // the key is cleared on alloc
+  scrub_frees(&pool);
+  void *again = pool_alloc(&pool);
+  ASSERT(again == c);
+  ASSERT_EQ(((uintptr_t *)again)[1], 0);
+
+  pool_destroy(&pool);
+}
+
+TEST(test_hardened_corrupt_link) {
+  uint8_t buffer[1024];
+  pool_t pool;
+  pool_init(&pool, buffer, sizeof(buffer), 32);
+
+  void *a = pool_alloc(&pool);
+  void *b = pool_alloc(&pool);
+  pool_free(&pool, a);
+  pool_free(&pool, b);
+#ifdef POOL_DEFERRED_ZERO
+  pool_scrub(&pool, 0);
+#endif
+
+  // a use after free write over the link, even a null one, fails the check
+  uintptr_t saved = *(uintptr_t *)b;
+  *(uintptr_t *)b = 0;
+  hardened_reports = 0;
+  ASSERT_NULL(pool_alloc(&pool));
+  ASSERT_EQ(hardened_reports, 1);
+
+  // a link into the middle of a slot
+  *(uintptr_t *)b = ((uintptr_t)a + 8) ^ ((uintptr_t)b >> 12);
+  void *out[2];
+  ASSERT_EQ(pool_alloc_bulk_partial(&pool, out, 2), 0);
+  ASSERT_EQ(hardened_reports, 2);
+
+  // the broken link is left in place, restoring it recovers the pool
+  *(uintptr_t *)b = saved;
+  ASSERT(pool_alloc(&pool) == b);
+  ASSERT(pool_alloc(&pool) == a);
+  ASSERT_EQ(hardened_reports, 2);
+
+  pool_destroy(&pool);
+}
+
+#endif // POOL_HARDENED
+
+TEST(test_owns_odd_slot_sizes) {
+  size_t sizes[] = {24, 40, 48, 56, 72, 96, 200};
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t required = pool_required_size(sizes[s], 64);
+    uint8_t *buffer = (uint8_t *)malloc(required);
+    ASSERT_NOT_NULL(buffer);
+
+    pool_t pool;
+    ASSERT_EQ(pool_init(&pool, buffer, required, sizes[s]), POOL_OK);
+
+    size_t slot_size = pool_slot_size(&pool);
+    uint8_t *first = (uint8_t *)pool_alloc(&pool);
+    ASSERT_NOT_NULL(first);
+    pool_free(&pool, first);
+
+    // every slot start is owned, every interior byte is not
+    for (size_t i = 0; i < pool_capacity(&pool); i++) {
+      uint8_t *slot = first + i * slot_size;
+      ASSERT(pool_owns(&pool, slot));
+      for (size_t b = 1; b < slot_size; b++) {
+        ASSERT(!pool_owns(&pool, slot + b));
+      }
+    }
+    ASSERT(!pool_owns(&pool, first + pool_capacity(&pool) * slot_size));
+    ASSERT(!pool_owns(&pool, first - slot_size));
+
+    pool_destroy(&pool);
+    free(buffer);
+  }
+}
+
+typedef struct {
+  uint32_t id;
+  float pos[3];
+  uint64_t flags;
+} typed_obj_t;
+
+POOL_DEFINE(typed_objs, typed_obj_t, 40)
+POOL_DEFINE(typed_bytes, uint8_t, 5)
+
+TEST(test_define_alloc_free) {
+  typed_obj_t *objs[40];
+
+  ASSERT_EQ(sizeof(typed_objs_slot_t), sizeof(typed_obj_t));
+  ASSERT(sizeof(typed_bytes_slot_t) >= sizeof(void *));
+
+  for (size_t i = 0; i < 40; i++) {
+    objs[i] = typed_objs_alloc();
+    ASSERT_NOT_NULL(objs[i]);
+    ASSERT_EQ((uintptr_t)objs[i] % sizeof(uint64_t), 0);
+    objs[i]->id = (uint32_t)i;
+  }
+  ASSERT_NULL(typed_objs_alloc());
+
+  for (size_t i = 0; i < 40; i++) {
+    ASSERT_EQ(objs[i]->id, i);
+    ASSERT_EQ(typed_objs_free(objs[i]), POOL_OK);
+  }
+
+  // lifo, the last freed slot comes back first
+  typed_obj_t *again = typed_objs_alloc();
+  ASSERT(again == objs[39]);
+  ASSERT_EQ(typed_objs_free(again), POOL_OK);
+
+  // pools of tiny types still hold a free link per slot
+  uint8_t *bytes[5];
+  for (size_t i = 0; i < 5; i++) {
+    bytes[i] = typed_bytes_alloc();
+    ASSERT_NOT_NULL(bytes[i]);
+  }
+  ASSERT_NULL(typed_bytes_alloc());
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_EQ(typed_bytes_free(bytes[i]), POOL_OK);
+  }
+}
+
+TEST(test_define_owns_and_errors) {
+  typed_obj_t *obj = typed_objs_alloc();
+  ASSERT_NOT_NULL(obj);
+
+  typed_obj_t local;
+  ASSERT(typed_objs_owns(obj));
+  ASSERT(!typed_objs_owns((uint8_t *)obj + 4));
+  ASSERT(!typed_objs_owns(&local));
+  ASSERT(!typed_objs_owns(NULL));
+  ASSERT(!typed_bytes_owns(obj));
+
+  ASSERT_EQ(typed_objs_free(NULL), POOL_ERR_NULL_PTR);
+  ASSERT_EQ(typed_objs_free(&local), POOL_ERR_INVALID_PTR);
+  ASSERT_EQ(typed_objs_free((typed_obj_t *)(void *)((uint8_t *)obj + 8)), POOL_ERR_INVALID_PTR);
+  ASSERT_EQ(typed_objs_free(obj), POOL_OK);
+
+#ifdef POOL_DEBUG
+  ASSERT_EQ(typed_objs_free(obj), POOL_ERR_DOUBLE_FREE);
+#endif
+
+#ifdef POOL_ZERO_ON_ALLOC
+  obj = typed_objs_alloc();
+  ASSERT_NOT_NULL(obj);
+  ASSERT_EQ(obj->id, 0);
+  ASSERT_EQ(obj->flags, 0);
+  obj->id = 7;
+  obj->flags = 9;
+  ASSERT_EQ(typed_objs_free(obj), POOL_OK);
+  obj = typed_objs_alloc();
+  ASSERT_EQ(obj->flags, 0);
+  ASSERT_EQ(typed_objs_free(obj), POOL_OK);
+#endif
+}
+
+TEST(test_owns_perf) {
+  size_t slot_size = 48;
+  size_t slot_count = 10000;
+  size_t required = pool_required_size(slot_size, slot_count);
+
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  pool_init(&pool, buffer, required, slot_size);
+
+  size_t actual_count = pool_capacity(&pool);
+  void **slots = (void **)malloc(actual_count * sizeof(void *));
+  ASSERT_NOT_NULL(slots);
+  for (size_t i = 0; i < actual_count; i++) {
+    slots[i] = pool_alloc(&pool);
+  }
+
+  // the old check, volatile so the divisor is not folded into a constant
+  volatile size_t divisor = pool_slot_size(&pool);
+  const uint8_t *base = (const uint8_t *)pool.buffer;
+  size_t div_owned = 0;
+  size_t mul_owned = 0;
+  int rounds = 200;
+
+  clock_t start = clock();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < actual_count; i++) {
+      size_t offset = (size_t)((const uint8_t *)slots[i] - base);
+      div_owned += offset % divisor == 0 && offset / divisor < actual_count;
+    }
+  }
+  clock_t div_time = clock() - start;
+
+  start = clock();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < actual_count; i++) {
+      mul_owned += (size_t)pool_owns(&pool, slots[i]);
+    }
+  }
+  clock_t mul_time = clock() - start;
+
+  ASSERT_EQ(div_owned, mul_owned);
+  ASSERT_EQ(mul_owned, actual_count * (size_t)rounds);
+
+  // the free path the check sits on, free and alloc back every slot
+  int cycles = 50;
+  start = clock();
+  for (int r = 0; r < cycles; r++) {
+    for (size_t i = 0; i < actual_count; i++) {
+      if (pool_free(&pool, slots[i]) != POOL_OK) mul_owned = 0;
+    }
+    for (size_t i = 0; i < actual_count; i++) {
+      slots[i] = pool_alloc(&pool);
+    }
+  }
+  clock_t cycle_time = clock() - start;
+  ASSERT(mul_owned != 0);
+  ASSERT(pool_is_full(&pool));
+
+  double checks = (double)actual_count * rounds;
+  printf("(div %.2f ns, mul %.2f ns, free+alloc %.2f ns) ",
+         (double)div_time * 1e9 / CLOCKS_PER_SEC / checks,
+         (double)mul_time * 1e9 / CLOCKS_PER_SEC / checks,
+         (double)cycle_time * 1e9 / CLOCKS_PER_SEC / ((double)actual_count * cycles));
+
+  for (size_t i = 0; i < actual_count; i++) {
+    pool_free(&pool, slots[i]);
+  }
+
+  free(slots);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+TEST(test_stress_perf) {
+  size_t slot_size = 64;
+  size_t slot_count = 10000;
+  size_t required = pool_required_size(slot_size, slot_count);
+
+  uint8_t *buffer = (uint8_t *)malloc(required);
+  ASSERT_NOT_NULL(buffer);
+
+  pool_t pool;
+  pool_init(&pool, buffer, required, slot_size);
+
+  size_t actual_count = pool_capacity(&pool);
+  void **slots = (void **)malloc(actual_count * sizeof(void *));
+  ASSERT_NOT_NULL(slots);
+
+  clock_t start = clock();
+  for (size_t i = 0; i < actual_count; i++) {
+    slots[i] = pool_alloc(&pool);
+  }
+  clock_t alloc_time = clock() - start;
+
+  start = clock();
+  for (size_t i = 0; i < actual_count; i++) {
+    pool_free(&pool, slots[i]);
+  }
+  clock_t free_time = clock() - start;
+
+  // just ensure it didn't crash and actually did work
+  ASSERT(alloc_time >= 0);
+  ASSERT(free_time >= 0);
+
+  free(slots);
+  pool_destroy(&pool);
+  free(buffer);
+}
+
+#ifndef POOL_CONCURRENT
+// frees every slot in shuffled order, evicts the caches, then times popping them all again.
+static double cold_alloc_ns(pool_t *pool, void **slots, size_t count, uint8_t *scratch, size_t scratch_size) {
+  for (size_t i = 0; i < count; i++) slots[i] = pool_alloc(pool);
+
+  uint32_t seed = 12345;
+  for (size_t i = count - 1; i > 0; i--) {
+    seed = seed * 1664525u + 1013904223u;
+    size_t j = seed % (i + 1);
+    void *t = slots[i];
+    slots[i] = slots[j];
+    slots[j] = t;
+  }
+  for (size_t i = 0; i < count; i++) pool_free(pool, slots[i]);
+
+  for (size_t i = 0; i < scratch_size; i += 64) scratch[i]++;
+
+  clock_t start = clock();
+  for (size_t i = 0; i < count; i++) slots[i] = pool_alloc(pool);
+  clock_t elapsed = clock() - start;
+
+  for (size_t i = 0; i < count; i++) pool_free(pool, slots[i]);
+  return (double)elapsed * 1e9 / CLOCKS_PER_SEC / (double)count;
+}
+
+TEST(test_stack_engine_cold_perf) {
+  size_t count = (size_t)1 << 16;
+  size_t scratch_size = (size_t)32 << 20;
+  uint8_t *scratch = (uint8_t *)calloc(scratch_size, 1);
+  void **slots = (void **)malloc(count * sizeof(void *));
+  ASSERT_NOT_NULL(scratch);
+  ASSERT_NOT_NULL(slots);
+
+  // the embedded list loads its next link out of a cold slot on every pop,
+  // the index stack reads one dense array
+  pool_t list;
+  size_t list_size = pool_required_size(64, count);
+  uint8_t *list_buffer = (uint8_t *)malloc(list_size);
+  ASSERT_EQ(pool_init(&list, list_buffer, list_size, 64), POOL_OK);
+
+  pool_config_t cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.engine = POOL_ENGINE_STACK;
+
+  pool_t stack;
+  uint8_t *stack_buffer;
+  ASSERT_EQ(config_pool_init(&stack, &stack_buffer, 64, count, &cfg), POOL_OK);
+
+  double list_ns = 0;
+  double stack_ns = 0;
+  for (int r = 0; r < 3; r++) {
+    list_ns += cold_alloc_ns(&list, slots, count, scratch, scratch_size);
+    stack_ns += cold_alloc_ns(&stack, slots, count, scratch, scratch_size);
+  }
+  printf("(list %.2f ns, stack %.2f ns) ", list_ns / 3, stack_ns / 3);
+
+  ASSERT(pool_is_empty(&list));
+  ASSERT(pool_is_empty(&stack));
+
+  pool_destroy(&list);
+  pool_destroy(&stack);
+  free(list_buffer);
+  free(stack_buffer);
+  free(slots);
+  free(scratch);
+}
+#endif
+
+int main(void) {
+  printf("\n");
+  printf(" pool allocator tests \n");
+  printf("configuration:\n");
+#ifdef POOL_DEBUG
+  printf("   POOL_DEBUG: enabled\n");
+#else
+  printf("   POOL_DEBUG: disabled\n");
+#endif
+#ifdef POOL_DYNAMIC
+  printf("   POOL_DYNAMIC: enabled\n");
+#endif
+#ifdef POOL_CONCURRENT
+  printf("   POOL_CONCURRENT: enabled\n");
+#endif
+#ifdef POOL_MAGAZINES
+  printf("   POOL_MAGAZINES: enabled\n");
+#endif
+#ifdef POOL_HARDENED
+  printf("   POOL_HARDENED: enabled\n");
+#endif
+  printf("   Default alignment: %zu bytes\n", (size_t)POOL_ALIGN);
+
+  RUN_TEST(test_basic_alloc_free);
+  RUN_TEST(test_slot_size_honored);
+  RUN_TEST(test_alignment);
+  RUN_TEST(test_exhaust_pool);
+  RUN_TEST(test_free_reuse);
+  RUN_TEST(test_reset);
+  RUN_TEST(test_owns);
+  RUN_TEST(test_interleaved);
+
+  RUN_TEST(test_init_errors);
+  RUN_TEST(test_free_errors);
+
+  RUN_TEST(test_stats);
+
+  RUN_TEST(test_tiny_slots);
+  RUN_TEST(test_pool_alignment);
+  RUN_TEST(test_minimum_pool);
+  RUN_TEST(test_large_slots);
+  RUN_TEST(test_required_size);
+  RUN_TEST(test_error_strings);
+  RUN_TEST(test_null_pool_queries);
+
+  RUN_TEST(test_lazy_init_untouched);
+  RUN_TEST(test_alloc_near_fallback);
+  RUN_TEST(test_bulk_alloc_free);
+  RUN_TEST(test_bulk_all_or_nothing);
+#ifndef POOL_DEBUG
+  RUN_TEST(test_bulk_free_invalid);
+#endif
+
+  RUN_TEST(test_engine_config_errors);
+#ifndef POOL_CONCURRENT
+  RUN_TEST(test_bitmap_address_order);
+  RUN_TEST(test_bitmap_tiny_slots);
+  RUN_TEST(test_bitmap_many_slots);
+  RUN_TEST(test_bitmap_required_size);
+  RUN_TEST(test_bitmap_bulk);
+#ifndef POOL_DEBUG
+  RUN_TEST(test_bitmap_double_free);
+#endif
+  RUN_TEST(test_foreach_allocated);
+  RUN_TEST(test_iter_free_while_walking);
+  RUN_TEST(test_iter_requires_occupancy);
+#ifndef POOL_DEBUG
+  RUN_TEST(test_occupancy_double_free);
+#endif
+  RUN_TEST(test_handle_basic);
+  RUN_TEST(test_handle_generation_wrap);
+  RUN_TEST(test_handle_reset);
+  RUN_TEST(test_handle_errors);
+  RUN_TEST(test_handle_bitmap_engine);
+  RUN_TEST(test_compact_moves_objects);
+  RUN_TEST(test_compact_budget);
+  RUN_TEST(test_compact_errors);
+  RUN_TEST(test_reuse_address_order);
+  RUN_TEST(test_reuse_page_affinity);
+  RUN_TEST(test_reuse_page_bulk_and_reset);
+  RUN_TEST(test_sort_free_list);
+  RUN_TEST(test_alloc_near_page);
+  RUN_TEST(test_alloc_near_bitmap);
+  RUN_TEST(test_alloc_run_bitmap);
+  RUN_TEST(test_alloc_run_fresh);
+#ifndef POOL_DEBUG
+  RUN_TEST(test_free_run_errors);
+#endif
+  RUN_TEST(test_stack_engine_lifo);
+  RUN_TEST(test_stack_engine_bulk);
+#ifndef POOL_DEBUG
+  RUN_TEST(test_stack_engine_double_free);
+  RUN_TEST(test_stack_engine_bulk_double_free);
+  RUN_TEST(test_stack_engine_run_double_free);
+#endif
+  RUN_TEST(test_stack_engine_sort);
+  RUN_TEST(test_object_cache_state);
+  RUN_TEST(test_object_cache_skips_ahead);
+  RUN_TEST(test_object_cache_config);
+#endif
+
+#ifdef POOL_DEBUG
+  RUN_TEST(test_debug_double_free);
+  RUN_TEST(test_debug_stats);
+#endif
+
+#ifdef POOL_DYNAMIC
+  RUN_TEST(test_dynamic_grows);
+  RUN_TEST(test_dynamic_growth_policy);
+  RUN_TEST(test_dynamic_owns);
+  RUN_TEST(test_dynamic_max_slots);
+  RUN_TEST(test_dynamic_alignment_coloring);
+  RUN_TEST(test_dynamic_mmap_backing);
+  RUN_TEST(test_dynamic_bulk);
+  RUN_TEST(test_dynamic_alloc_run);
+  RUN_TEST(test_dynamic_config_errors);
+#endif
+
+#ifdef POOL_CONCURRENT
+  RUN_TEST(test_concurrent_stress);
+  RUN_TEST(test_concurrent_bulk);
+#endif
+
+#ifdef POOL_MAGAZINES
+  RUN_TEST(test_magazine_basic);
+  RUN_TEST(test_magazine_exchange);
+  RUN_TEST(test_magazine_exhaustion);
+  RUN_TEST(test_magazine_threads);
+#endif
+
+#ifdef POOL_REMOTE_FREE
+  RUN_TEST(test_remote_free_basic);
+  RUN_TEST(test_remote_free_unsupported);
+  RUN_TEST(test_remote_free_threads);
+#endif
+
+#ifdef POOL_DEFERRED_ZERO
+  RUN_TEST(test_deferred_zero_scrub);
+  RUN_TEST(test_deferred_zero_alloc_takes_one);
+  RUN_TEST(test_deferred_zero_reset);
+  RUN_TEST(test_deferred_zero_bitmap);
+#endif
+
+#if defined(POOL_HARDENED) && !defined(POOL_DEBUG)
+  RUN_TEST(test_hardened_link_encoding);
+  RUN_TEST(test_hardened_double_free);
+  RUN_TEST(test_hardened_corrupt_link);
+#endif
+
+  RUN_TEST(test_owns_odd_slot_sizes);
+  RUN_TEST(test_define_alloc_free);
+  RUN_TEST(test_define_owns_and_errors);
+  RUN_TEST(test_owns_perf);
+  RUN_TEST(test_stress_perf);
+#ifndef POOL_CONCURRENT
+  RUN_TEST(test_stack_engine_cold_perf);
+#endif
 
   printf("    %d/%d tests passed\n", tests_passed, tests_run);
   if (tests_failed > 0) {
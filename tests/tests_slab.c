@@ -6,8 +6,17 @@
  *
  *   # with debug features
  *   gcc -Wall -Wextra -DSLAB_DEBUG -O2 -o tests_slab_debug tests_slab.c && ./tests_slab_debug
+ *
+ *   # hardened free lists
+ *   gcc -Wall -Wextra -DSLAB_HARDENED -O2 -o tests_slab_hardened tests_slab.c && ./tests_slab_hardened
  */
 
+#ifdef SLAB_HARDENED
+// count reports instead of aborting so the hardening tests can see them
+static int hardened_reports = 0;
+#define SLAB_ASSERT(x) ((x) ? (void)0 : (void)hardened_reports++)
+#endif
+
 #define SLAB_IMPLEMENTATION
 #include "../slab.h"
 
@@ -596,6 +605,116 @@ TEST(test_slab_owns) {
     slab_destroy(&slab);
 }
 
+TEST(test_free_odd_slot_sizes) {
+    uint8_t buffer[16384];
+    size_t sizes[] = {24, 40, 72, 200};
+    slab_t slab;
+    void *ptrs[512];
+    size_t c, i, n;
+
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, sizeof(buffer), sizes, 4), SLAB_OK);
+
+    // every slot of a non power of two class passes free validation
+    for (c = 0; c < slab_class_count(&slab); c++) {
+        size_t size = slab_class_slot_size(&slab, c);
+        slab_class_stats_t before = slab_class_stats(&slab, c);
+
+        n = 0;
+        while (n < 512 && (ptrs[n] = slab_alloc(&slab, size)) != NULL) n++;
+        ASSERT(n > 1);
+        ASSERT_EQ((size_t)((uint8_t *)ptrs[1] - (uint8_t *)ptrs[0]), size);
+
+        for (i = 0; i < n; i++) {
+            ASSERT_EQ(slab_usable_size(&slab, ptrs[i]), size);
+            slab_free(&slab, ptrs[i]);
+        }
+        ASSERT_EQ(slab_class_stats(&slab, c).free_slots, before.free_slots);
+    }
+
+    slab_destroy(&slab);
+}
+
+TEST(test_tiny_classes) {
+    uint8_t buffer[4096];
+    size_t sizes[] = {1, 3, 32};
+    size_t expected[] = {2, 4, 32};
+    slab_t slab;
+    uint16_t *small[700];
+    uint32_t *mid[400];
+    size_t i, n, m;
+
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, sizeof(buffer), sizes, 3), SLAB_OK);
+    for (i = 0; i < 3; i++) {
+        ASSERT_EQ(slab_class_slot_size(&slab, i), expected[i]);
+    }
+
+    // tiny slots are packed back to back and keep the data written into them
+    n = 0;
+    while (n < 700 && (small[n] = (uint16_t *)slab_alloc(&slab, 1)) != NULL) {
+        ASSERT(is_aligned(small[n], 2));
+        *small[n] = (uint16_t)n;
+        n++;
+    }
+    m = 0;
+    while (m < 400 && (mid[m] = (uint32_t *)slab_alloc(&slab, 4)) != NULL) {
+        ASSERT(is_aligned(mid[m], 4));
+        *mid[m] = (uint32_t)m * 7;
+        m++;
+    }
+    ASSERT_EQ(n, slab_class_stats(&slab, 0).total_slots);
+    ASSERT_EQ(m, slab_class_stats(&slab, 1).total_slots);
+    ASSERT(n > 600);
+    ASSERT_EQ((size_t)((uint8_t *)small[1] - (uint8_t *)small[0]), 2);
+
+    for (i = 0; i < n; i++) ASSERT_EQ(*small[i], (uint16_t)i);
+    for (i = 0; i < m; i++) ASSERT_EQ(*mid[i], (uint32_t)i * 7);
+
+    // index links come back lifo like pointer links
+    slab_free(&slab, small[10]);
+    slab_free(&slab, small[500]);
+    slab_free(&slab, mid[3]);
+    slab_free(&slab, mid[300]);
+    ASSERT(slab_alloc(&slab, 2) == small[500]);
+    ASSERT(slab_alloc(&slab, 2) == small[10]);
+    ASSERT(slab_alloc(&slab, 3) == mid[300]);
+    ASSERT(slab_alloc(&slab, 3) == mid[3]);
+    ASSERT_NULL(slab_alloc(&slab, 2));
+
+    for (i = 0; i < n; i++) slab_free(&slab, small[i]);
+    for (i = 0; i < m; i++) slab_free(&slab, mid[i]);
+    ASSERT_EQ(slab_stats(&slab).used_slots, 0);
+
+    slab_destroy(&slab);
+}
+
+TEST(test_tiny_class_limits) {
+    size_t sizes[] = {2};
+    size_t needed = slab_buffer_size_needed(sizes, 1, 1000);
+    uint8_t *buffer;
+    slab_t slab;
+    void *ptr;
+
+    // 1000 two byte slots need about 2000 bytes, not 1000 pointers
+    ASSERT(needed >= 2000);
+    ASSERT(needed < 1000 * sizeof(void *));
+
+    // a region past 16-bit links gets 4 byte slots
+    buffer = (uint8_t *)malloc(256 * 1024);
+    ASSERT_NOT_NULL(buffer);
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, 256 * 1024, sizes, 1), SLAB_OK);
+    ASSERT_EQ(slab_class_slot_size(&slab, 0), 4);
+    ptr = slab_alloc(&slab, 2);
+    ASSERT_NOT_NULL(ptr);
+    slab_free(&slab, ptr);
+    slab_destroy(&slab);
+    free(buffer);
+
+    ASSERT(slab_buffer_size_needed(sizes, 1, 70000) >= 70000 * 4);
+}
+
 TEST(test_alignment_all_classes) {
     uint8_t buffer[16384];
     size_t sizes[] = {17, 33, 65, 129, 257}; // non-aligned sizes
@@ -1069,6 +1188,98 @@ TEST(test_debug_poison_check) {
 
 #endif /* SLAB_DEBUG */
 
+#ifdef SLAB_HARDENED
+
+TEST(test_hardened_link_encoding) {
+    uint8_t buffer[4096];
+    size_t sizes[] = {32};
+    slab_t slab;
+    void *a, *b;
+    uintptr_t stored;
+
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, sizeof(buffer), sizes, 1), SLAB_OK);
+
+    a = slab_alloc(&slab, 32);
+    b = slab_alloc(&slab, 32);
+    slab_free(&slab, a);
+    slab_free(&slab, b);
+
+    // b links to a, stored xor b's page number
+    stored = *(uintptr_t *)b;
+    ASSERT_EQ(stored, (uintptr_t)a ^ ((uintptr_t)b >> 12));
+
+    ASSERT(slab_alloc(&slab, 32) == b);
+    ASSERT(slab_alloc(&slab, 32) == a);
+    ASSERT_EQ(hardened_reports, 0);
+
+    slab_destroy(&slab);
+}
+
+TEST(test_hardened_double_free) {
+    uint8_t buffer[4096];
+    size_t sizes[] = {32};
+    slab_t slab;
+    void *a, *b;
+    size_t free_slots;
+
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, sizeof(buffer), sizes, 1), SLAB_OK);
+
+    a = slab_alloc(&slab, 32);
+    b = slab_alloc(&slab, 32);
+    free_slots = slab_class_stats(&slab, 0).free_slots;
+    hardened_reports = 0;
+
+    slab_free(&slab, a);
+    slab_free(&slab, a);
+    ASSERT_EQ(hardened_reports, 1);
+
+#ifndef SLAB_DEBUG
+    // not at the head, found through the free key
+    slab_free(&slab, b);
+    slab_free(&slab, a);
+    ASSERT_EQ(hardened_reports, 2);
+#else
+    slab_free(&slab, b);
+#endif
+
+    ASSERT_EQ(slab_class_stats(&slab, 0).free_slots, free_slots + 2);
+    slab_destroy(&slab);
+}
+
+TEST(test_hardened_corrupt_link) {
+    uint8_t buffer[4096];
+    size_t sizes[] = {24};
+    slab_t slab;
+    void *a, *b;
+    uintptr_t saved;
+
+    memset(&slab, 0, sizeof(slab));
+    ASSERT_EQ(slab_init(&slab, buffer, sizeof(buffer), sizes, 1), SLAB_OK);
+
+    a = slab_alloc(&slab, 24);
+    b = slab_alloc(&slab, 24);
+    slab_free(&slab, a);
+    slab_free(&slab, b);
+    hardened_reports = 0;
+
+    // a use after free write over the link, pointing into the middle of a slot
+    saved = *(uintptr_t *)b;
+    *(uintptr_t *)b = ((uintptr_t)a + 8) ^ ((uintptr_t)b >> 12);
+    ASSERT_NULL(slab_alloc(&slab, 24));
+    ASSERT_EQ(hardened_reports, 1);
+
+    // the broken link stays in place, restoring it recovers the class
+    *(uintptr_t *)b = saved;
+    ASSERT(slab_alloc(&slab, 24) == b);
+    ASSERT(slab_alloc(&slab, 24) == a);
+
+    slab_destroy(&slab);
+}
+
+#endif /* SLAB_HARDENED */
+
 int main(void) {
     printf("\n");
     printf(" slab allocator tests \n");
@@ -1077,6 +1288,9 @@ int main(void) {
     printf("   SLAB_DEBUG: enabled\n");
 #else
     printf("   SLAB_DEBUG: disabled\n");
+#endif
+#ifdef SLAB_HARDENED
+    printf("   SLAB_HARDENED: enabled\n");
 #endif
     printf("   Alignment: %zu bytes\n", (size_t)SLAB_ALIGNMENT);
 
@@ -1106,6 +1320,9 @@ int main(void) {
     RUN_TEST(test_ptr_to_class_mapping);
     RUN_TEST(test_slab_owns);
 
+    RUN_TEST(test_free_odd_slot_sizes);
+    RUN_TEST(test_tiny_classes);
+    RUN_TEST(test_tiny_class_limits);
     RUN_TEST(test_alignment_all_classes);
     RUN_TEST(test_unaligned_buffer);
 
@@ -1132,6 +1349,12 @@ int main(void) {
     RUN_TEST(test_debug_poison_check);
 #endif
 
+#ifdef SLAB_HARDENED
+    RUN_TEST(test_hardened_link_encoding);
+    RUN_TEST(test_hardened_double_free);
+    RUN_TEST(test_hardened_corrupt_link);
+#endif
+
     printf("    %d/%d tests passed\n", tests_passed, tests_run);
     if (tests_failed > 0) {
         printf("   \033[31m%d TESTS FAILED\033[0m\n", tests_failed);